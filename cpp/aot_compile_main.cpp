@@ -0,0 +1,70 @@
+#include <iostream>
+
+#include <fstream>
+#include <string>
+
+#include "src/aot_compiler.hpp"
+#include "src/errors/assembler_error.hpp"
+#include "src/errors/parser_error.hpp"
+#include "src/assembler/assembler.hpp"
+#include "src/standard_library/standard_library.hpp"
+#include "src/standard_library/standard_assert_library.hpp"
+
+using namespace lysithea_vm;
+
+// Compiles a script to C++, eg: aotCompile perfTest.lys perf_test_aot.cpp install_perf_test rand
+// The script is assembled with the standard library, any other builtins that the host adds need to be listed after the install name
+// so that the script is assembled the same way it will be by the host.
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: aotCompile <input.lys> <output.cpp> <install function name> [host builtin names...]\n";
+        return -1;
+    }
+
+    std::ifstream input_file(argv[1]);
+    if (!input_file)
+    {
+        std::cerr << "Could not find file to open: " << argv[1] << "\n";
+        return -1;
+    }
+
+    lysithea_vm::assembler assembler;
+    lysithea_vm::standard_library::add_to_scope(assembler.builtin_scope);
+    assembler.builtin_scope.combine_scope(*lysithea_vm::standard_assert_library::library_scope);
+
+    // Stand ins for the host's own builtins, only their names matter when assembling.
+    scope host_scope;
+    for (auto i = 4; i < argc; i++)
+    {
+        host_scope.try_set_constant(argv[i], value::make_native([](virtual_machine &vm, const args_span &args) -> void { }));
+    }
+    assembler.builtin_scope.combine_scope(host_scope);
+
+    try
+    {
+        auto script = assembler.parse_from_stream(argv[1], input_file);
+
+        aot_compiler compiler(script);
+        std::ofstream output_file(argv[2]);
+        output_file << compiler.compile(argv[1], argv[3]);
+        if (!output_file)
+        {
+            std::cerr << "Could not write to file: " << argv[2] << "\n";
+            return -1;
+        }
+    }
+    catch (const assembler_error &exp)
+    {
+        std::cerr << "Error: " << exp.message << "\n" << exp.trace << "\n";
+        return -1;
+    }
+    catch (const parser_error &exp)
+    {
+        std::cerr << "Error: " << exp.message << "\n" << exp.trace << "\n";
+        return -1;
+    }
+
+    return 0;
+}
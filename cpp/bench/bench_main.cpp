@@ -0,0 +1,265 @@
+#include <iostream>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <exception>
+
+#include "benchmark.hpp"
+#include "../src/errors/virtual_machine_error.hpp"
+
+using namespace lysithea_bench;
+
+namespace
+{
+    std::atomic<std::size_t> total_allocations(0);
+    std::atomic<std::size_t> total_allocated_bytes(0);
+
+    struct bench_options
+    {
+        // Fields
+        std::string examples_folder;
+        std::string filter;
+        int warmup;
+        int repetitions;
+        bool json;
+        bool list;
+
+        // Constructor
+        bench_options() : examples_folder("../../examples"), warmup(2), repetitions(10), json(false), list(false) { }
+    };
+
+    void print_usage()
+    {
+        std::cout << "Usage: lysithea_bench [options]\n"
+            "  --filter <text>       Only run benchmarks with the text in their name\n"
+            "  --warmup <count>      Untimed runs before measuring (default 2)\n"
+            "  --repetitions <count> Timed runs of each benchmark (default 10)\n"
+            "  --examples <folder>   Folder with the example scripts (default ../../examples)\n"
+            "  --json                Print the results as JSON\n"
+            "  --list                Print the benchmark names and exit\n";
+    }
+
+    bool parse_options(int argc, char **argv, bench_options &result)
+    {
+        for (auto i = 1; i < argc; i++)
+        {
+            std::string arg(argv[i]);
+            auto has_next = i + 1 < argc;
+            if (arg == "--json")
+            {
+                result.json = true;
+            }
+            else if (arg == "--list")
+            {
+                result.list = true;
+            }
+            else if (arg == "--filter" && has_next)
+            {
+                result.filter = argv[++i];
+            }
+            else if (arg == "--warmup" && has_next)
+            {
+                result.warmup = std::max(0, std::atoi(argv[++i]));
+            }
+            else if (arg == "--repetitions" && has_next)
+            {
+                result.repetitions = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (arg == "--examples" && has_next)
+            {
+                result.examples_folder = argv[++i];
+            }
+            else
+            {
+                print_usage();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    benchmark_result run_benchmark(const benchmark_case &input, const bench_options &options)
+    {
+        benchmark_result result;
+        result.name = input.name;
+        result.repetitions = options.repetitions;
+
+        auto run = input.create(options.examples_folder);
+        for (auto i = 0; i < options.warmup; i++)
+        {
+            run();
+        }
+
+        std::vector<double> times;
+        std::size_t allocations = 0;
+        std::size_t bytes = 0;
+        for (auto i = 0; i < options.repetitions; i++)
+        {
+            auto start_allocations = allocation_count();
+            auto start_bytes = allocated_bytes();
+            auto start = std::chrono::steady_clock::now();
+
+            result.instructions = run();
+
+            auto end = std::chrono::steady_clock::now();
+            allocations += allocation_count() - start_allocations;
+            bytes += allocated_bytes() - start_bytes;
+            times.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+        }
+
+        std::sort(times.begin(), times.end());
+        auto count = times.size();
+        result.min_ns = times.front();
+        result.median_ns = count % 2 == 1 ? times[count / 2] : (times[count / 2 - 1] + times[count / 2]) * 0.5;
+        auto p99_index = static_cast<std::size_t>(0.99 * static_cast<double>(count - 1) + 0.5);
+        result.p99_ns = times[p99_index];
+
+        auto total = 0.0;
+        for (auto iter : times)
+        {
+            total += iter;
+        }
+        result.mean_ns = total / static_cast<double>(count);
+        result.allocations = allocations / count;
+        result.allocated_bytes = bytes / count;
+
+        return result;
+    }
+
+    std::string json_escape(const std::string &input)
+    {
+        std::string result;
+        for (auto ch : input)
+        {
+            if (ch == '"' || ch == '\\')
+            {
+                result += '\\';
+            }
+            result += ch;
+        }
+        return result;
+    }
+
+    void print_json(const std::vector<benchmark_result> &results)
+    {
+        std::printf("{\n  \"benchmarks\": [\n");
+        for (std::size_t i = 0; i < results.size(); i++)
+        {
+            const auto &iter = results[i];
+            std::printf("    {\"name\": \"%s\", \"repetitions\": %d, \"median_ns\": %.0f, \"p99_ns\": %.0f, \"min_ns\": %.0f, \"mean_ns\": %.0f, "
+                "\"instructions\": %zu, \"instructions_per_second\": %.0f, \"allocations\": %zu, \"allocated_bytes\": %zu}%s\n",
+                json_escape(iter.name).c_str(), iter.repetitions, iter.median_ns, iter.p99_ns, iter.min_ns, iter.mean_ns,
+                iter.instructions, iter.instructions_per_second(), iter.allocations, iter.allocated_bytes,
+                i + 1 < results.size() ? "," : "");
+        }
+        std::printf("  ]\n}\n");
+    }
+
+    void print_table_header()
+    {
+        std::printf("%-28s %12s %12s %12s %14s %12s %14s\n", "benchmark", "median ms", "p99 ms", "min ms", "instr/s", "allocs", "alloc bytes");
+    }
+
+    void print_table_row(const benchmark_result &input)
+    {
+        std::printf("%-28s %12.3f %12.3f %12.3f %14.0f %12zu %14zu\n",
+            input.name.c_str(), input.median_ns * 1e-6, input.p99_ns * 1e-6, input.min_ns * 1e-6,
+            input.instructions_per_second(), input.allocations, input.allocated_bytes);
+        std::fflush(stdout);
+    }
+}
+
+// Every allocation in the process goes through here so that each benchmark can report how much it allocated.
+void *operator new(std::size_t size)
+{
+    total_allocations.fetch_add(1, std::memory_order_relaxed);
+    total_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    auto result = std::malloc(size == 0 ? 1 : size);
+    if (!result)
+    {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+namespace lysithea_bench
+{
+    std::size_t allocation_count()
+    {
+        return total_allocations.load(std::memory_order_relaxed);
+    }
+
+    std::size_t allocated_bytes()
+    {
+        return total_allocated_bytes.load(std::memory_order_relaxed);
+    }
+} // lysithea_bench
+
+int main(int argc, char **argv)
+{
+    bench_options options;
+    if (!parse_options(argc, argv, options))
+    {
+        return -1;
+    }
+
+    register_benchmarks();
+
+    std::vector<benchmark_result> results;
+    if (!options.json && !options.list)
+    {
+        print_table_header();
+    }
+
+    auto failed = false;
+    for (const auto &iter : benchmark_registry::cases())
+    {
+        if (!options.filter.empty() && iter.name.find(options.filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        if (options.list)
+        {
+            std::cout << iter.name << "\n";
+            continue;
+        }
+
+        try
+        {
+            results.push_back(run_benchmark(iter, options));
+            if (!options.json)
+            {
+                print_table_row(results.back());
+            }
+        }
+        catch (const lysithea_vm::virtual_machine_error &exp)
+        {
+            std::cerr << iter.name << " failed: " << exp.message << "\n";
+            failed = true;
+        }
+        catch (const std::exception &exp)
+        {
+            std::cerr << iter.name << " failed: " << exp.what() << "\n";
+            failed = true;
+        }
+    }
+
+    if (options.json)
+    {
+        print_json(results);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+namespace lysithea_bench
+{
+    // One timed run of a benchmark, returns the number of VM instructions it stepped through or 0 if it doesn't run the VM.
+    using benchmark_run = std::function<std::size_t ()>;
+
+    // Does any setup that shouldn't be timed (eg: assembling the script) and returns the run to time.
+    using benchmark_factory = std::function<benchmark_run (const std::string &examples_folder)>;
+
+    struct benchmark_case
+    {
+        // Fields
+        std::string name;
+        benchmark_factory create;
+
+        // Constructor
+        benchmark_case(const std::string &name, benchmark_factory create) : name(name), create(create) { }
+    };
+
+    struct benchmark_result
+    {
+        // Fields
+        std::string name;
+        int repetitions;
+        double median_ns;
+        double p99_ns;
+        double min_ns;
+        double mean_ns;
+        std::size_t instructions;
+        std::size_t allocations;
+        std::size_t allocated_bytes;
+
+        // Constructor
+        benchmark_result() : repetitions(0), median_ns(0), p99_ns(0), min_ns(0), mean_ns(0), instructions(0), allocations(0), allocated_bytes(0) { }
+
+        // Methods
+        inline double instructions_per_second() const
+        {
+            return median_ns > 0 ? static_cast<double>(instructions) / (median_ns * 1e-9) : 0.0;
+        }
+    };
+
+    class benchmark_registry
+    {
+        public:
+            // Methods
+            static std::vector<benchmark_case> &cases()
+            {
+                static std::vector<benchmark_case> result;
+                return result;
+            }
+
+            static void add(const std::string &name, benchmark_factory create)
+            {
+                cases().emplace_back(name, create);
+            }
+
+        private:
+            // Constructor
+            benchmark_registry() { }
+    };
+
+    // Adds every benchmark in benchmarks.cpp to the registry.
+    void register_benchmarks();
+
+    // Counts made by the global operator new in bench_main.cpp.
+    std::size_t allocation_count();
+    std::size_t allocated_bytes();
+} // lysithea_bench
@@ -0,0 +1,355 @@
+#include "benchmark.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <stdexcept>
+
+#include "../src/virtual_machine.hpp"
+#include "../src/assembler/assembler.hpp"
+#include "../src/assembler/tokeniser.hpp"
+#include "../src/native_binding.hpp"
+#include "../src/standard_library/standard_library.hpp"
+#include "../src/standard_library/standard_assert_library.hpp"
+
+using namespace lysithea_vm;
+
+// Made from perfTest.lys by aotCompile during the build.
+void install_perf_test(const lysithea_vm::script &input);
+
+namespace lysithea_bench
+{
+    namespace
+    {
+        std::mt19937 bench_rand(1234);
+        std::uniform_real_distribution<double> bench_dist(0.0, 1.0);
+
+        std::string read_example(const std::string &examples_folder, const std::string &filename)
+        {
+            auto path = examples_folder + "/" + filename;
+            std::ifstream input(path);
+            if (!input)
+            {
+                throw std::runtime_error("Unable to open example file: " + path);
+            }
+
+            std::stringstream result;
+            result << input.rdbuf();
+            return result.str();
+        }
+
+        void add_bench_scope(assembler &input)
+        {
+            standard_library::add_to_scope(input.builtin_scope);
+            input.builtin_scope.combine_scope(*standard_assert_library::library_scope);
+
+            // Printing would swamp the timings, so print does nothing and rand is seeded the same way each time.
+            scope bench_scope;
+            bench_scope.try_set_constant("print", value::make_native([](virtual_machine &vm, const args_span &args) -> void { }));
+            bench_scope.try_set_constant("rand", make_bound_function([]() { return bench_dist(bench_rand); }));
+            input.builtin_scope.combine_scope(bench_scope);
+        }
+
+        // Steps through the script directly instead of calling execute so that the instructions can be counted.
+        std::size_t run_script(std::shared_ptr<script> input)
+        {
+            virtual_machine vm(32);
+            vm.change_to_script(input);
+            vm.running = true;
+            vm.paused = false;
+
+            std::size_t instructions = 0;
+            while (vm.running && !vm.paused)
+            {
+                vm.step();
+                instructions++;
+            }
+            return instructions;
+        }
+
+        void add_script(const std::string &name, const std::string &source)
+        {
+            benchmark_registry::add(name, [name, source](const std::string &examples_folder) -> benchmark_run
+            {
+                assembler assembler;
+                add_bench_scope(assembler);
+                auto compiled = assembler.parse_from_text(name, source);
+                return [compiled]() { return run_script(compiled); };
+            });
+        }
+
+        void add_example_script(const std::string &name, const std::string &filename)
+        {
+            benchmark_registry::add(name, [filename](const std::string &examples_folder) -> benchmark_run
+            {
+                assembler assembler;
+                add_bench_scope(assembler);
+                auto compiled = assembler.parse_from_text(filename, read_example(examples_folder, filename));
+                return [compiled]() { return run_script(compiled); };
+            });
+        }
+
+        // Compiled functions run several lines per step, so there is no instruction count to report.
+        void add_compiled_script(const std::string &name, const std::string &filename, void (*install)(const script &))
+        {
+            benchmark_registry::add(name, [filename, install](const std::string &examples_folder) -> benchmark_run
+            {
+                assembler assembler;
+                add_bench_scope(assembler);
+                auto compiled = assembler.parse_from_text(filename, read_example(examples_folder, filename));
+                install(*compiled);
+                return [compiled]() -> std::size_t
+                {
+                    virtual_machine vm(32);
+                    vm.execute(compiled);
+                    return 0;
+                };
+            });
+        }
+
+        void add_assemble(const std::string &name, const std::string &filename)
+        {
+            benchmark_registry::add(name, [filename](const std::string &examples_folder) -> benchmark_run
+            {
+                auto source = read_example(examples_folder, filename);
+                return [filename, source]() -> std::size_t
+                {
+                    assembler assembler;
+                    add_bench_scope(assembler);
+                    assembler.parse_from_text(filename, source);
+                    return 0;
+                };
+            });
+        }
+
+        void add_tokenise(const std::string &name, const std::string &filename)
+        {
+            benchmark_registry::add(name, [filename](const std::string &examples_folder) -> benchmark_run
+            {
+                auto source = read_example(examples_folder, filename);
+                return [source]() -> std::size_t
+                {
+                    auto lines = tokeniser::split_text(source);
+                    tokeniser input(*lines);
+                    while (input.move_next()) { }
+                    return 0;
+                };
+            });
+        }
+
+        // The same work as perfTest.lys written as plain C++, to compare the VM against.
+        void add_native_control()
+        {
+            benchmark_registry::add("native.control", [](const std::string &examples_folder) -> benchmark_run
+            {
+                return []() -> std::size_t
+                {
+                    volatile double total = 0.0;
+                    for (auto counter = 0; counter < 1000000; counter++)
+                    {
+                        total = total + bench_dist(bench_rand) + bench_dist(bench_rand);
+                    }
+                    return 0;
+                };
+            });
+        }
+    }
+
+    void register_benchmarks()
+    {
+        add_script("vm.dispatch", R"(
+(define i 0)
+(loop (< i 200000)
+    (++ i)
+))");
+
+        add_script("vm.locals", R"(
+(function main ()
+    (define a 0)
+    (define b 1)
+    (define i 0)
+    (loop (< i 100000)
+        (set a (+ a b))
+        (set b (- a b))
+        (++ i)
+    )
+)
+(main))");
+
+        add_script("vm.calls", R"(
+(function add (x y)
+    (return (+ x y))
+)
+(function main ()
+    (define total 0)
+    (define i 0)
+    (loop (< i 50000)
+        (set total (add total i))
+        (++ i)
+    )
+)
+(main))");
+
+        add_script("vm.recursion.fib", R"(
+(function fib (n)
+    (if (<= n 1)
+        (return n)
+        (return (+ (fib (- n 2)) (fib (- n 1))))
+    )
+)
+(fib 20))");
+
+        add_script("vm.property", R"(
+(function main ()
+    (define obj {"position" {"x" 1 "y" 2}})
+    (define list (array.join obj obj obj))
+    (define total 0)
+    (define i 0)
+    (loop (< i 50000)
+        (set total (+ total obj.position.x))
+        (set total (+ total list.1.position.y))
+        (++ i)
+    )
+)
+(main))");
+
+        add_script("vm.string.concat", R"(
+(function main ()
+    (define text "")
+    (define i 0)
+    (loop (< i 20000)
+        (set text ($ text "x" i))
+        (++ i)
+    )
+)
+(main))");
+
+        add_script("lib.math", R"(
+(function main ()
+    (define total 0)
+    (define i 0)
+    (loop (< i 20000)
+        (set total (+ total (math.sin i)))
+        (set total (+ total (math.floor (math.log (+ i 1)))))
+        (set total (+ total (math.max 1 i 3)))
+        (set total (+ total (math.sum 1 2 i)))
+        (++ i)
+    )
+)
+(main))");
+
+        add_script("lib.string", R"(
+(function main ()
+    (define text "the quick brown fox")
+    (define total 0)
+    (define i 0)
+    (loop (< i 20000)
+        (define part (string.substring text 4 5))
+        (set total (+ total (string.length (string.insert part 0 "a"))))
+        (set total (+ total (string.length (string.removeAll text "o"))))
+        (++ i)
+    )
+)
+(main))");
+
+        add_script("lib.array", R"(
+(function main ()
+    (define list [])
+    (define i 0)
+    (loop (< i 5000)
+        (set list (array.insert list i i))
+        (++ i)
+    )
+    (define found 0)
+    (set i 0)
+    (loop (< i 500)
+        (if (array.contains list (* i 7)) (++ found))
+        (set found (+ found (array.indexOf list i)))
+        (++ i)
+    )
+    (set list (array.removeAll list 10))
+    (set list (array.sublist list 10 100))
+)
+(main))");
+
+        add_script("lib.object", R"(
+(function main ()
+    (define obj {})
+    (define i 0)
+    (loop (< i 5000)
+        (set obj (object.set obj ($ "key" i) i))
+        (++ i)
+    )
+    (define total 0)
+    (set i 0)
+    (loop (< i 5000)
+        (set total (+ total (object.get obj ($ "key" i))))
+        (++ i)
+    )
+    (object.keys obj)
+)
+(main))");
+
+        add_script("lib.numberArray", R"(
+(function main ()
+    (define values (numberArray.create 10000 0.5))
+    (define other (numberArray.create 10000 2))
+    (define total 0)
+    (define i 0)
+    (loop (< i 100)
+        (set values (numberArray.add values 0.25))
+        (set values (numberArray.multiply values other))
+        (set values (numberArray.clamp values 0 10))
+        (set total (+ total (numberArray.dot values other)))
+        (set total (+ total (math.sum values)))
+        (++ i)
+    )
+)
+(main))");
+
+        add_script("lib.set", R"(
+(function main ()
+    (define tags (set.join))
+    (define i 0)
+    (loop (< i 5000)
+        (set tags (set.add tags ($ "tag" i)))
+        (++ i)
+    )
+    (define found 0)
+    (set i 0)
+    (loop (< i 10000)
+        (if (set.contains tags ($ "tag" i)) (++ found))
+        (++ i)
+    )
+    (set.intersect tags (set.join "tag1" "tag2" "nope"))
+)
+(main))");
+
+        add_script("lib.misc", R"(
+(function main ()
+    (define total 0)
+    (define i 0)
+    (loop (< i 20000)
+        (set total (+ total (compareTo i 100)))
+        (set total (+ total (string.length (toString i))))
+        (set total (+ total (string.length (typeof i))))
+        (++ i)
+    )
+)
+(main))");
+
+        add_example_script("script.perfTest", "perfTest.lys");
+        add_example_script("script.mapBenchmark", "mapBenchmark.lys");
+        add_example_script("script.standardLibrary", "testStandardLibrary.lys");
+
+        add_compiled_script("aot.perfTest", "perfTest.lys", install_perf_test);
+
+        add_assemble("assembler.standardLibrary", "testStandardLibrary.lys");
+        add_assemble("assembler.readmeExamples", "readmeExamples.lys");
+
+        add_tokenise("tokeniser.standardLibrary", "testStandardLibrary.lys");
+        add_tokenise("tokeniser.readmeExamples", "readmeExamples.lys");
+
+        add_native_control();
+    }
+} // lysithea_bench
@@ -2,10 +2,12 @@
 
 #include <random>
 #include <fstream>
+#include <algorithm>
 
 #include "src/values/values.hpp"
 #include "src/virtual_machine.hpp"
 #include "src/assembler/assembler.hpp"
+#include "src/native_binding.hpp"
 #include "src/standard_library/standard_array_library.hpp"
 
 using namespace lysithea_vm;
@@ -16,6 +18,32 @@ std::mt19937 _rand(_rd());
 bool is_shop_enabled = false;
 std::vector<value> choice_buffer;
 
+class shop_keeper
+{
+    public:
+        // Fields
+        std::string name;
+        int potions;
+
+        // Constructor
+        shop_keeper(const std::string &name, int potions) : name(name), potions(potions) { }
+
+        // Methods
+        bool has_potions() const { return potions > 0; }
+
+        std::string greeting(const std::string &player_name) const
+        {
+            return "I'm " + name + ", nice to meet you " + player_name;
+        }
+
+        int sell_potions(int amount)
+        {
+            amount = std::min(amount, potions);
+            potions -= amount;
+            return amount;
+        }
+};
+
 void say(const value &input)
 {
     std::cout << "Say: " << input.to_string() << "\n";
@@ -53,10 +81,7 @@ std::shared_ptr<scope> create_dialogue_scope()
 {
     auto result = std::make_shared<scope>();
 
-    result->try_set_constant("say", [](virtual_machine &vm, const array_value &args) -> void
-    {
-        say(args.get_index(0));
-    });
+    result->try_set_constant("say", make_bound_function(&say));
 
     result->try_set_constant("getPlayerName", [](virtual_machine &vm, const array_value &args) -> void
     {
@@ -65,15 +90,9 @@ std::shared_ptr<scope> create_dialogue_scope()
         vm.global_scope->try_define("playerName", value(player_name));
     });
 
-    result->try_set_constant("randomSay", [](virtual_machine &vm, const array_value &args) -> void
-    {
-        random_say(*args.get_index<const array_value>(0));
-    });
+    result->try_set_constant("randomSay", make_bound_function(&random_say));
 
-    result->try_set_constant("isShopEnabled", [](virtual_machine &vm, const array_value &args) -> void
-    {
-        vm.push_stack(is_shop_enabled);
-    });
+    result->try_set_constant("isShopEnabled", make_bound_function([]() { return is_shop_enabled; }));
 
     result->try_set_constant("moveTo", [](virtual_machine &vm, const array_value &args) -> void
     {
@@ -84,13 +103,11 @@ std::shared_ptr<scope> create_dialogue_scope()
         vm.jump(label.to_string());
     });
 
-    result->try_set_constant("choice", [](virtual_machine &vm, const array_value &args) -> void
+    result->try_set_constant("choice", make_bound_function([](const value &choice_text, const value &choice_jump)
     {
-        auto choice_text = args.get_index(0);
-        auto choice_jump = args.get_index(1);
         choice_buffer.push_back(choice_jump);
         say_choice(choice_text);
-    });
+    }));
 
     result->try_set_constant("waitForChoice", [](virtual_machine &vm, const array_value &args) -> void
     {
@@ -118,15 +135,20 @@ std::shared_ptr<scope> create_dialogue_scope()
         } while (!choice_valid);
     });
 
-    result->try_set_constant("openTheShop", [](virtual_machine &vm, const array_value &args) -> void
-    {
-        is_shop_enabled = true;
-    });
+    result->try_set_constant("openTheShop", make_bound_function([]() { is_shop_enabled = true; }));
 
-    result->try_set_constant("openShop", [](virtual_machine &vm, const array_value &args) -> void
+    result->try_set_constant("openShop", make_bound_function([]()
     {
         std::cout << "Opening the shop to the player and quitting dialogue\n";
-    });
+    }));
+
+    auto shop_keeper_class = std::make_shared<native_class<shop_keeper>>("shopKeeper");
+    shop_keeper_class->add_property("name", &shop_keeper::name)
+        .add_property("potions", &shop_keeper::potions)
+        .add_property("hasPotions", &shop_keeper::has_potions)
+        .add_method("greeting", &shop_keeper::greeting)
+        .add_method("sellPotions", &shop_keeper::sell_potions);
+    result->try_set_constant("shopKeeper", make_native_object(std::make_shared<shop_keeper>("Mira", 3), shop_keeper_class));
 
     return result;
 }
@@ -0,0 +1,634 @@
+#include <iostream>
+
+#include <string>
+#include <functional>
+#include <map>
+#include <thread>
+
+#include "src/virtual_machine.hpp"
+#include "src/errors/virtual_machine_error.hpp"
+#include "src/errors/assembler_error.hpp"
+#include "src/assembler/assembler.hpp"
+#include "src/standard_library/standard_library.hpp"
+#include "src/values/function_value.hpp"
+#include "src/native_binding.hpp"
+#include "src/snapshot.hpp"
+
+using namespace lysithea_vm;
+
+// Tests for the parts of the virtual machine that are used from the host and cannot be checked from a script alone.
+
+bool check(bool condition, const std::string &message)
+{
+    if (!condition)
+    {
+        std::cerr << "Check failed: " << message << "\n";
+    }
+    return condition;
+}
+
+value call_from_host(virtual_machine &vm, const value &func)
+{
+    vm.call_function(*func.get_complex(), 0, true);
+    vm.execute();
+    return vm.pop_stack();
+}
+
+value get_constant(const script &input, const std::string &key)
+{
+    value result;
+    input.builtin_scope->try_get_key(key, result);
+    return result;
+}
+
+bool test_reassemble()
+{
+    lysithea_vm::assembler assembler;
+    standard_library::add_to_scope(assembler.builtin_scope);
+
+    auto first = assembler.reassemble_from_text("reassemble.lys",
+        "(function greet () (return \"first\"))\n"
+        "(function removed () (return 1))\n"
+        "(define kept greet)\n");
+
+    virtual_machine vm(16);
+    vm.execute(first);
+
+    value kept;
+    vm.global_scope->try_get_key("kept", kept);
+    auto removed = get_constant(*first, "removed");
+    auto passed = check(call_from_host(vm, kept).to_string() == "first", "first version is called");
+
+    // Change one function and delete the other, the function already held by the virtual machine should get the new body.
+    auto second = assembler.reassemble_from_text("reassemble.lys",
+        "(function greet () (return \"second\"))\n"
+        "(define kept greet)\n");
+
+    passed &= check(call_from_host(vm, kept).to_string() == "second", "existing reference uses the changed body");
+    passed &= check(get_constant(*second, "removed").is_undefined(), "deleted function is not defined");
+    passed &= check(get_constant(*second, "greet").get_complex() == kept.get_complex(), "changed function keeps the same value");
+
+    // A deleted function that is added back is a new function rather than the old one.
+    auto third = assembler.reassemble_from_text("reassemble.lys",
+        "(function greet () (return \"second\"))\n"
+        "(function removed () (return 2))\n");
+
+    auto readded = get_constant(*third, "removed");
+    passed &= check(readded.is_function() && readded.get_complex() != removed.get_complex(), "re-added function is a new value");
+    passed &= check(call_from_host(vm, removed).get_number() == 1, "old reference to a deleted function keeps its body");
+
+    return passed;
+}
+
+const char *inline_test_source =
+    "(function add (a b) (return (+ a b)))\n"
+    "(function pick (flag a b) (if flag (return a)) (return b))\n"
+    "(function wrap (input) (define boxed [input]) (return boxed))\n"
+    "(function total (...values) (return (math.sum ...values)))\n"
+    "(define numbers [1 2 3])\n"
+    "(define results [])\n"
+    "(define i 0)\n"
+    "(loop (< i 3)\n"
+    "    (set results (array.insert results results.length (add i 10)))\n"
+    "    (set results (array.insert results results.length (pick (== i 1) \"yes\" \"no\")))\n"
+    "    (set results (array.insert results results.length (wrap i)))\n"
+    "    (set results (array.insert results results.length (add (math.max ...numbers) i)))\n"
+    "    (set results (array.insert results results.length (total i ...numbers)))\n"
+    "    (++ i)\n"
+    ")\n";
+
+value run_inline_test(int inline_budget, std::size_t &num_inlined)
+{
+    lysithea_vm::assembler assembler;
+    assembler.inline_budget = inline_budget;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    auto script = assembler.parse_from_text("inline.lys", inline_test_source);
+
+    virtual_machine vm(16);
+    vm.execute(script);
+
+    num_inlined = 0;
+    for (const auto &iter : vm.global_scope->values)
+    {
+        if (iter.first.find("#inline") != std::string::npos)
+        {
+            num_inlined++;
+            if (!iter.second.is_null())
+            {
+                std::cerr << "Inlined local was not cleared: " << iter.first << "\n";
+                return value();
+            }
+        }
+    }
+
+    value results;
+    vm.global_scope->try_get_key("results", results);
+    return results;
+}
+
+bool test_inline()
+{
+    std::size_t num_inlined, num_not_inlined;
+    auto inlined = run_inline_test(8, num_inlined);
+    auto not_inlined = run_inline_test(0, num_not_inlined);
+
+    // add, pick and wrap are inlined, including the call with an unpacked argument to a nested call.
+    auto passed = check(num_inlined == 9, "calls are inlined and their locals cleared");
+    passed &= check(num_not_inlined == 0, "nothing is inlined with no budget");
+    passed &= check(inlined.is_array() && inlined.to_string() == not_inlined.to_string(), "inlined results match");
+    return passed;
+}
+
+bool run_move_error(const std::string &source, const std::string &expected)
+{
+    lysithea_vm::assembler assembler;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    auto script = assembler.parse_from_text("move.lys", source);
+
+    virtual_machine vm(16);
+    auto threw = false;
+    try
+    {
+        vm.execute(script);
+    }
+    catch (const std::exception &exp)
+    {
+        threw = true;
+    }
+
+    value list;
+    vm.global_scope->try_get_key("list", list);
+    return check(threw, "error thrown for: " + source) &
+        check(list.to_string() == expected, "variable restored after error for: " + source + ", got " + list.to_string());
+}
+
+bool test_move_error()
+{
+    // The variable is moved out for the builtin to update it in place, an error before it is set again puts it back.
+    auto passed = run_move_error("(define list [1 2 3])\n(set list (array.insert list \"bad\" 4))", "(1 2 3)");
+    passed &= run_move_error("(define list [1 2 3])\n(set list (array.insert list 0 missing))", "(1 2 3)");
+    passed &= run_move_error("(define list [1 2 3])\n(set list (array.insert list 0 4))\n(set list (array.set list \"bad\" 5))", "(4 1 2 3)");
+    return passed;
+}
+
+bool test_intern()
+{
+    std::weak_ptr<string_value> freed;
+    auto passed = true;
+    {
+        lysithea_vm::assembler assembler;
+        auto script = assembler.parse_from_text("intern.lys", "(define text \"intern test string\")");
+
+        auto first = string_value::intern("intern test string");
+        passed &= check(string_value::intern("intern test string") == first, "interning the same text gives the same string");
+        freed = first;
+    }
+    passed &= check(freed.expired(), "strings from a freed script are freed");
+
+    auto again = string_value::intern("intern test string");
+    passed &= check(again->equals(string_value("intern test string")), "interned again after being freed");
+    return passed;
+}
+
+class counter
+{
+    public:
+        // Fields
+        std::string name;
+        int count;
+
+        // Constructor
+        counter(const std::string &name) : name(name), count(0) { }
+
+        // Methods
+        int add(int amount)
+        {
+            count += amount;
+            return count;
+        }
+};
+
+const char *native_object_test_source =
+    "(define first (counter.add 2))\n"
+    "(define second (counter.add 3))\n"
+    "(define name counter.name)\n"
+    "(define sameMethod (== counter.add counter.add))\n"
+    "(define keys (object.keys counter))\n"
+    "(define values (array.sublist (object.values counter) 1 2))\n"
+    "(define length (object.length counter))\n"
+    "(define count (object.get counter \"count\"))\n"
+    "(define missing (object.get counter \"missing\"))\n";
+
+bool test_native_object()
+{
+    auto counter_class = std::make_shared<native_class<counter>>("counter");
+    counter_class->add_property("name", &counter::name)
+        .add_property("count", &counter::count)
+        .add_method("add", &counter::add);
+    auto data = std::make_shared<counter>("clicks");
+
+    lysithea_vm::assembler assembler;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    assembler.builtin_scope.try_set_constant("counter", make_native_object(data, counter_class));
+    auto script = assembler.parse_from_text("native.lys", native_object_test_source);
+
+    virtual_machine vm(16);
+    vm.execute(script);
+
+    auto get_global = [&vm](const std::string &key)
+    {
+        value result;
+        vm.global_scope->try_get_key(key, result);
+        return result.to_string();
+    };
+
+    auto passed = check(get_global("first") == "2" && get_global("second") == "5" && data->count == 5, "methods change the C++ object");
+    passed &= check(get_global("name") == "clicks", "properties are read");
+    passed &= check(get_global("sameMethod") == "true", "the bound method is made once for each object");
+    passed &= check(get_global("keys") == "(add count name)", "object.keys lists properties and methods, got " + get_global("keys"));
+    passed &= check(get_global("values") == "(5 clicks)" && get_global("length") == "3", "object.values and object.length");
+    passed &= check(get_global("count") == "5" && get_global("missing") == "null", "object.get reads properties");
+
+    auto threw = false;
+    try
+    {
+        auto change = assembler.parse_from_text("change.lys", "(object.set counter \"count\" 10)");
+        vm.execute(change);
+    }
+    catch (const std::exception &exp)
+    {
+        threw = true;
+    }
+    passed &= check(threw && data->count == 5, "native objects can not be changed through the object library");
+    return passed;
+}
+
+// Pauses part way through a function holding closures that share a captured variable, then adds branch to it.
+const char *closure_test_source =
+    "(define branch 0)\n"
+    "(function makeAccount ()\n"
+    "    (define balance 0)\n"
+    "    (return (array.join (function (amount) (+= balance amount)) (function () (return balance))))\n"
+    ")\n"
+    "(function run ()\n"
+    "    (define account (makeAccount))\n"
+    "    (define deposit (array.get account 0))\n"
+    "    (define read (array.get account 1))\n"
+    "    (deposit 5)\n"
+    "    (pause)\n"
+    "    (deposit branch)\n"
+    "    (return (read))\n"
+    ")\n"
+    "(define result (run))\n";
+
+std::shared_ptr<script> parse_closure_test()
+{
+    lysithea_vm::assembler assembler;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    assembler.builtin_scope.try_set_constant("pause", value::make_native([](virtual_machine &vm, const args_span &args) -> void
+    {
+        vm.paused = true;
+    }));
+    return assembler.parse_from_text("closure.lys", closure_test_source);
+}
+
+double run_closure_branch(virtual_machine &vm, int branch)
+{
+    vm.writable_global_scope().try_define("branch", value(branch));
+    vm.execute();
+
+    value result;
+    vm.global_scope->try_get_key("result", result);
+    return result.is_number() ? result.get_number() : -1;
+}
+
+bool test_closure_snapshot()
+{
+    auto script = parse_closure_test();
+    virtual_machine vm(32);
+    vm.execute(script);
+
+    snapshot_context context(script);
+    auto saved = context.save(vm);
+    auto passed = check(saved.size() > 4 && saved[4] == 2, "snapshots with cells are format version 2");
+    passed &= check(run_closure_branch(vm, 1) == 6, "the closures share the captured variable");
+
+    // Both closures still need to share the one cell once restored, and it holds the value from when it was saved.
+    virtual_machine restored(32);
+    context.restore(restored, saved);
+    passed &= check(run_closure_branch(restored, 10) == 15, "restored closures share the captured variable");
+
+    context.restore(vm, saved);
+    passed &= check(run_closure_branch(vm, 20) == 25, "restoring puts back the captured variable");
+    return passed;
+}
+
+bool test_closure_fork()
+{
+    auto script = parse_closure_test();
+    virtual_machine vm(32);
+    vm.execute(script);
+
+    // Each fork writes to the captured variable on its own thread, none of them should see the others' writes.
+    std::vector<std::shared_ptr<virtual_machine>> forks;
+    std::vector<double> results(4);
+    for (auto i = 0; i < 4; i++)
+    {
+        forks.push_back(vm.fork());
+    }
+
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&forks, &results, i]()
+        {
+            results[i] = run_closure_branch(*forks[i], i + 1);
+        });
+    }
+    auto original = run_closure_branch(vm, 100);
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    auto passed = check(original == 105, "the original keeps its own captured variable");
+    for (auto i = 0; i < 4; i++)
+    {
+        passed &= check(results[i] == 6 + i, "each fork writes its own captured variable");
+    }
+    return passed;
+}
+
+bool test_intern_edit()
+{
+    lysithea_vm::assembler assembler;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    virtual_machine vm(16);
+    vm.execute(assembler.reassemble_from_text("edit.lys", "(define kept \"hello world\")\n"));
+
+    // Once the changed script is swapped in, the global is the only thing holding the interned literal.
+    vm.execute(assembler.reassemble_from_text("edit.lys", "(set kept (string.set kept 0 \"J\"))\n"));
+
+    value kept;
+    vm.global_scope->try_get_key("kept", kept);
+    auto passed = check(kept.to_string() == "Jello world", "the variable is changed");
+    passed &= check(string_value::intern("hello world")->data == "hello world", "the interned string is not changed in place");
+    passed &= check(!string_value::intern("hello world")->equals(*kept.get_complex<const string_value>()), "the changed string is not equal to the literal");
+    return passed;
+}
+
+bool test_number_array_create()
+{
+    lysithea_vm::assembler assembler;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    auto script = assembler.parse_from_text("create.lys", "(define numbers (numberArray.create -1))");
+
+    virtual_machine vm(16);
+    auto threw = false;
+    try
+    {
+        vm.execute(script);
+    }
+    catch (const virtual_machine_error &exp)
+    {
+        threw = exp.message.find("negative length") != std::string::npos && !exp.stack_trace.empty();
+    }
+    return check(threw, "a negative length is a virtual machine error");
+}
+
+bool test_memory_limit_push()
+{
+    lysithea_vm::assembler assembler;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    auto create = assembler.parse_from_text("create.lys", "(define list []) (define i 0) (loop (< i 32) (set list (array.insert list i i)) (++ i))");
+    auto push = assembler.parse_from_text("push.lys", "(set list (array.insert list 32 32))");
+    auto push_more = assembler.parse_from_text("pushMore.lys", "(set i 33) (loop (< i 73) (set list (array.insert list i i)) (++ i))");
+
+    // The list's tail is full, so adding to it moves the tail into the trie. Running out of memory at any point
+    // while doing that should leave the list as it was, otherwise the tail is in the trie twice once more is added.
+    auto passed = true;
+    auto pushed = false;
+    for (std::size_t extra = 0; !pushed && extra < 4096; extra += 4)
+    {
+        virtual_machine vm(16);
+        vm.execute(create);
+        vm.memory->memory_limit = vm.memory->live_bytes + extra;
+        try
+        {
+            vm.execute(push);
+            pushed = true;
+        }
+        catch (const virtual_machine_error &exp)
+        {
+            vm.memory->memory_limit = 0;
+            vm.execute(push);
+        }
+        vm.memory->memory_limit = 0;
+        vm.execute(push_more);
+
+        value list;
+        vm.global_scope->try_get_key("list", list);
+        auto numbers = list.get_complex<const array_value>();
+        auto in_order = numbers && numbers->data.size() == 73;
+        for (auto i = 0; in_order && i < 73; i++)
+        {
+            in_order = numbers->data[i].get_int() == i;
+        }
+        passed &= check(in_order, "the list is added to in order with " + std::to_string(extra) + " bytes spare, got " + list.to_string());
+    }
+    return passed && check(pushed, "the list was added to");
+}
+
+const char *parent_define_test_source =
+    "(define value \"global\")\n"
+    "(function inner ()\n"
+    "    (define seen [])\n"
+    "    (define i 0)\n"
+    "    (loop (< i 4)\n"
+    "        (if (== i 2) (defineInCaller \"caller\"))\n"
+    "        (set seen (array.insert seen seen.length value))\n"
+    "        (++ i)\n"
+    "    )\n"
+    "    (return seen)\n"
+    ")\n"
+    "(function outer ()\n"
+    "    (define result (inner))\n"
+    "    (return result)\n"
+    ")\n"
+    "(define seen (outer))\n";
+
+bool test_parent_define()
+{
+    lysithea_vm::assembler assembler;
+    assembler.inline_budget = 0;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    assembler.builtin_scope.try_set_constant("defineInCaller", [](virtual_machine &vm, const array_value &args) -> void
+    {
+        vm.current_scope->parent->try_define("value", args.data[0]);
+    });
+    auto script = assembler.parse_from_text("parentDefine.lys", parent_define_test_source);
+
+    // The lookup of value in inner is cached as coming from the global scope, defining it in the scope between has to be noticed.
+    virtual_machine vm(16);
+    vm.execute(script);
+
+    value seen;
+    vm.global_scope->try_get_key("seen", seen);
+    return check(seen.to_string() == "(global global caller caller)", "a variable added to a parent scope is found, got " + seen.to_string());
+}
+
+std::string first_assembler_error(const std::string &source, int assembly_threads)
+{
+    lysithea_vm::assembler assembler;
+    assembler.assembly_threads = assembly_threads;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    try
+    {
+        assembler.parse_from_text("errors.lys", source);
+    }
+    catch (const assembler_error &exp)
+    {
+        return exp.message;
+    }
+    return "";
+}
+
+bool test_assembly_error_order()
+{
+    // The first function takes the longest to assemble, so on several threads the others fail before it does.
+    std::string source = "(function first ()\n";
+    for (auto i = 0; i < 2000; i++)
+    {
+        source += "    (print " + std::to_string(i) + ")\n";
+    }
+    source += "    (loop)\n)\n";
+    for (auto i = 0; i < 8; i++)
+    {
+        source += "(function later" + std::to_string(i) + " () (if))\n";
+    }
+    source += "(if)\n";
+
+    // The error reported is the first one in the script, the same as when assembled on one thread.
+    auto expected = first_assembler_error(source, 1);
+    auto passed = check(expected.find("Loop input has too few inputs") != std::string::npos, "the first function's error is reported, got " + expected);
+    for (auto i = 0; i < 10; i++)
+    {
+        auto parallel = first_assembler_error(source, 4);
+        passed &= check(parallel == expected, "the same error is reported on several threads, got " + parallel);
+    }
+    return passed;
+}
+
+bool run_past_memory_limit(const std::shared_ptr<script> &input)
+{
+    virtual_machine vm(16);
+    vm.memory->memory_limit = 1024 * 1024;
+    try
+    {
+        vm.execute(input);
+    }
+    catch (const virtual_machine_error &exp)
+    {
+        return exp.message.find("Memory limit") != std::string::npos;
+    }
+    return false;
+}
+
+bool test_memory_limit_buffers()
+{
+    lysithea_vm::assembler assembler;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    auto strings = assembler.parse_from_text("strings.lys", "(define text \"abcdefghijklmnop\") (define i 0) (loop (< i 22) (set text ($ text text)) (++ i))");
+    auto numbers = assembler.parse_from_text("numbers.lys", "(define numbers (numberArray.create 10000000))");
+
+    // The characters of a string and the numbers of a number array count towards the limit, not just the values holding them.
+    auto passed = check(run_past_memory_limit(strings), "a 64MB string is stopped by a 1MB limit");
+    passed &= check(run_past_memory_limit(numbers), "an 80MB number array is stopped by a 1MB limit");
+    return passed;
+}
+
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+bool test_cycle_collector()
+{
+    lysithea_vm::assembler assembler;
+    standard_library::add_to_scope(assembler.builtin_scope);
+    auto script = assembler.parse_from_text("cycle.lys",
+        "(function makeCycle ()\n"
+        "    (define self null)\n"
+        "    (set self (function () (return self)))\n"
+        "    (return 1)\n"
+        ")\n"
+        "(define i 0)\n"
+        "(loop (< i 10) (makeCycle) (++ i))\n");
+
+    // Each closure is kept alive by the variable it captured, they are only freed by the collector.
+    virtual_machine vm(16);
+    vm.collector.candidate_threshold = 1000;
+    vm.execute(script);
+
+    auto live_before = vm.memory->live_bytes;
+    auto collected = vm.collector.collect();
+    auto passed = check(collected >= 10, "each closure cycle is collected, got " + std::to_string(collected));
+    passed &= check(vm.memory->live_bytes < live_before, "the memory held by the cycles is freed");
+
+    value i;
+    vm.global_scope->try_get_key("i", i);
+    passed &= check(i.get_int() == 10, "variables that are still in use are kept");
+    return passed;
+}
+#endif
+
+// Usage: hostTest <test name>...
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::function<bool()>> tests;
+    tests["reassemble"] = test_reassemble;
+    tests["inline"] = test_inline;
+    tests["moveError"] = test_move_error;
+    tests["intern"] = test_intern;
+    tests["internEdit"] = test_intern_edit;
+    tests["nativeObject"] = test_native_object;
+    tests["numberArrayCreate"] = test_number_array_create;
+    tests["memoryLimitPush"] = test_memory_limit_push;
+    tests["memoryLimitBuffers"] = test_memory_limit_buffers;
+    tests["parentDefine"] = test_parent_define;
+    tests["assemblyErrorOrder"] = test_assembly_error_order;
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+    tests["cycleCollector"] = test_cycle_collector;
+#endif
+    tests["closureSnapshot"] = test_closure_snapshot;
+    tests["closureFork"] = test_closure_fork;
+
+    auto passed = true;
+    for (auto i = 1; i < argc; i++)
+    {
+        auto find = tests.find(argv[i]);
+        if (find == tests.end())
+        {
+            std::cerr << "Unknown test: " << argv[i] << "\n";
+            passed = false;
+            continue;
+        }
+
+        try
+        {
+            if (!find->second())
+            {
+                std::cerr << "Failed: " << argv[i] << "\n";
+                passed = false;
+            }
+        }
+        catch (const virtual_machine_error &exp)
+        {
+            std::cerr << "Error in " << argv[i] << ": " << exp.message << "\n";
+            passed = false;
+        }
+        catch (const std::runtime_error &exp)
+        {
+            std::cerr << "Error in " << argv[i] << ": " << exp.what() << "\n";
+            passed = false;
+        }
+    }
+
+    return passed ? 0 : 1;
+}
@@ -2,8 +2,7 @@
 ./buildRelease.sh
 if [ $? -eq 0 ]; then
     cd ./Release
-    # ./mapBenchmark
-    ./perfTest
+    ./lysithea_bench
     # ./standardLibraryTest
     # ./dialogueTree
     cd ../
@@ -0,0 +1,92 @@
+#include <iostream>
+
+#include <fstream>
+#include <chrono>
+
+#include "src/virtual_machine.hpp"
+#include "src/snapshot.hpp"
+#include "src/errors/virtual_machine_error.hpp"
+#include "src/assembler/assembler.hpp"
+#include "src/standard_library/standard_library.hpp"
+
+using namespace lysithea_vm;
+
+std::shared_ptr<snapshot_context> snapshots;
+std::string created_snapshot;
+
+std::shared_ptr<scope> create_snapshot_scope()
+{
+    auto result = std::make_shared<scope>();
+
+    result->try_set_constant("make-snapshot", value::make_native([](virtual_machine &vm, const args_span &args) -> void
+    {
+        created_snapshot = snapshots->save(vm);
+        std::cout << "Made snapshot: " << created_snapshot.size() << " bytes\n";
+        vm.running = false;
+    }));
+
+    return result;
+}
+
+void print_error(const virtual_machine_error &exp)
+{
+    std::cerr << "Error: " << exp.message << "\nVM Stack:\n";
+    for (const auto &line : exp.stack_trace)
+    {
+        std::cerr << "- " << line << '\n';
+    }
+}
+
+int main()
+{
+    const char *filename = "../../examples/testSnapshot.lys";
+    std::ifstream input_file;
+    input_file.open(filename);
+    if (!input_file)
+    {
+        std::cout << "Could not find file to open!\n";
+        return -1;
+    }
+
+    lysithea_vm::assembler assembler;
+    lysithea_vm::standard_library::add_to_scope(assembler.builtin_scope);
+    assembler.builtin_scope.combine_scope(*create_snapshot_scope());
+
+    auto script = assembler.parse_from_stream(filename, input_file);
+    snapshots = std::make_shared<snapshot_context>(script);
+
+    lysithea_vm::virtual_machine vm(16);
+    try
+    {
+        vm.execute(script);
+    }
+    catch (const virtual_machine_error &exp)
+    {
+        print_error(exp);
+        return -1;
+    }
+
+    std::cout << "Stopped after creating snapshot\n";
+
+    // Restore into a different virtual machine to show that nothing is shared with the first one.
+    lysithea_vm::virtual_machine restored_vm(16);
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        snapshots->restore(restored_vm, created_snapshot);
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "Restored in: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "us\n";
+
+        if (restored_vm.running && !restored_vm.paused)
+        {
+            restored_vm.execute();
+        }
+    }
+    catch (const virtual_machine_error &exp)
+    {
+        print_error(exp);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,608 @@
+#include "aot_compiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "scope.hpp"
+#include "./values/array_value.hpp"
+#include "./values/object_value.hpp"
+#include "./values/string_value.hpp"
+#include "./values/function_value.hpp"
+
+namespace lysithea_vm
+{
+    namespace
+    {
+        const std::uint64_t fnv_offset = 14695981039346656037ull;
+        const std::uint64_t fnv_prime = 1099511628211ull;
+
+        inline void hash_bytes(std::uint64_t &hash, const void *data, std::size_t size)
+        {
+            auto bytes = static_cast<const unsigned char *>(data);
+            for (std::size_t i = 0; i < size; i++)
+            {
+                hash = (hash ^ bytes[i]) * fnv_prime;
+            }
+        }
+
+        template <typename T>
+        inline void hash_pod(std::uint64_t &hash, T input)
+        {
+            hash_bytes(hash, &input, sizeof(T));
+        }
+
+        // Only what the compiled code depends on is hashed, functions in the code are told apart by whether they are script functions or builtins.
+        void hash_value(std::uint64_t &hash, const value &input)
+        {
+            hash_pod(hash, static_cast<int>(input.type));
+            if (input.is_number())
+            {
+                hash_pod(hash, input.get_number());
+                return;
+            }
+            if (!input.is_complex())
+            {
+                return;
+            }
+
+            const auto complex = input.data.get();
+            hash_pod(hash, static_cast<int>(complex->kind));
+            if (complex->kind == complex_kind::string)
+            {
+                const auto &text = static_cast<const string_value *>(complex)->data;
+                hash_pod(hash, text.size());
+                hash_bytes(hash, text.data(), text.size());
+            }
+            else if (complex->kind == complex_kind::array)
+            {
+                const auto &data = static_cast<const array_value *>(complex)->data;
+                hash_pod(hash, data.size());
+                for (const auto &iter : data)
+                {
+                    hash_value(hash, iter);
+                }
+            }
+        }
+
+        void add_code_value(std::vector<std::shared_ptr<function>> &result, std::unordered_set<const function *> &found, const value &input);
+
+        void add_function(std::vector<std::shared_ptr<function>> &result, std::unordered_set<const function *> &found, std::shared_ptr<function> input)
+        {
+            if (!found.insert(input.get()).second)
+            {
+                return;
+            }
+
+            result.push_back(input);
+            for (const auto &iter : input->code)
+            {
+                add_code_value(result, found, iter.value);
+            }
+        }
+
+        void add_code_value(std::vector<std::shared_ptr<function>> &result, std::unordered_set<const function *> &found, const value &input)
+        {
+            if (auto func = input.get_complex<const function_value>())
+            {
+                add_function(result, found, func->data);
+            }
+            else if (auto array = input.get_complex<const array_value>())
+            {
+                for (const auto &iter : array->data)
+                {
+                    add_code_value(result, found, iter);
+                }
+            }
+            else if (auto object = input.get_complex<const object_value>())
+            {
+                for (const auto &iter : object->data)
+                {
+                    add_code_value(result, found, iter.second);
+                }
+            }
+        }
+
+        const char *operator_name(vm_operator input)
+        {
+            switch (input)
+            {
+                default: return "unknown";
+                case vm_operator::push: return "push";
+                case vm_operator::to_argument: return "to_argument";
+                case vm_operator::call: return "call";
+                case vm_operator::call_direct: return "call_direct";
+                case vm_operator::tail_call: return "tail_call";
+                case vm_operator::call_return: return "call_return";
+                case vm_operator::get_property: return "get_property";
+                case vm_operator::get: return "get";
+                case vm_operator::get_move: return "get_move";
+                case vm_operator::set: return "set";
+                case vm_operator::define: return "define";
+                case vm_operator::get_upvalue: return "get_upvalue";
+                case vm_operator::set_upvalue: return "set_upvalue";
+                case vm_operator::jump: return "jump";
+                case vm_operator::jump_true: return "jump_true";
+                case vm_operator::jump_false: return "jump_false";
+                case vm_operator::string_concat: return "string_concat";
+                case vm_operator::greater_than: return "greater_than";
+                case vm_operator::greater_than_equals: return "greater_than_equals";
+                case vm_operator::equals: return "equals";
+                case vm_operator::not_equals: return "not_equals";
+                case vm_operator::less_than: return "less_than";
+                case vm_operator::less_than_equals: return "less_than_equals";
+                case vm_operator::op_not: return "op_not";
+                case vm_operator::op_and: return "op_and";
+                case vm_operator::op_or: return "op_or";
+                case vm_operator::add: return "add";
+                case vm_operator::sub: return "sub";
+                case vm_operator::multiply: return "multiply";
+                case vm_operator::divide: return "divide";
+                case vm_operator::inc: return "inc";
+                case vm_operator::dec: return "dec";
+                case vm_operator::unary_negative: return "unary_negative";
+                case vm_operator::make_array: return "make_array";
+                case vm_operator::make_object: return "make_object";
+                case vm_operator::make_closure: return "make_closure";
+            }
+        }
+
+        // Numbers are written so that they read back as exactly the same double.
+        bool try_write_number(const value &input, std::string &result)
+        {
+            if (!input.is_number() || !std::isfinite(input.get_number()))
+            {
+                return false;
+            }
+
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.17g", input.get_number());
+            result = buffer;
+            if (result.find_first_of(".e") == std::string::npos)
+            {
+                result += ".0";
+            }
+            return true;
+        }
+
+        // The right hand side of an operator, either a constant from the code line or popped off the stack.
+        std::string operator_arg(const code_line &input, int line)
+        {
+            std::string number;
+            if (try_write_number(input.value, number))
+            {
+                return "value(" + number + ")";
+            }
+            return "code[" + std::to_string(line) + "].value";
+        }
+
+        std::string comment_text(const code_line &input)
+        {
+            auto result = input.to_string();
+            std::replace(result.begin(), result.end(), '\n', ' ');
+            std::replace(result.begin(), result.end(), '\r', ' ');
+            return result;
+        }
+
+        bool is_jump(vm_operator input)
+        {
+            return input == vm_operator::jump || input == vm_operator::jump_true || input == vm_operator::jump_false;
+        }
+    }
+
+    aot_compiler::aot_compiler(std::shared_ptr<script> target) : target(target), functions(collect_functions(*target))
+    {
+
+    }
+
+    std::string aot_compiler::compile(const std::string &source_name, const std::string &install_name) const
+    {
+        std::stringstream output;
+        output << "// Compiled from " << source_name << " by aotCompile, changes to the script need it to be compiled again.\n";
+        output << "#include \"aot_compiler.hpp\"\n";
+        output << "#include \"aot_runtime.hpp\"\n\n";
+        output << "namespace\n{\n";
+        output << "    using namespace lysithea_vm;\n";
+
+        for (auto i = 0; i < functions.size(); i++)
+        {
+            if (functions[i]->verified)
+            {
+                output << '\n';
+                compile_function(output, *functions[i], i);
+            }
+        }
+
+        output << "\n    const aot_function_info compiled_functions[] = {\n";
+        for (auto i = 0; i < functions.size(); i++)
+        {
+            output << "        aot_function_info(";
+            if (functions[i]->verified)
+            {
+                output << "function_" << i;
+            }
+            else
+            {
+                output << "nullptr";
+            }
+            output << ", " << fingerprint(*functions[i]) << "ull),\n";
+        }
+        output << "    };\n";
+        output << "}\n\n";
+
+        output << "void " << install_name << "(const lysithea_vm::script &input)\n{\n";
+        output << "    lysithea_vm::aot_compiler::install(input, compiled_functions, " << functions.size() << ");\n";
+        output << "}\n";
+
+        return output.str();
+    }
+
+    void aot_compiler::compile_function(std::ostream &output, const function &input, int index) const
+    {
+        const auto &code = input.code;
+        const auto end_line = static_cast<int>(code.size());
+
+        // Places the virtual machine can come back into the function, everything else is reached with a goto.
+        std::set<int> entries;
+        std::set<int> labels;
+        entries.insert(0);
+        for (const auto &iter : input.labels)
+        {
+            entries.insert(iter.second);
+        }
+
+        std::vector<bool> specialised(code.size());
+        for (auto i = 0; i < end_line; i++)
+        {
+            const auto &line = code[i];
+            auto is_const_key = line.value.is_complex() &&
+                (line.value.get_complex()->kind == complex_kind::string || line.value.get_complex()->kind == complex_kind::variable);
+            auto is_number = line.value.is_number() && std::isfinite(line.value.get_number());
+            auto is_num_arg = is_number || !line.has_value();
+            auto is_bool_arg = line.value.is_bool() || !line.has_value();
+
+            switch (line.op)
+            {
+                default: specialised[i] = false; break;
+
+                case vm_operator::push:
+                case vm_operator::call_direct:
+                case vm_operator::less_than:
+                case vm_operator::less_than_equals:
+                case vm_operator::greater_than:
+                case vm_operator::greater_than_equals:
+                case vm_operator::equals:
+                case vm_operator::not_equals:
+                case vm_operator::op_not:
+                case vm_operator::unary_negative:
+                    specialised[i] = true;
+                    break;
+
+                case vm_operator::get:
+                case vm_operator::get_move:
+                case vm_operator::set:
+                case vm_operator::define:
+                case vm_operator::inc:
+                case vm_operator::dec:
+                    specialised[i] = is_const_key;
+                    break;
+
+                case vm_operator::add:
+                case vm_operator::sub:
+                case vm_operator::multiply:
+                case vm_operator::divide:
+                    specialised[i] = is_num_arg;
+                    break;
+
+                case vm_operator::op_and:
+                case vm_operator::op_or:
+                    specialised[i] = is_bool_arg;
+                    break;
+
+                case vm_operator::jump:
+                case vm_operator::jump_true:
+                case vm_operator::jump_false:
+                    specialised[i] = input.jump_targets[i] >= 0;
+                    break;
+            }
+
+            if (is_jump(line.op) && specialised[i])
+            {
+                labels.insert(input.jump_targets[i]);
+            }
+            else if (line.op == vm_operator::call_direct || !specialised[i])
+            {
+                entries.insert(i + 1);
+            }
+        }
+        labels.insert(entries.begin(), entries.end());
+
+        output << "    // [" << input.name << "]";
+        if (input.symbols)
+        {
+            output << " in " << input.symbols->source_name;
+        }
+        output << "\n";
+        output << "    void function_" << index << "(virtual_machine &vm)\n    {\n";
+        output << "        const auto &code = vm.current_code->code;\n";
+        output << "        switch (aot_runtime::entry(vm))\n        {\n";
+        for (auto iter : entries)
+        {
+            output << "            case " << iter << ": goto line_" << iter << ";\n";
+        }
+        output << "            default: aot_runtime::step(vm, aot_runtime::entry(vm)); return;\n";
+        output << "        }\n";
+
+        for (auto i = 0; i < end_line; i++)
+        {
+            const auto &line = code[i];
+            const auto code_ref = "code[" + std::to_string(i) + "]";
+
+            output << '\n';
+            if (labels.find(i) != labels.end())
+            {
+                output << "    line_" << i << ":\n";
+            }
+            output << "        // " << comment_text(line) << "\n";
+
+            if (!specialised[i])
+            {
+                output << "        if (!aot_runtime::step(vm, " << i << ")) return;\n";
+                continue;
+            }
+
+            output << "        aot_runtime::line(vm, " << i << ", vm_operator::" << operator_name(line.op) << ");\n";
+
+            std::string number;
+            auto has_number = try_write_number(line.value, number);
+            auto right_arg = line.has_value() ? operator_arg(line, i) : std::string("right");
+            auto pop_right = line.has_value() ? "" : "            auto right = vm.pop_stack();\n";
+
+            switch (line.op)
+            {
+                default: break;
+
+                case vm_operator::push:
+                {
+                    if (has_number)
+                    {
+                        output << "        vm.push_stack(" << number << ");\n";
+                    }
+                    else
+                    {
+                        output << "        vm.push_stack(" << code_ref << ".value);\n";
+                    }
+                    break;
+                }
+                case vm_operator::call_direct:
+                {
+                    output << "        if (!aot_runtime::call_direct(vm, " << code_ref << ", " << i << ")) return;\n";
+                    break;
+                }
+                case vm_operator::get:
+                {
+                    output << "        aot_runtime::get(vm, " << i << ", " << code_ref << ");\n";
+                    break;
+                }
+                case vm_operator::get_move:
+                {
+                    output << "        aot_runtime::get_move(vm, " << i << ", " << code_ref << ");\n";
+                    break;
+                }
+                case vm_operator::set:
+                {
+                    output << "        aot_runtime::set(vm, " << i << ", " << code_ref << ");\n";
+                    break;
+                }
+                case vm_operator::define:
+                {
+                    output << "        aot_runtime::define(vm, " << code_ref << ".value.to_string());\n";
+                    break;
+                }
+                case vm_operator::inc:
+                {
+                    output << "        aot_runtime::inc(vm, " << i << ", " << code_ref << ", 1.0, \"Inc\");\n";
+                    break;
+                }
+                case vm_operator::dec:
+                {
+                    output << "        aot_runtime::inc(vm, " << i << ", " << code_ref << ", -1.0, \"Dec\");\n";
+                    break;
+                }
+                case vm_operator::jump:
+                {
+                    output << "        goto line_" << input.jump_targets[i] << ";\n";
+                    break;
+                }
+                case vm_operator::jump_true:
+                {
+                    output << "        if (vm.pop_stack().is_true()) goto line_" << input.jump_targets[i] << ";\n";
+                    break;
+                }
+                case vm_operator::jump_false:
+                {
+                    output << "        if (vm.pop_stack().is_false()) goto line_" << input.jump_targets[i] << ";\n";
+                    break;
+                }
+
+                case vm_operator::add:
+                case vm_operator::multiply:
+                {
+                    auto symbol = line.op == vm_operator::add ? " + " : " * ";
+                    if (has_number)
+                    {
+                        output << "        vm.push_stack(" << number << symbol << "vm.pop_stack_number());\n";
+                    }
+                    else
+                    {
+                        output << "        {\n";
+                        output << "            auto right = aot_runtime::pop_operator_num(vm);\n";
+                        output << "            vm.push_stack(right" << symbol << "vm.pop_stack_number());\n";
+                        output << "        }\n";
+                    }
+                    break;
+                }
+                case vm_operator::sub:
+                case vm_operator::divide:
+                {
+                    auto symbol = line.op == vm_operator::sub ? " - " : " / ";
+                    output << "        {\n";
+                    if (!has_number)
+                    {
+                        output << "            auto right = aot_runtime::pop_operator_num(vm);\n";
+                    }
+                    output << "            auto left = vm.pop_stack_number();\n";
+                    output << "            vm.push_stack(left" << symbol << (has_number ? number : "right") << ");\n";
+                    output << "        }\n";
+                    break;
+                }
+                case vm_operator::unary_negative:
+                {
+                    output << "        vm.push_stack(-vm.pop_stack_number());\n";
+                    break;
+                }
+
+                case vm_operator::less_than:
+                case vm_operator::less_than_equals:
+                case vm_operator::greater_than:
+                case vm_operator::greater_than_equals:
+                {
+                    auto compare =
+                        line.op == vm_operator::less_than ? " < 0" :
+                        line.op == vm_operator::less_than_equals ? " <= 0" :
+                        line.op == vm_operator::greater_than ? " > 0" : " >= 0";
+                    output << "        {\n" << pop_right;
+                    output << "            auto left = vm.pop_stack();\n";
+                    output << "            vm.push_stack(left.compare_to(" << right_arg << ")" << compare << ");\n";
+                    output << "        }\n";
+                    break;
+                }
+                case vm_operator::equals:
+                case vm_operator::not_equals:
+                {
+                    auto negate = line.op == vm_operator::not_equals ? "!" : "";
+                    output << "        {\n" << pop_right;
+                    output << "            auto left = vm.pop_stack();\n";
+                    output << "            vm.push_stack(" << negate << "left.equals(" << right_arg << "));\n";
+                    output << "        }\n";
+                    break;
+                }
+
+                case vm_operator::op_and:
+                case vm_operator::op_or:
+                {
+                    // The same short circuit as the interpreter, the left side is only popped when it is needed.
+                    auto symbol = line.op == vm_operator::op_and ? " && " : " || ";
+                    if (line.has_value())
+                    {
+                        output << "        vm.push_stack(" << (line.value.get_bool() ? "true" : "false") << symbol << "vm.pop_stack_bool());\n";
+                    }
+                    else
+                    {
+                        output << "        {\n";
+                        output << "            auto right = aot_runtime::pop_operator_bool(vm);\n";
+                        output << "            vm.push_stack(right" << symbol << "vm.pop_stack_bool());\n";
+                        output << "        }\n";
+                    }
+                    break;
+                }
+                case vm_operator::op_not:
+                {
+                    output << "        vm.push_stack(!vm.pop_stack_bool());\n";
+                    break;
+                }
+            }
+        }
+
+        output << '\n';
+        if (labels.find(end_line) != labels.end())
+        {
+            output << "    line_" << end_line << ":\n";
+        }
+        output << "        aot_runtime::end_of_code(vm, " << end_line << ");\n";
+        output << "    }\n";
+    }
+
+    std::vector<std::shared_ptr<function>> aot_compiler::collect_functions(const script &input)
+    {
+        std::vector<std::shared_ptr<function>> result;
+        std::unordered_set<const function *> found;
+        add_function(result, found, input.code);
+
+        if (input.builtin_scope)
+        {
+            // The keys are sorted so that the order doesn't depend on the hash order.
+            std::vector<std::string> keys;
+            for (const auto &iter : input.builtin_scope->values)
+            {
+                keys.push_back(iter.first);
+            }
+            std::sort(keys.begin(), keys.end());
+
+            for (const auto &key : keys)
+            {
+                add_code_value(result, found, input.builtin_scope->values.find(key)->second);
+            }
+        }
+
+        return result;
+    }
+
+    std::uint64_t aot_compiler::fingerprint(const function &input)
+    {
+        auto result = fnv_offset;
+        hash_pod(result, input.verified);
+        hash_pod(result, input.code.size());
+        for (auto i = 0; i < input.code.size(); i++)
+        {
+            hash_pod(result, static_cast<int>(input.code[i].op));
+            hash_value(result, input.code[i].value);
+            if (input.verified)
+            {
+                hash_pod(result, input.jump_targets[i]);
+            }
+        }
+
+        // Labels are where the compiled code can be come back into after a jump to a label from the stack.
+        std::vector<int> label_lines;
+        for (const auto &iter : input.labels)
+        {
+            label_lines.push_back(iter.second);
+        }
+        std::sort(label_lines.begin(), label_lines.end());
+        for (auto iter : label_lines)
+        {
+            hash_pod(result, iter);
+        }
+
+        return result;
+    }
+
+    void aot_compiler::install(const script &input, const aot_function_info *compiled, std::size_t count)
+    {
+        auto functions = collect_functions(input);
+        if (functions.size() != count)
+        {
+            throw std::runtime_error("Compiled script has " + std::to_string(count) + " functions but the loaded script has " + std::to_string(functions.size()));
+        }
+
+        // Everything is checked first so that a script isn't left half compiled.
+        for (auto i = 0; i < count; i++)
+        {
+            if (fingerprint(*functions[i]) != compiled[i].fingerprint)
+            {
+                throw std::runtime_error("Compiled function does not match the loaded script: " + functions[i]->name);
+            }
+        }
+
+        for (auto i = 0; i < count; i++)
+        {
+            functions[i]->native_body = compiled[i].body;
+        }
+    }
+} // lysithea_vm
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+#include "script.hpp"
+#include "function.hpp"
+
+namespace lysithea_vm
+{
+    // A compiled function body along with the fingerprint of the function it was compiled from.
+    class aot_function_info
+    {
+        public:
+            // Fields
+            aot_function_body body;
+            std::uint64_t fingerprint;
+
+            // Constructor
+            aot_function_info(aot_function_body body, std::uint64_t fingerprint) : body(body), fingerprint(fingerprint) { }
+    };
+
+    // Turns the functions of an assembled script into C++ source that can be compiled into the host program.
+    //
+    // Each function becomes straight line C++ that uses the same value and scope methods as the interpreter, with the
+    // jumps turned into gotos. The generated file has an install function which attaches the compiled bodies to the
+    // same script once the host has assembled it, the virtual machine then runs those instead of interpreting the code.
+    // Stack traces still work as the compiled code keeps the program counter up to date and the script's debug symbols are used.
+    class aot_compiler
+    {
+        public:
+            // Fields
+            std::shared_ptr<script> target;
+            std::vector<std::shared_ptr<function>> functions;
+
+            // Constructor
+            aot_compiler(std::shared_ptr<script> target);
+
+            // Methods
+            // Makes the C++ source for the script, install_name is the name of the function that installs it.
+            std::string compile(const std::string &source_name, const std::string &install_name) const;
+
+            // Finds every function in the script in the same order each time, the main code first and then the named functions.
+            static std::vector<std::shared_ptr<function>> collect_functions(const script &input);
+            // Changes if the code of the function changes in a way that the compiled version would not match.
+            static std::uint64_t fingerprint(const function &input);
+            // Throws if the script does not match the one that was compiled.
+            static void install(const script &input, const aot_function_info *compiled, std::size_t count);
+
+        private:
+            // Methods
+            void compile_function(std::ostream &output, const function &input, int index) const;
+    };
+} // lysithea_vm
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <string>
+#include <utility>
+
+#include "virtual_machine.hpp"
+#include "./values/array_value.hpp"
+#include "./values/string_value.hpp"
+#include "./values/variable_value.hpp"
+
+namespace lysithea_vm
+{
+    // The operations used by the C++ made by the aot_compiler.
+    //
+    // Each one does the same as the matching case in the virtual machine's step, including the errors it throws,
+    // so that compiled and interpreted functions behave the same. Anything not covered here is run by the interpreter one line at a time.
+    class aot_runtime
+    {
+        public:
+            // Methods
+            // Where a compiled function should carry on from, the start of the function or the line after a call.
+            static inline int entry(virtual_machine &vm)
+            {
+                return vm.program_counter;
+            }
+
+            // Keeps the program counter where the interpreter would have it, so that stack traces and calls see the right line.
+            static inline void line(virtual_machine &vm, int line, vm_operator op)
+            {
+                vm.program_counter = line + 1;
+                vm.memory->current_operator = op;
+            }
+
+            // Runs one line with the interpreter, returns false if the compiled function has to hand back to the virtual machine,
+            // eg: a script function was called, it returned, it jumped to a label that was only known at run time or the virtual machine was paused.
+            static inline bool step(virtual_machine &vm, int line)
+            {
+                auto code = vm.current_code.get();
+                auto depth = vm.stack_trace.stack_size();
+                vm.program_counter = line;
+                vm.step_impl<true>();
+                return carried_on(vm, code, depth, line);
+            }
+
+            static inline bool call_direct(virtual_machine &vm, const code_line &input, int line)
+            {
+                auto code = vm.current_code.get();
+                auto depth = vm.stack_trace.stack_size();
+                const auto &array_input = static_cast<const array_value *>(input.value.get_complex().get())->data;
+                vm.call_function(*array_input[0].get_complex(), array_input[1].get_int(), true);
+                return carried_on(vm, code, depth, line);
+            }
+
+            static inline void end_of_code(virtual_machine &vm, int line)
+            {
+                vm.program_counter = line;
+                if (!vm.try_return())
+                {
+                    vm.running = false;
+                }
+            }
+
+            // The variable's name is only made from the line if the lookup cache can not be used.
+            static inline void get(virtual_machine &vm, int line, const code_line &input)
+            {
+                if (auto found = vm.find_variable(line, input))
+                {
+                    vm.push_stack(found->variable());
+                }
+                else
+                {
+                    throw virtual_machine_error(vm.create_stack_trace(), std::string("Unable to find value to get: ") + input.value.to_string());
+                }
+            }
+
+            static inline void get_move(virtual_machine &vm, int line, const code_line &input)
+            {
+                if (auto variable = vm.writable_variable(vm.find_variable(line, input)))
+                {
+                    vm.push_moved(*variable);
+                    return;
+                }
+
+                auto key = input.value.to_string();
+                vm.prepare_scope_write(key);
+                if (auto variable = vm.writable_variable(vm.find_variable(line, input)))
+                {
+                    vm.push_moved(*variable);
+                    return;
+                }
+
+                value found_value;
+                if (vm.current_scope->try_get_key(key, found_value) ||
+                    (vm.builtin_scope && vm.builtin_scope->try_get_key(key, found_value)))
+                {
+                    vm.push_stack(std::move(found_value));
+                }
+                else
+                {
+                    throw virtual_machine_error(vm.create_stack_trace(), std::string("Unable to find value to get: ") + key);
+                }
+            }
+
+            static inline void define(virtual_machine &vm, const std::string &key)
+            {
+                auto value = vm.pop_stack();
+                vm.writable_current_scope().try_define(key, std::move(value));
+            }
+
+            static inline void set(virtual_machine &vm, int line, const code_line &input)
+            {
+                vm.moved_variable = nullptr;
+                auto value = vm.pop_stack();
+                if (auto variable = vm.writable_variable(vm.find_variable(line, input)))
+                {
+                    *variable = std::move(value);
+                    return;
+                }
+
+                auto key = input.value.to_string();
+                vm.prepare_scope_write(key);
+                if (!vm.current_scope->try_set(key, std::move(value)))
+                {
+                    throw virtual_machine_error(vm.create_stack_trace(), "Unable to set variable that has not been defined: " + key);
+                }
+            }
+
+            static inline void inc(virtual_machine &vm, int line, const code_line &input, double amount, const char *name)
+            {
+                auto variable = vm.writable_variable(vm.find_variable(line, input));
+                if (variable && variable->is_number())
+                {
+                    *variable = value(variable->get_number() + amount);
+                    return;
+                }
+
+                auto key = input.value.to_string();
+                double found_value;
+                if (!vm.current_scope->try_get_number(key, found_value))
+                {
+                    throw virtual_machine_error(vm.create_stack_trace(), std::string(name) + " operator could not find variable or was not a number");
+                }
+                vm.prepare_scope_write(key);
+                vm.current_scope->try_set(key, value(found_value + amount));
+            }
+
+            static inline double pop_operator_num(virtual_machine &vm)
+            {
+                auto result = vm.pop_stack();
+                if (result.is_number())
+                {
+                    return result.get_number();
+                }
+
+                throw std::runtime_error("Unable to get number argument");
+            }
+
+            static inline bool pop_operator_bool(virtual_machine &vm)
+            {
+                auto result = vm.pop_stack();
+                if (result.is_bool())
+                {
+                    return result.get_bool();
+                }
+
+                throw std::runtime_error("Unable to get boolean argument");
+            }
+
+        private:
+            // Methods
+            static inline bool carried_on(const virtual_machine &vm, const function *code, int depth, int line)
+            {
+                return vm.running && !vm.paused && vm.current_code.get() == code &&
+                    vm.stack_trace.stack_size() == depth && vm.program_counter == line + 1;
+            }
+    };
+} // lysithea_vm
@@ -2,7 +2,11 @@
 
 #include <iostream>
 #include <sstream>
+#include <map>
 #include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 #include "./tokeniser.hpp"
 #include "./lexer.hpp"
@@ -14,6 +18,7 @@
 #include "../errors/error_common.hpp"
 #include "../standard_library/standard_math_library.hpp"
 #include "../virtual_machine.hpp"
+#include "../verifier.hpp"
 
 namespace lysithea_vm
 {
@@ -30,7 +35,7 @@ namespace lysithea_vm
     const std::string assembler::keyword_jump("jump");
     const std::string assembler::keyword_return("return");
 
-    assembler::assembler() : label_count(0), const_scope(std::make_shared<scope>())
+    assembler::assembler() : assembly_threads(1), inline_budget(8), label_count(0), const_scope(std::make_shared<scope>()), recording_form(nullptr), hidden_functions(nullptr), hidden_from(0)
     {
 
     }
@@ -46,6 +51,7 @@ namespace lysithea_vm
         this->source_text = tokeniser::split_stream(input);
         this->source_name = source_name;
         this->const_scope->clear();
+        this->function_stack.clear();
 
         auto parsed = lexer::read_from_text(source_name, *source_text);
         return parse_from_value(parsed);
@@ -54,16 +60,275 @@ namespace lysithea_vm
     std::shared_ptr<script> assembler::parse_from_value(const token &input)
     {
         auto code = parse_global_function(input);
+        return make_script(code);
+    }
 
+    std::shared_ptr<script> assembler::make_script(std::shared_ptr<function> code) const
+    {
         auto script_scope = std::make_shared<scope>();
         script_scope->combine_scope(builtin_scope);
-        script_scope->combine_scope(const_scope);
+        script_scope->combine_scope(*const_scope);
 
         return std::make_shared<script>(script_scope, code);
     }
 
+    std::shared_ptr<script> assembler::reassemble_from_text(const std::string &source_name, const std::string &input)
+    {
+        std::stringstream stream(input);
+        return reassemble_from_stream(source_name, stream);
+    }
+
+    std::shared_ptr<script> assembler::reassemble_from_stream(const std::string &source_name, std::istream &input)
+    {
+        if (source_name != incremental_source_name)
+        {
+            clear_incremental_cache();
+            incremental_source_name = source_name;
+        }
+
+        this->source_text = tokeniser::split_stream(input);
+        this->source_name = source_name;
+        this->const_scope = std::make_shared<scope>();
+        this->loop_stack.clear();
+        this->keyword_parsing_stack.clear();
+        this->function_stack.clear();
+
+        auto parsed = lexer::read_from_text(source_name, *source_text);
+        auto code = parse_incremental_function(parsed);
+        return make_script(code);
+    }
+
+    void assembler::clear_incremental_cache()
+    {
+        form_cache.clear();
+        incremental_functions.clear();
+        incremental_source_name.clear();
+    }
+
+    std::shared_ptr<function> assembler::parse_incremental_function(const token &input)
+    {
+        std::unordered_map<std::size_t, int> occurrences;
+        std::unordered_map<std::size_t, bool> used_forms;
+        code_line_list temp_code_lines;
+
+        for (const auto &iter : input.list_data)
+        {
+            const auto &form = *iter;
+
+            // Forms are keyed by their source text and starting column, identical forms are told apart by the order they appear in.
+            auto text = get_source_text(form.location);
+            auto key = hash_combine(std::hash<std::string>()(text), static_cast<std::size_t>(form.location.start_column_number));
+            key = hash_combine(key, static_cast<std::size_t>(occurrences[key]++));
+            used_forms[key] = true;
+
+            auto find = form_cache.find(key);
+            if (find != form_cache.end() && find->second.text == text && is_cached_form_valid(find->second))
+            {
+                reuse_cached_form(find->second, form);
+                push_range(temp_code_lines, find->second.code_lines);
+                continue;
+            }
+
+            cached_form cached;
+            cached.text = text;
+            cached.location = form.location;
+
+            recording_form = &cached;
+            try
+            {
+                cached.code_lines = parse(form);
+            }
+            catch (...)
+            {
+                recording_form = nullptr;
+                throw;
+            }
+            recording_form = nullptr;
+
+            push_range(temp_code_lines, cached.code_lines);
+            form_cache[key] = cached;
+        }
+
+        // Remove any forms that are no longer in the source.
+        for (auto iter = form_cache.begin(); iter != form_cache.end();)
+        {
+            if (used_forms.find(iter->first) == used_forms.end())
+            {
+                iter = form_cache.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+
+        // Remove any functions that were not defined on this pass, if they come back they are a new function.
+        for (auto iter = incremental_functions.begin(); iter != incremental_functions.end();)
+        {
+            value current;
+            if (!const_scope->try_get_key(iter->first, current) || current.get_complex().get() != iter->second.get())
+            {
+                iter = incremental_functions.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+
+        std::vector<std::string> empty_parameters;
+        return process_temp_function(empty_parameters, temp_code_lines, "global");
+    }
+
+    bool assembler::is_cached_form_valid(const cached_form &form) const
+    {
+        // A form can only be reused if every constant it looked up still resolves to the same value.
+        for (const auto &dependency : form.dependencies)
+        {
+            value current;
+            auto found = const_scope->try_get_key(dependency.first, current);
+            if (dependency.second.is_undefined())
+            {
+                if (found)
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            if (!found || current.type != dependency.second.type)
+            {
+                return false;
+            }
+
+            if (current.is_complex())
+            {
+                if (current.get_complex() != dependency.second.get_complex())
+                {
+                    return false;
+                }
+            }
+            else if (current.compare_to(dependency.second) != 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void assembler::reuse_cached_form(cached_form &form, const token &input)
+    {
+        auto line_delta = input.location.start_line_number - form.location.start_line_number;
+        if (line_delta != 0)
+        {
+            for (auto &line : form.code_lines)
+            {
+                line.argument.location.start_line_number += line_delta;
+                line.argument.location.end_line_number += line_delta;
+            }
+        }
+
+        // Functions from the form keep their code but need to point at the new source text.
+        for (auto &func : form.functions)
+        {
+            std::vector<code_location> locations(func->symbols->code_line_to_text);
+            for (auto &location : locations)
+            {
+                location.start_line_number += line_delta;
+                location.end_line_number += line_delta;
+            }
+            func->symbols = std::make_shared<debug_symbols>(source_name, source_text, locations);
+        }
+
+        for (const auto &constant : form.constants)
+        {
+            if (!const_scope->try_set_constant(constant.first, constant.second))
+            {
+                throw make_error(input, "Cannot redefine a constant");
+            }
+        }
+
+        form.location = input.location;
+    }
+
+    std::string assembler::get_source_text(const code_location &location) const
+    {
+        const auto &lines = *source_text;
+        auto end_line = std::min(location.end_line_number, static_cast<int>(lines.size()) - 1);
+
+        std::stringstream ss;
+        for (auto i = location.start_line_number; i <= end_line; i++)
+        {
+            const auto &line = lines[i];
+            auto start = i == location.start_line_number ? std::min(static_cast<int>(line.size()), location.start_column_number) : 0;
+            auto end = i == location.end_line_number ? std::min(static_cast<int>(line.size()), location.end_column_number) : static_cast<int>(line.size());
+            if (end > start)
+            {
+                ss << line.substr(start, end - start);
+            }
+            ss << '\n';
+        }
+        return ss.str();
+    }
+
+    bool assembler::try_get_const(const std::string &key, value &result)
+    {
+        auto found = false;
+        auto is_root = false;
+        for (auto current = const_scope.get(); current != nullptr; current = current->parent.get())
+        {
+            auto find = current->values.find(key);
+            if (find != current->values.end())
+            {
+                result = find->second;
+                found = true;
+                is_root = !current->parent;
+                break;
+            }
+        }
+
+        if (found && is_root && hidden_functions)
+        {
+            auto hidden = hidden_functions->find(key);
+            if (hidden != hidden_functions->end() && hidden->second >= hidden_from)
+            {
+                found = false;
+            }
+        }
+
+        // Keep track of constant look ups outside of the form so that the form can be invalidated when they change.
+        if (recording_form && (!found || is_root))
+        {
+            for (const auto &constant : recording_form->constants)
+            {
+                if (constant.first == key)
+                {
+                    return found;
+                }
+            }
+            recording_form->dependencies.emplace_back(key, found ? result : value());
+        }
+
+        return found;
+    }
+
+    void assembler::record_constant(const std::string &key, value input)
+    {
+        if (recording_form && !const_scope->parent)
+        {
+            recording_form->constants.emplace_back(key, input);
+        }
+    }
+
     std::shared_ptr<function> assembler::parse_global_function(const token &input)
     {
+        auto num_threads = assembly_threads > 0 ? assembly_threads : static_cast<int>(std::thread::hardware_concurrency());
+        if (num_threads > 1)
+        {
+            return parse_parallel_global_function(input, num_threads);
+        }
+
         code_line_list temp_code_lines;
         for (const auto &iter : input.list_data)
         {
@@ -77,6 +342,151 @@ namespace lysithea_vm
         return code;
     }
 
+    std::shared_ptr<function> assembler::parse_parallel_global_function(const token &input, int num_threads)
+    {
+        // Top level functions are hoisted out and their bodies are assembled on worker threads.
+        // Each body sees the constants as they were at its position in the script, so the output matches the sequential assembly.
+        code_line_list temp_code_lines;
+        std::vector<function_job> jobs;
+        std::shared_ptr<scope> snapshot;
+        std::shared_ptr<std::unordered_map<std::string, std::size_t>> snapshot_functions;
+        std::uint64_t snapshot_version = 0;
+        std::exception_ptr form_error;
+
+        for (const auto &iter : input.list_data)
+        {
+            try
+            {
+                if (!is_named_function(*iter))
+                {
+                    push_range(temp_code_lines, parse(*iter));
+                    continue;
+                }
+
+                // Functions next to each other share a snapshot and hide the ones from themselves onwards,
+                // so it only needs to be copied again when a constant has been added some other way.
+                if (!snapshot || snapshot_version != const_scope->version)
+                {
+                    snapshot = std::make_shared<scope>();
+                    snapshot->combine_scope(*const_scope);
+                    snapshot_functions = std::make_shared<std::unordered_map<std::string, std::size_t>>();
+                }
+
+                auto name = iter->list_data[1]->token_value.to_string();
+                auto placeholder = std::make_shared<function_value>(function_ptr());
+                if (!const_scope->try_set_constant(name, value(placeholder)))
+                {
+                    throw make_error(*iter, "Unable to define function, constant already exists");
+                }
+                snapshot->try_set_constant(name, value(placeholder));
+                snapshot_version = const_scope->version;
+
+                auto function_index = snapshot_functions->size();
+                (*snapshot_functions)[name] = function_index;
+                jobs.emplace_back(iter.get(), snapshot, placeholder, snapshot_functions, function_index);
+                pending_functions.insert(placeholder.get());
+            }
+            catch (...)
+            {
+                // The rest of the script is skipped, only the functions before this form could have an earlier error.
+                form_error = std::current_exception();
+                break;
+            }
+        }
+
+        // Each thread gets its own assembler so that none of the parsing state is shared.
+        std::atomic<std::size_t> next_job(0);
+        auto worker = [this, &jobs, &next_job]()
+        {
+            assembler thread_assembler;
+            thread_assembler.builtin_scope = builtin_scope;
+            thread_assembler.source_name = source_name;
+            thread_assembler.source_text = source_text;
+            thread_assembler.inline_budget = inline_budget;
+            thread_assembler.pending_functions = pending_functions;
+
+            for (auto i = next_job++; i < jobs.size(); i = next_job++)
+            {
+                thread_assembler.parse_function_job(jobs[i]);
+            }
+        };
+
+        num_threads = std::min(num_threads, static_cast<int>(jobs.size()));
+        if (num_threads > 1)
+        {
+            std::vector<std::thread> threads;
+            for (auto i = 0; i < num_threads; i++)
+            {
+                threads.emplace_back(worker);
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        }
+        else
+        {
+            worker();
+        }
+
+        pending_functions.clear();
+
+        // Report the first error in script order so that the result does not depend on thread timing.
+        for (const auto &job : jobs)
+        {
+            if (job.error)
+            {
+                std::rethrow_exception(job.error);
+            }
+        }
+        if (form_error)
+        {
+            std::rethrow_exception(form_error);
+        }
+
+        std::vector<std::string> empty_parameters;
+        return process_temp_function(empty_parameters, temp_code_lines, "global");
+    }
+
+    void assembler::parse_function_job(function_job &job)
+    {
+        // Labels only need to be unique within a function, so each job starts from the same state.
+        label_count = 0;
+        loop_stack.clear();
+        keyword_parsing_stack.clear();
+        keyword_parsing_stack.push_back(keyword_function);
+        function_stack.clear();
+        const_scope = job.const_scope;
+        hidden_functions = job.shared_functions.get();
+        hidden_from = job.function_index;
+
+        try
+        {
+            job.placeholder->data = parse_function(*job.input);
+        }
+        catch (...)
+        {
+            job.error = std::current_exception();
+        }
+    }
+
+    bool assembler::is_named_function(const token &input)
+    {
+        if (input.type != token_type::expression || input.list_data.size() < 3)
+        {
+            return false;
+        }
+
+        auto keyword = input.list_data[0]->token_value.get_complex<const variable_value>();
+        if (!keyword || keyword->is_label() || keyword->data != keyword_function)
+        {
+            return false;
+        }
+
+        const auto &name = input.list_data[1]->token_value;
+        return name.get_complex<const variable_value>() || name.get_complex<const string_value>();
+    }
+
     assembler::code_line_list assembler::parse(const token &input)
     {
         code_line_list result;
@@ -115,12 +525,23 @@ namespace lysithea_vm
                     keyword_parsing_stack.push_back("func-call");
 
                     // Handle general opcode or function call.
+                    // The last line of each argument is kept to check if it is unpacked when inlining.
+                    code_line_list argument_ends;
                     for (auto iter = input.list_data.cbegin() + 1; iter != input.list_data.cend(); ++iter)
                     {
-                        push_range(result, parse(*iter->get()));
+                        auto argument_lines = parse(*iter->get());
+                        if (argument_lines.size() > 0)
+                        {
+                            argument_ends.push_back(argument_lines.back());
+                        }
+                        push_range(result, argument_lines);
                     }
 
-                    push_range(result, optimise_call_symbol_value(first_token, first_symbol_value->data, input.list_data.size() - 1));
+                    auto call_lines = optimise_call_symbol_value(first_token, first_symbol_value->data, input.list_data.size() - 1);
+                    if (!try_inline_call(input, call_lines, argument_ends, result))
+                    {
+                        push_range(result, call_lines);
+                    }
 
                     keyword_parsing_stack.pop_back();
 
@@ -241,6 +662,10 @@ namespace lysithea_vm
         auto op_code = is_define ? vm_operator::define : vm_operator::set;
         // Parse the last value as the definable/set-able value.
         auto result = parse(*input.list_data.back());
+        if (!is_define && input.list_data.size() == 3)
+        {
+            optimise_move_to_builtin(get_value(*input.list_data[1]).to_string(), result);
+        }
 
         // Loop over all the middle inputs as the values to set.
         // Multiple variables can be set when a function returns multiple results.
@@ -251,6 +676,89 @@ namespace lysithea_vm
         return result;
     }
 
+    void assembler::optimise_move_to_builtin(const std::string &variable, code_line_list &input) const
+    {
+        // Looks for (set x (builtin x ...)) where the builtin can update x in place, string concat appends to a unique first string.
+        if (input.size() < 2 || input[0].op != vm_operator::get || get_value(input[0].argument).to_string() != variable)
+        {
+            return;
+        }
+
+        const auto &last = input.back();
+        if (last.op == vm_operator::call_direct)
+        {
+            auto call_value = get_value(last.argument).get_complex<const array_value>();
+            auto builtin = call_value->data[0].get_complex<const builtin_function_value>();
+            if (!builtin || !builtin->can_update_in_place)
+            {
+                return;
+            }
+        }
+        else if (last.op != vm_operator::string_concat)
+        {
+            return;
+        }
+
+        // The variable is empty until it is set again so nothing between can be allowed to look it up.
+        for (auto i = 1; i < input.size() - 1; i++)
+        {
+            const auto &line = input[i];
+            switch (line.op)
+            {
+                default: return;
+
+                case vm_operator::get:
+                {
+                    if (line.argument.type != token_type::value || get_value(line.argument).to_string() == variable)
+                    {
+                        return;
+                    }
+                    break;
+                }
+
+                case vm_operator::get_property:
+                {
+                    // Straight after the variable would mean the property is passed instead of the variable.
+                    if (i == 1 || line.argument.type != token_type::value)
+                    {
+                        return;
+                    }
+                    break;
+                }
+
+                case vm_operator::push:
+                {
+                    // A nested function that captures the variable would capture it while it is empty.
+                    auto nested = line.argument.type == token_type::value ? get_value(line.argument).get_complex<const function_value>() : nullptr;
+                    if (nested && std::find(nested->data->captures.begin(), nested->data->captures.end(), variable) != nested->data->captures.end())
+                    {
+                        return;
+                    }
+                    break;
+                }
+
+                case vm_operator::string_concat:
+                case vm_operator::greater_than:
+                case vm_operator::greater_than_equals:
+                case vm_operator::equals:
+                case vm_operator::not_equals:
+                case vm_operator::less_than:
+                case vm_operator::less_than_equals:
+                case vm_operator::op_not:
+                case vm_operator::add:
+                case vm_operator::sub:
+                case vm_operator::multiply:
+                case vm_operator::divide:
+                case vm_operator::unary_negative:
+                case vm_operator::make_array:
+                case vm_operator::make_object:
+                    break;
+            }
+        }
+
+        input[0].op = vm_operator::get_move;
+    }
+
     assembler::code_line_list assembler::parse_const(const token &input)
     {
         if (input.list_data.size() != 3)
@@ -265,10 +773,12 @@ namespace lysithea_vm
         }
 
         auto key = get_value(*input.list_data[1]).to_string();
-        if (!const_scope->try_set_constant(key, get_value(result[0].argument)))
+        auto const_value = get_value(result[0].argument);
+        if (!const_scope->try_set_constant(key, const_value))
         {
             throw make_error(input, "Cannot redefine a constant");
         }
+        record_constant(key, const_value);
 
         return result;
     }
@@ -451,7 +961,7 @@ namespace lysithea_vm
             auto name_string_check = input.list_data[1]->token_value.get_complex<const string_value>();
             if (name_string_check)
             {
-                name = name_string_check->data;
+                name = name_string_check->to_string();
                 offset = 1;
             }
         }
@@ -463,13 +973,31 @@ namespace lysithea_vm
             parameters.emplace_back(get_value(*iter).to_string());
         }
 
+        // The variables are found before parsing the body so that nested functions know which ones they can capture.
+        function_stack.emplace_back();
+        for (const auto &parameter : parameters)
+        {
+            function_stack.back().locals.insert(starts_with_unpack(parameter) ? parameter.substr(3) : parameter);
+        }
+        for (auto i = 2 + offset; i < input.list_data.size(); i++)
+        {
+            find_local_names(*input.list_data[i], function_stack.back());
+        }
+
         code_line_list temp_code_lines;
         for (auto i = 2 + offset; i < input.list_data.size(); i++)
         {
             push_range(temp_code_lines, parse(*input.list_data[i]));
         }
 
-        auto result = process_temp_function(parameters, temp_code_lines, name);
+        auto captures = capture_variables(temp_code_lines);
+        function_stack.pop_back();
+
+        auto result = process_temp_function(parameters, temp_code_lines, name, captures);
+        if (!function_stack.empty())
+        {
+            function_stack.back().nested_functions.insert(result.get());
+        }
         if (!const_scope->parent)
         {
             throw make_error(input, "Internal exception, const scope parent lost");
@@ -477,6 +1005,11 @@ namespace lysithea_vm
 
         const_scope = const_scope->parent;
 
+        if (recording_form)
+        {
+            recording_form->functions.push_back(result);
+        }
+
         return result;
     }
 
@@ -504,10 +1037,257 @@ namespace lysithea_vm
         {
             push_range(result, parse(*iter->get()));
         }
+
+        // Returning the result of a single call from a function can reuse the current call frame.
+        if (input.list_data.size() == 2 && result.size() > 0 && is_inside_function())
+        {
+            auto &last = result.back();
+            if (last.op == vm_operator::call || last.op == vm_operator::call_direct)
+            {
+                last.op = vm_operator::tail_call;
+                return result;
+            }
+        }
+
         result.emplace_back(vm_operator::call_return, input.to_empty());
         return result;
     }
 
+    bool assembler::is_inside_function() const
+    {
+        // The last keyword is the one currently being parsed.
+        if (keyword_parsing_stack.size() < 2)
+        {
+            return false;
+        }
+
+        auto end = keyword_parsing_stack.end() - 1;
+        return std::find(keyword_parsing_stack.begin(), end, keyword_function) != end;
+    }
+
+    bool assembler::try_inline_call(const token &input, const code_line_list &call_lines, const code_line_list &argument_ends, code_line_list &result)
+    {
+        // Inlining is skipped while reassembling so that hot swapped functions are always called.
+        if (inline_budget <= 0 || recording_form || call_lines.size() != 1 || call_lines[0].op != vm_operator::call_direct)
+        {
+            return false;
+        }
+
+        auto call_value = get_value(call_lines[0].argument).get_complex<const array_value>();
+        auto callee_value = call_value->data[0].get_complex<lysithea_vm::function_value>();
+        if (!callee_value || pending_functions.find(callee_value.get()) != pending_functions.end() || !callee_value->data)
+        {
+            return false;
+        }
+
+        auto callee = callee_value->data;
+        auto num_args = call_value->data[1].get_int();
+        if (!can_inline_function(*callee, argument_ends, num_args))
+        {
+            return false;
+        }
+
+        // Locals of the callee are renamed so that they don't clash with the caller's variables.
+        std::stringstream ss_suffix;
+        ss_suffix << "#inline" << label_count++;
+        auto suffix = ss_suffix.str();
+
+        std::unordered_set<std::string> locals(callee->parameters.begin(), callee->parameters.end());
+        for (const auto &line : callee->code)
+        {
+            if (line.op == vm_operator::define)
+            {
+                locals.insert(line.value.to_string());
+            }
+        }
+
+        std::map<int, std::vector<std::string>> labels_at_line;
+        for (const auto &label : callee->labels)
+        {
+            labels_at_line[label.second].push_back(label.first + suffix);
+        }
+        for (auto &labels : labels_at_line)
+        {
+            std::sort(labels.second.begin(), labels.second.end());
+        }
+
+        auto end_label = std::make_shared<string_value>(":InlineEnd" + suffix);
+
+        // The arguments are already on the stack with the last argument on top.
+        for (auto i = static_cast<int>(callee->parameters.size()) - 1; i >= 0; i--)
+        {
+            result.emplace_back(vm_operator::define, input.keep_location(value(callee->parameters[i] + suffix)));
+        }
+
+        const auto &locations = callee->symbols->code_line_to_text;
+        for (auto i = 0; i < callee->code.size(); i++)
+        {
+            auto find_labels = labels_at_line.find(i);
+            if (find_labels != labels_at_line.end())
+            {
+                for (const auto &label : find_labels->second)
+                {
+                    result.emplace_back(label);
+                }
+            }
+
+            const auto &line = callee->code[i];
+            auto line_token = line.has_value() ? token(locations[i], line.value) : token(locations[i]);
+
+            auto op = line.op;
+            auto is_return = op == vm_operator::call_return || op == vm_operator::tail_call;
+            if (op == vm_operator::tail_call)
+            {
+                op = line.value.is_number() ? vm_operator::call : vm_operator::call_direct;
+            }
+
+            switch (op)
+            {
+                default: break;
+
+                case vm_operator::get:
+                case vm_operator::get_move:
+                case vm_operator::set:
+                case vm_operator::define:
+                case vm_operator::inc:
+                case vm_operator::dec:
+                {
+                    auto key = line.value.to_string();
+                    if (locals.find(key) != locals.end())
+                    {
+                        line_token = token(locations[i], std::make_shared<string_value>(key + suffix));
+                    }
+                    break;
+                }
+
+                case vm_operator::jump:
+                case vm_operator::jump_true:
+                case vm_operator::jump_false:
+                {
+                    line_token = token(locations[i], std::make_shared<string_value>(line.value.to_string() + suffix));
+                    break;
+                }
+            }
+
+            if (op != vm_operator::call_return)
+            {
+                result.emplace_back(op, line_token);
+            }
+
+            // Returning from the middle of the callee skips over the rest of its code.
+            if (is_return && i < callee->code.size() - 1)
+            {
+                result.emplace_back(vm_operator::jump, token(locations[i], end_label));
+            }
+        }
+
+        auto find_end_labels = labels_at_line.find(callee->code.size());
+        if (find_end_labels != labels_at_line.end())
+        {
+            for (const auto &label : find_end_labels->second)
+            {
+                result.emplace_back(label);
+            }
+        }
+        result.emplace_back(end_label->to_string());
+
+        // The renamed locals are left in the caller's scope, so clear them to not keep their values alive.
+        std::vector<std::string> sorted_locals(locals.begin(), locals.end());
+        std::sort(sorted_locals.begin(), sorted_locals.end());
+        for (const auto &local : sorted_locals)
+        {
+            result.emplace_back(vm_operator::push, input.keep_location(value::make_null()));
+            result.emplace_back(vm_operator::define, input.keep_location(value(local + suffix)));
+        }
+
+        return true;
+    }
+
+    bool assembler::can_inline_function(const function &input, const code_line_list &argument_ends, int num_args) const
+    {
+        if (input.code.size() > inline_budget || input.parameters.size() != num_args ||
+            !input.symbols || input.symbols->full_text != source_text ||
+            input.symbols->code_line_to_text.size() != input.code.size())
+        {
+            return false;
+        }
+
+        for (const auto &parameter : input.parameters)
+        {
+            if (starts_with_unpack(parameter))
+            {
+                return false;
+            }
+        }
+
+        // Unpacked arguments change the number of values passed at runtime.
+        for (const auto &line : argument_ends)
+        {
+            if (line.op == vm_operator::to_argument)
+            {
+                return false;
+            }
+        }
+
+        auto has_locals = input.parameters.size() > 0;
+        auto calls_script = false;
+        for (const auto &line : input.code)
+        {
+            switch (line.op)
+            {
+                default: break;
+
+                case vm_operator::define:
+                    has_locals = true;
+                    // Fall through to check that the name is known.
+                case vm_operator::get:
+                case vm_operator::set:
+                case vm_operator::jump:
+                case vm_operator::jump_true:
+                case vm_operator::jump_false:
+                {
+                    if (!line.has_value())
+                    {
+                        return false;
+                    }
+                    break;
+                }
+
+                case vm_operator::push:
+                {
+                    // Nested functions would not be able to see the renamed locals.
+                    if (line.value.get_complex<const function_value>())
+                    {
+                        return false;
+                    }
+                    break;
+                }
+
+                case vm_operator::make_closure:
+                    return false;
+
+                case vm_operator::call:
+                {
+                    calls_script = true;
+                    break;
+                }
+
+                case vm_operator::call_direct:
+                case vm_operator::tail_call:
+                {
+                    if (line.value.is_number() || line.value.get_complex<const array_value>()->data[0].get_complex<const function_value>())
+                    {
+                        calls_script = true;
+                    }
+                    break;
+                }
+            }
+        }
+
+        // Scopes are dynamic so any script function called by the callee could be looking up its locals by name.
+        return !(has_locals && calls_script);
+    }
+
     assembler::code_line_list assembler::parse_function_keyword(const token &input)
     {
         auto function = parse_function(input);
@@ -516,10 +1296,26 @@ namespace lysithea_vm
 
         if (keyword_parsing_stack.size() == 1 && function->has_name)
         {
+            if (recording_form)
+            {
+                // Swap the code of a previously assembled function so that anything already referencing it picks up the change.
+                auto find = incremental_functions.find(function->name);
+                if (find != incremental_functions.end())
+                {
+                    find->second->data = function;
+                    function_value = find->second;
+                }
+                else
+                {
+                    incremental_functions[function->name] = function_value;
+                }
+            }
+
             if (!const_scope->try_set_constant(function->name, value(function_value)))
             {
                 throw make_error(input, "Unable to define function, constant already exists");
             }
+            record_constant(function->name, value(function_value));
 
             // Special return case
             result.emplace_back(vm_operator::unknown, token(code_location()));
@@ -759,7 +1555,7 @@ namespace lysithea_vm
         code_line_list result;
 
         value found_const;
-        if (const_scope->try_get_key(variable, found_const))
+        if (try_get_const(variable, found_const))
         {
             result.emplace_back(vm_operator::push, input.keep_location(found_const));
             return result;
@@ -771,13 +1567,16 @@ namespace lysithea_vm
 
         value found_parent;
         // Check if we know about the parent object? (eg: string.length, the parent is the string object)
-        if (builtin_scope.try_get_key(parent_key->data, found_parent))
+        if (builtin_scope.try_get_key(parent_key->to_string(), found_parent))
         {
             // If the get is for a property? (eg: string.length, length is the property)
             if (is_property)
             {
+                // Properties of native objects can change so they are never looked up at compile time.
+                auto is_native_object = found_parent.is_complex() && found_parent.get_complex()->kind == complex_kind::native_object;
+
                 value found_property;
-                if (try_get_property(found_parent, *property, found_property))
+                if (!is_native_object && try_get_property(found_parent, *property, found_property))
                 {
                     // If we found the property then we're done and we can just push that known value onto the stack.
                     result.emplace_back(vm_operator::push, input.keep_location(found_property));
@@ -816,23 +1615,192 @@ namespace lysithea_vm
         if (find != input.npos)
         {
             auto split = string_split(input, ".");
-            parent_key = std::make_shared<string_value>(split[0]);
+            parent_key = string_value::intern(split[0]);
 
             array_vector property_vector;
             for (auto i = 1; i < split.size(); i++)
             {
-                property_vector.emplace_back(std::make_shared<string_value>(split[i]));
+                property_vector.emplace_back(string_value::intern(split[i]));
             }
             property = std::make_shared<array_value>(property_vector, false);
 
             return true;
         }
 
-        parent_key = std::make_shared<string_value>(input);
+        parent_key = string_value::intern(input);
+        return false;
+    }
+
+    void assembler::find_local_names(const token &input, function_context &result)
+    {
+        if (input.type == token_type::expression && input.list_data.size() > 1)
+        {
+            auto keyword = input.list_data[0]->token_value.get_complex<const variable_value>();
+            if (keyword && keyword->data == keyword_function)
+            {
+                // A named function inside a function body is defined as a variable, its own body has separate variables.
+                const auto &name = *input.list_data[1];
+                if (name.type == token_type::value)
+                {
+                    result.locals.insert(name.token_value.to_string());
+                }
+                return;
+            }
+
+            if (keyword && keyword->data == keyword_define)
+            {
+                for (auto i = 1; i < input.list_data.size() - 1; i++)
+                {
+                    const auto &name = *input.list_data[i];
+                    if (name.type == token_type::value)
+                    {
+                        result.locals.insert(name.token_value.to_string());
+                    }
+                    else
+                    {
+                        result.has_dynamic_locals = true;
+                    }
+                }
+            }
+        }
+
+        for (const auto &iter : input.list_data)
+        {
+            find_local_names(*iter, result);
+        }
+        for (const auto &iter : input.map_data)
+        {
+            find_local_names(*iter.second, result);
+        }
+    }
+
+    bool assembler::is_enclosing_variable(const std::string &key) const
+    {
+        const auto &current = function_stack.back();
+        if (current.has_dynamic_locals || current.locals.find(key) != current.locals.end())
+        {
+            return false;
+        }
+
+        // The nearest enclosing function with the variable is the one that is captured.
+        for (auto i = function_stack.size() - 1; i-- > 0;)
+        {
+            const auto &outer = function_stack[i];
+            if (outer.locals.find(key) != outer.locals.end())
+            {
+                return true;
+            }
+            if (outer.has_dynamic_locals)
+            {
+                return false;
+            }
+        }
+
         return false;
     }
 
-    std::shared_ptr<function> assembler::process_temp_function(const std::vector<std::string> &parameters, const assembler::code_line_list &temp_code_lines, const std::string &name)
+    std::vector<std::string> assembler::capture_variables(code_line_list &temp_code_lines)
+    {
+        // The defines in the body are added as well in case they came from somewhere that wasn't found before parsing.
+        auto &current = function_stack.back();
+        for (const auto &line : temp_code_lines)
+        {
+            if (line.op == vm_operator::define)
+            {
+                if (line.argument.type == token_type::value)
+                {
+                    current.locals.insert(get_value(line.argument).to_string());
+                }
+                else
+                {
+                    current.has_dynamic_locals = true;
+                }
+            }
+        }
+
+        std::vector<std::string> captures;
+        std::unordered_map<std::string, int> capture_indices;
+        auto get_capture_index = [&captures, &capture_indices](const std::string &key)
+        {
+            auto find = capture_indices.find(key);
+            if (find != capture_indices.end())
+            {
+                return find->second;
+            }
+
+            auto index = static_cast<int>(captures.size());
+            captures.push_back(key);
+            capture_indices[key] = index;
+            return index;
+        };
+
+        code_line_list result;
+        result.reserve(temp_code_lines.size());
+        for (auto &line : temp_code_lines)
+        {
+            switch (line.op)
+            {
+                default: break;
+
+                case vm_operator::push:
+                {
+                    // Nested functions that use variables from this function or one further out are made into closures.
+                    auto nested = line.argument.type == token_type::value ? line.argument.token_value.get_complex<const function_value>() : nullptr;
+                    if (!nested || current.nested_functions.find(nested->data.get()) == current.nested_functions.end() || nested->data->captures.empty())
+                    {
+                        break;
+                    }
+
+                    // Variables from further out are passed down through this function's own captures.
+                    auto &nested_code = *nested->data;
+                    nested_code.capture_slots.clear();
+                    for (const auto &key : nested_code.captures)
+                    {
+                        nested_code.capture_slots.push_back(current.locals.find(key) != current.locals.end() ? -1 : get_capture_index(key));
+                    }
+                    line.op = vm_operator::make_closure;
+                    break;
+                }
+
+                case vm_operator::get:
+                case vm_operator::get_move:
+                case vm_operator::set:
+                case vm_operator::inc:
+                case vm_operator::dec:
+                {
+                    if (line.argument.type != token_type::value)
+                    {
+                        break;
+                    }
+
+                    auto key = get_value(line.argument).to_string();
+                    if (!is_enclosing_variable(key))
+                    {
+                        break;
+                    }
+
+                    auto slot = line.argument.keep_location(value(get_capture_index(key)));
+                    if (line.op == vm_operator::inc || line.op == vm_operator::dec)
+                    {
+                        result.emplace_back(vm_operator::get_upvalue, slot);
+                        result.emplace_back(line.op == vm_operator::inc ? vm_operator::add : vm_operator::sub, line.argument.keep_location(value(1)));
+                        result.emplace_back(vm_operator::set_upvalue, slot);
+                        continue;
+                    }
+
+                    line = temp_code_line(line.op == vm_operator::set ? vm_operator::set_upvalue : vm_operator::get_upvalue, slot);
+                    break;
+                }
+            }
+
+            result.push_back(std::move(line));
+        }
+
+        temp_code_lines = std::move(result);
+        return captures;
+    }
+
+    std::shared_ptr<function> assembler::process_temp_function(const std::vector<std::string> &parameters, const assembler::code_line_list &temp_code_lines, const std::string &name, const std::vector<std::string> &captures)
     {
         std::unordered_map<std::string, int> labels;
         std::vector<code_line> code;
@@ -853,7 +1821,10 @@ namespace lysithea_vm
 
         auto symbols = std::make_shared<debug_symbols>(source_name, source_text, locations);
 
-        return std::make_shared<function>(code, parameters, labels, name, symbols);
+        auto result = std::make_shared<function>(code, parameters, labels, name, symbols);
+        result->captures = captures;
+        verifier::verify(*result);
+        return result;
     }
 
     std::string assembler::make_cond_label(int index, int label_num)
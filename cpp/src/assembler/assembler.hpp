@@ -4,6 +4,10 @@
 #include <istream>
 #include <memory>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <exception>
 
 #include "./temp_code_line.hpp"
 #include "./token.hpp"
@@ -12,6 +16,7 @@
 #include "../values/complex_value.hpp"
 #include "../values/string_value.hpp"
 #include "../values/builtin_function_value.hpp"
+#include "../values/function_value.hpp"
 #include "../script.hpp"
 #include "../scope.hpp"
 #include "../operator.hpp"
@@ -42,6 +47,12 @@ namespace lysithea_vm
 
             scope builtin_scope;
 
+            // Number of threads used to assemble top level functions, 1 assembles everything on the calling thread and 0 uses the hardware concurrency.
+            int assembly_threads;
+
+            // Script functions with at most this many code lines are inlined into their callers, 0 turns off inlining.
+            int inline_budget;
+
             // Constructor
             assembler();
 
@@ -50,6 +61,11 @@ namespace lysithea_vm
             std::shared_ptr<script> parse_from_stream(const std::string &source_name, std::istream &input);
             code_line_list parse(const token &input);
 
+            // Incremental Methods
+            std::shared_ptr<script> reassemble_from_text(const std::string &source_name, const std::string &input);
+            std::shared_ptr<script> reassemble_from_stream(const std::string &source_name, std::istream &input);
+            void clear_incremental_cache();
+
             code_line_list parse_function_keyword(const token &input);
             code_line_list parse_define_set(const token &input, bool is_define);
             code_line_list parse_const(const token &input);
@@ -74,6 +90,7 @@ namespace lysithea_vm
             code_line_list optimise_call_symbol_value(const token &input, const std::string &variable, int num_args);
             code_line_list optimise_get_symbol_value(const token &input, const std::string &variable);
             code_line_list optimise_get(const token &input, const std::string &variable);
+            void optimise_move_to_builtin(const std::string &variable, code_line_list &input) const;
 
             static bool is_get_property_request(const std::string &variable, std::shared_ptr<string_value> &parent_key, std::shared_ptr<array_value> &property);
 
@@ -88,21 +105,91 @@ namespace lysithea_vm
                 loop_labels(std::shared_ptr<string_value> start, std::shared_ptr<string_value> end): start(start), end(end) { }
             };
 
+            struct cached_form
+            {
+                // Fields
+                std::string text;
+                code_location location;
+                code_line_list code_lines;
+                std::vector<std::pair<std::string, value>> dependencies;
+                std::vector<std::pair<std::string, value>> constants;
+                std::vector<std::shared_ptr<function>> functions;
+            };
+
+            struct function_context
+            {
+                // Fields
+                std::unordered_set<std::string> locals;
+                std::unordered_set<const function *> nested_functions;
+                // Set when a variable is defined with a name that is only known at run time, so any name could be local.
+                bool has_dynamic_locals;
+
+                // Constructor
+                function_context() : has_dynamic_locals(false) { }
+            };
+
+            struct function_job
+            {
+                // Fields
+                const token *input;
+                std::shared_ptr<scope> const_scope;
+                std::shared_ptr<function_value> placeholder;
+                // The functions that share the const scope, in script order. Only the ones before this function are visible to it.
+                std::shared_ptr<std::unordered_map<std::string, std::size_t>> shared_functions;
+                std::size_t function_index;
+                std::exception_ptr error;
+
+                // Constructor
+                function_job(const token *input, std::shared_ptr<scope> const_scope, std::shared_ptr<function_value> placeholder, std::shared_ptr<std::unordered_map<std::string, std::size_t>> shared_functions, std::size_t function_index):
+                    input(input), const_scope(const_scope), placeholder(placeholder), shared_functions(shared_functions), function_index(function_index) { }
+            };
+
             // Fields
             int label_count;
             std::vector<loop_labels> loop_stack;
             std::vector<std::string> keyword_parsing_stack;
+            std::vector<function_context> function_stack;
             std::shared_ptr<scope> const_scope;
 
             std::string source_name;
             std::shared_ptr<std::vector<std::string>> source_text;
 
+            std::string incremental_source_name;
+            std::unordered_map<std::size_t, cached_form> form_cache;
+            std::unordered_map<std::string, std::shared_ptr<function_value>> incremental_functions;
+            cached_form *recording_form;
+            std::unordered_set<const function_value *> pending_functions;
+            // Set while assembling a function job, constants from these functions at or after the index are not visible.
+            const std::unordered_map<std::string, std::size_t> *hidden_functions;
+            std::size_t hidden_from;
+
             // Methods
             std::shared_ptr<script> parse_from_value(const token &input);
+            std::shared_ptr<script> make_script(std::shared_ptr<function> code) const;
+
+            std::shared_ptr<function> parse_parallel_global_function(const token &input, int num_threads);
+            void parse_function_job(function_job &job);
+            static bool is_named_function(const token &input);
+
+            std::shared_ptr<function> parse_incremental_function(const token &input);
+            bool is_cached_form_valid(const cached_form &form) const;
+            void reuse_cached_form(cached_form &form, const token &input);
+            std::string get_source_text(const code_location &location) const;
 
-            std::shared_ptr<function> process_temp_function(const std::vector<std::string> &parameters, const code_line_list &temp_code_lines, const std::string &name);
+            bool try_get_const(const std::string &key, value &result);
+            void record_constant(const std::string &key, value input);
+
+            std::shared_ptr<function> process_temp_function(const std::vector<std::string> &parameters, const code_line_list &temp_code_lines, const std::string &name, const std::vector<std::string> &captures = std::vector<std::string>());
+
+            static void find_local_names(const token &input, function_context &result);
+            bool is_enclosing_variable(const std::string &key) const;
+            std::vector<std::string> capture_variables(code_line_list &temp_code_lines);
 
             std::string make_cond_label(int index, int label_num);
+            bool is_inside_function() const;
+
+            bool try_inline_call(const token &input, const code_line_list &call_lines, const code_line_list &argument_ends, code_line_list &result);
+            bool can_inline_function(const function &input, const code_line_list &argument_ends, int num_args) const;
 
             static void add_handle_nested(std::vector<token_ptr> &target, token_ptr input);
 
@@ -136,7 +136,7 @@ namespace lysithea_vm
         if ((first == '"' && last == '"') ||
             (first == '\'' && last == '\''))
         {
-            return value(std::make_shared<string_value>(input.substr(1, input.size() - 2)));
+            return value(string_value::intern(input.substr(1, input.size() - 2)));
         }
 
         return value(std::make_shared<variable_value>(input));
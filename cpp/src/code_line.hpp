@@ -2,6 +2,8 @@
 
 #include <memory>
 #include <sstream>
+#include <atomic>
+#include <cstdint>
 
 #include "operator.hpp"
 #include "./values/value.hpp"
@@ -14,24 +16,45 @@ namespace lysithea_vm
     {
         public:
             // Fields
+            static const std::uint8_t quicken_threshold = 8;
+            static const std::uint8_t max_deopts = 4;
+
             vm_operator op;
             lysithea_vm::value value;
 
+            // The operator the virtual machine runs, a verified line that keeps seeing numbers is swapped for the number version of op.
+            // Functions are shared between forked virtual machines so these are changed atomically, every version of a line gives the same result.
+            mutable std::atomic<vm_operator> quick_op;
+            mutable std::atomic<std::uint8_t> feedback;
+            mutable std::atomic<std::uint8_t> deopts;
+
             // Constructor
-            code_line(vm_operator op) : op(op)
+            code_line(vm_operator op) : op(op), quick_op(op), feedback(0), deopts(0)
             {
                 if (op == vm_operator::push)
                 {
                     throw std::runtime_error("Cannot create code line of push without arg");
                 }
             }
-            code_line(vm_operator op, lysithea_vm::value input) : op(op), value(input)
+            code_line(vm_operator op, lysithea_vm::value input) : op(op), value(input), quick_op(op), feedback(0), deopts(0)
             {
                 if (op == vm_operator::push && input.is_undefined())
                 {
                     throw std::runtime_error("Cannot create code line of push without arg");
                 }
             }
+            // Copies start again from the unspecialised operator.
+            code_line(const code_line &input) : op(input.op), value(input.value), quick_op(input.op), feedback(0), deopts(0) { }
+
+            code_line &operator=(const code_line &input)
+            {
+                op = input.op;
+                value = input.value;
+                quick_op.store(input.op, std::memory_order_relaxed);
+                feedback.store(0, std::memory_order_relaxed);
+                deopts.store(0, std::memory_order_relaxed);
+                return *this;
+            }
 
             // Methods
             std::string to_string() const;
@@ -40,5 +63,45 @@ namespace lysithea_vm
             {
                 return !value.is_undefined();
             }
+
+            inline vm_operator current_op() const
+            {
+                return quick_op.load(std::memory_order_relaxed);
+            }
+
+            // Called each time the line has run with number operands, after enough of them in a row the line is quickened.
+            inline void record_number(vm_operator number_op) const
+            {
+                auto seen = feedback.load(std::memory_order_relaxed);
+                if (seen < quicken_threshold)
+                {
+                    feedback.store(seen + 1, std::memory_order_relaxed);
+                }
+                else if (deopts.load(std::memory_order_relaxed) < max_deopts)
+                {
+                    quick_op.store(number_op, std::memory_order_relaxed);
+                }
+            }
+
+            inline void record_other() const
+            {
+                if (feedback.load(std::memory_order_relaxed) != 0)
+                {
+                    feedback.store(0, std::memory_order_relaxed);
+                }
+            }
+
+            // Goes back to the unspecialised operator when the number version sees something else.
+            // A line that keeps changing between the two is left unspecialised.
+            inline void deoptimise() const
+            {
+                auto count = deopts.load(std::memory_order_relaxed);
+                if (count < max_deopts)
+                {
+                    deopts.store(count + 1, std::memory_order_relaxed);
+                }
+                feedback.store(0, std::memory_order_relaxed);
+                quick_op.store(op, std::memory_order_relaxed);
+            }
     };
 } // lysithea_vm
\ No newline at end of file
@@ -0,0 +1,357 @@
+#include "cycle_collector.hpp"
+
+#include <limits>
+#include <unordered_map>
+
+namespace lysithea_vm
+{
+    namespace
+    {
+        const std::size_t no_vertex = std::numeric_limits<std::size_t>::max();
+    }
+
+    cycle_collector::cycle_collector() :
+        candidate_threshold(256), step_budget(64), total_collected(0), next_vertex(0), collecting(false)
+    {
+
+    }
+
+    void cycle_collector::add_candidate(const std::shared_ptr<scope> &input)
+    {
+        candidates.emplace_back(input);
+    }
+
+    void cycle_collector::add_candidate(const std::shared_ptr<complex_value> &input)
+    {
+        value_candidates.emplace_back(input);
+    }
+
+    void cycle_collector::scope_exited(const std::shared_ptr<scope> &input)
+    {
+        if (!input)
+        {
+            return;
+        }
+
+        // The virtual machine holds one reference while leaving the scope, anything more means it was kept by something else.
+        if (input.use_count() > 1)
+        {
+            add_candidate(input);
+            return;
+        }
+
+        // The scope is about to be freed, but its cells can still be held by closures.
+        for (const auto &iter : input->values)
+        {
+            if (scope::get_cell(iter.second) && iter.second.data.use_count() > 1)
+            {
+                add_candidate(iter.second.data);
+            }
+        }
+    }
+
+    bool cycle_collector::collect_step(std::size_t budget)
+    {
+        if (!collecting)
+        {
+            if (candidates.empty() && value_candidates.empty())
+            {
+                return true;
+            }
+            start();
+        }
+
+        for (; budget > 0 && next_vertex < vertices.size(); budget--, next_vertex++)
+        {
+            auto locked = vertices[next_vertex].scope_ref.lock();
+            if (locked)
+            {
+                mark_scope(next_vertex, locked);
+                continue;
+            }
+
+            auto locked_value = vertices[next_vertex].value_ref.lock();
+            if (locked_value)
+            {
+                mark_value(next_vertex, locked_value);
+            }
+        }
+
+        if (next_vertex < vertices.size())
+        {
+            return false;
+        }
+
+        total_collected += finish();
+        return true;
+    }
+
+    std::size_t cycle_collector::collect()
+    {
+        auto start_total = total_collected;
+
+        // Finish off any collection that is part way through before starting on the candidates added since.
+        if (collecting)
+        {
+            collect_step(std::numeric_limits<std::size_t>::max());
+        }
+        collect_step(std::numeric_limits<std::size_t>::max());
+
+        return total_collected - start_total;
+    }
+
+    void cycle_collector::start()
+    {
+        vertices.clear();
+        vertex_lookup.clear();
+        next_vertex = 0;
+        collecting = true;
+
+        for (const auto &iter : candidates)
+        {
+            auto locked = iter.lock();
+            if (locked)
+            {
+                add_scope(locked);
+            }
+        }
+        candidates.clear();
+
+        for (const auto &iter : value_candidates)
+        {
+            auto locked = iter.lock();
+            if (locked)
+            {
+                add_value(locked);
+            }
+        }
+        value_candidates.clear();
+    }
+
+    std::size_t cycle_collector::finish()
+    {
+        collecting = false;
+
+        // Anything with more references than the marked scopes and values account for is used from outside, as is everything it reaches.
+        std::vector<std::size_t> live;
+        for (std::size_t i = 0; i < vertices.size(); i++)
+        {
+            if (vertices[i].use_count > vertices[i].internal_count)
+            {
+                vertices[i].live = true;
+                live.push_back(i);
+            }
+        }
+
+        while (!live.empty())
+        {
+            auto index = live.back();
+            live.pop_back();
+            for (auto edge : vertices[index].edges)
+            {
+                if (!vertices[edge].live)
+                {
+                    vertices[edge].live = true;
+                    live.push_back(edge);
+                }
+            }
+        }
+
+        std::vector<std::shared_ptr<scope>> garbage_scopes;
+        std::vector<std::shared_ptr<complex_value>> garbage_values;
+        std::unordered_map<const void *, long> references;
+        for (const auto &iter : vertices)
+        {
+            if (iter.live)
+            {
+                continue;
+            }
+
+            if (auto locked_scope = iter.scope_ref.lock())
+            {
+                references[locked_scope.get()] = 0;
+                garbage_scopes.emplace_back(std::move(locked_scope));
+            }
+            else if (auto locked_value = iter.value_ref.lock())
+            {
+                references[locked_value.get()] = 0;
+                garbage_values.emplace_back(std::move(locked_value));
+            }
+        }
+
+        vertices.clear();
+        vertex_lookup.clear();
+
+        if (garbage_scopes.empty() && garbage_values.empty())
+        {
+            return 0;
+        }
+
+        // The scopes could have changed since they were marked, so check that the garbage is only referenced by itself before clearing any of it.
+        auto count_reference = [&references](const void *input)
+        {
+            auto find = references.find(input);
+            if (find != references.end())
+            {
+                find->second++;
+            }
+        };
+
+        for (const auto &iter : garbage_scopes)
+        {
+            count_reference(iter->parent.get());
+            for (const auto &value_iter : iter->values)
+            {
+                count_reference(value_iter.second.data.get());
+            }
+            for (const auto &value_iter : iter->upvalues)
+            {
+                count_reference(value_iter.data.get());
+            }
+        }
+        for (const auto &iter : garbage_values)
+        {
+            iter->visit_scopes([&count_reference](const std::shared_ptr<scope> &input) { count_reference(input.get()); });
+            iter->visit_values([&count_reference](const std::shared_ptr<complex_value> &input) { count_reference(input.get()); });
+        }
+
+        for (const auto &iter : garbage_scopes)
+        {
+            if (iter.use_count() - 1 != references[iter.get()])
+            {
+                return 0;
+            }
+        }
+        for (const auto &iter : garbage_values)
+        {
+            if (iter.use_count() - 1 != references[iter.get()])
+            {
+                return 0;
+            }
+        }
+
+        for (const auto &iter : garbage_scopes)
+        {
+            iter->clear();
+            iter->set_parent(nullptr);
+            iter->upvalues.clear();
+        }
+
+        // Emptying the cells is enough to break apart closures that only keep each other alive.
+        std::size_t num_cells = 0;
+        for (const auto &iter : garbage_values)
+        {
+            if (auto cell = complex_cast<cell_value>(iter.get()))
+            {
+                cell->data = value();
+                num_cells++;
+            }
+        }
+
+        return garbage_scopes.size() + num_cells;
+    }
+
+    void cycle_collector::mark_scope(std::size_t index, const std::shared_ptr<scope> &input)
+    {
+        // Take off the reference held by the lock in collect_step.
+        vertices[index].use_count = input.use_count() - 1;
+
+        if (input->parent)
+        {
+            add_edge(index, add_scope(input->parent));
+        }
+
+        auto add_value_edge = [this, index](const complex_ptr &data)
+        {
+            if (!data)
+            {
+                return;
+            }
+
+            auto value_index = add_value(data);
+            if (value_index != no_vertex)
+            {
+                add_edge(index, value_index);
+            }
+        };
+
+        for (const auto &iter : input->values)
+        {
+            add_value_edge(iter.second.data);
+        }
+        for (const auto &iter : input->upvalues)
+        {
+            add_value_edge(iter.data);
+        }
+    }
+
+    void cycle_collector::mark_value(std::size_t index, const std::shared_ptr<complex_value> &input)
+    {
+        // Take off the reference held by the lock in collect_step.
+        vertices[index].use_count = input.use_count() - 1;
+
+        input->visit_scopes([this, index](const std::shared_ptr<scope> &captured)
+        {
+            add_edge(index, add_scope(captured));
+        });
+        input->visit_values([this, index](const std::shared_ptr<complex_value> &captured)
+        {
+            auto value_index = add_value(captured);
+            if (value_index != no_vertex)
+            {
+                add_edge(index, value_index);
+            }
+        });
+    }
+
+    std::size_t cycle_collector::add_scope(const std::shared_ptr<scope> &input)
+    {
+        auto find = vertex_lookup.find(input.get());
+        if (find != vertex_lookup.end())
+        {
+            return find->second;
+        }
+
+        auto index = vertices.size();
+        vertices.emplace_back(std::weak_ptr<scope>(input));
+        vertex_lookup[input.get()] = index;
+        return index;
+    }
+
+    std::size_t cycle_collector::add_value(const std::shared_ptr<complex_value> &input)
+    {
+        auto find = vertex_lookup.find(input.get());
+        if (find != vertex_lookup.end())
+        {
+            return find->second;
+        }
+
+        // Most values don't hold onto any scopes or cells, those are left out of the graph.
+        if (!holds_references(*input))
+        {
+            return no_vertex;
+        }
+
+        auto index = vertices.size();
+        vertices.emplace_back(std::weak_ptr<complex_value>(input));
+        vertex_lookup[input.get()] = index;
+        return index;
+    }
+
+    bool cycle_collector::holds_references(const complex_value &input)
+    {
+        auto result = false;
+        input.visit_scopes([&result](const std::shared_ptr<scope> &) { result = true; });
+        if (!result)
+        {
+            input.visit_values([&result](const std::shared_ptr<complex_value> &) { result = true; });
+        }
+        return result;
+    }
+
+    void cycle_collector::add_edge(std::size_t from, std::size_t to)
+    {
+        vertices[from].edges.push_back(to);
+        vertices[to].internal_count++;
+    }
+} // lysithea_vm
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+#include "scope.hpp"
+
+namespace lysithea_vm
+{
+    // Finds groups of scopes and values that only keep each other alive and breaks them apart so they are freed.
+    //
+    // Values are still reference counted, so anything held outside of the group (the operand stack, the scope frames,
+    // the global scope or a shared_ptr held by the host) shows up as a use count that the group can't account for.
+    // Scopes that are still in use when their function returns are the starting points, from there the collector
+    // follows parent scopes and any values that report scopes through complex_value::visit_scopes.
+    // Cells that outlive their scope are starting points as well, as a closure stored in a variable it captured only
+    // keeps itself alive. The cells captured by closures are followed through complex_value::visit_values.
+    //
+    // Marking is done a few scopes at a time so it can be spread over several frames, the group is checked again
+    // all at once before anything is freed so changes made in between can't cause a live scope to be cleared.
+    class cycle_collector
+    {
+        public:
+            // Fields
+            // Start collecting once this many scopes have outlived their function call.
+            std::size_t candidate_threshold;
+            // The number of scopes and values marked by each call to collect_step.
+            std::size_t step_budget;
+            std::size_t total_collected;
+
+            // Constructor
+            cycle_collector();
+
+            // Methods
+            void add_candidate(const std::shared_ptr<scope> &input);
+            void add_candidate(const std::shared_ptr<complex_value> &input);
+            void scope_exited(const std::shared_ptr<scope> &input);
+
+            // Does up to budget amount of marking, returns true when the collection has finished.
+            bool collect_step(std::size_t budget);
+
+            // Runs a whole collection straight away, returns the number of scopes and cells freed.
+            std::size_t collect();
+
+            inline bool is_collecting() const { return collecting; }
+            inline bool should_step() const { return collecting || num_candidates() >= candidate_threshold; }
+            inline std::size_t num_candidates() const { return candidates.size() + value_candidates.size(); }
+
+        private:
+            struct vertex
+            {
+                // Fields
+                std::weak_ptr<scope> scope_ref;
+                std::weak_ptr<complex_value> value_ref;
+                long use_count;
+                long internal_count;
+                bool live;
+                std::vector<std::size_t> edges;
+
+                // Constructor
+                vertex(std::weak_ptr<scope> scope_ref) : scope_ref(scope_ref), use_count(0), internal_count(0), live(false) { }
+                vertex(std::weak_ptr<complex_value> value_ref) : value_ref(value_ref), use_count(0), internal_count(0), live(false) { }
+            };
+
+            // Fields
+            std::vector<std::weak_ptr<scope>> candidates;
+            std::vector<std::weak_ptr<complex_value>> value_candidates;
+            std::vector<vertex> vertices;
+            std::unordered_map<const void *, std::size_t> vertex_lookup;
+            std::size_t next_vertex;
+            bool collecting;
+
+            // Methods
+            void start();
+            std::size_t finish();
+            void mark_scope(std::size_t index, const std::shared_ptr<scope> &input);
+            void mark_value(std::size_t index, const std::shared_ptr<complex_value> &input);
+            std::size_t add_scope(const std::shared_ptr<scope> &input);
+            std::size_t add_value(const std::shared_ptr<complex_value> &input);
+            static bool holds_references(const complex_value &input);
+            void add_edge(std::size_t from, std::size_t to);
+    };
+} // lysithea_vm
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <new>
+#include <string>
+
+namespace lysithea_vm
+{
+    // Thrown when an allocation would take a virtual machine over its memory limit.
+    // The virtual machine turns it into a virtual_machine_error with the stack trace.
+    class memory_limit_error : public std::bad_alloc
+    {
+        public:
+            // Fields
+            std::size_t limit;
+            std::size_t requested;
+
+            // Constructor
+            memory_limit_error(std::size_t limit, std::size_t requested) : limit(limit), requested(requested) { }
+
+            // Methods
+            virtual const char *what() const noexcept { return "Memory limit exceeded"; }
+    };
+} // lysithea_vm
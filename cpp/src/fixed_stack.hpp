@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <utility>
 #include <exception>
 
 namespace lysithea_vm
@@ -12,7 +13,11 @@ namespace lysithea_vm
             // Fields
 
             // Constructor
-            fixed_stack(int size) : max_size(size) { }
+            // The full size is reserved up front so that pointers into the stack stay valid while values are pushed.
+            fixed_stack(int size) : max_size(size)
+            {
+                data.reserve(size);
+            }
 
             // Methods
             inline void clear()
@@ -24,7 +29,7 @@ namespace lysithea_vm
             {
                 if (stack_size() > 0)
                 {
-                    result = data.back();
+                    result = std::move(data.back());
                     data.pop_back();
                     return true;
                 }
@@ -36,7 +41,7 @@ namespace lysithea_vm
             {
                 if (stack_size() < max_size)
                 {
-                    data.emplace_back(value);
+                    data.emplace_back(std::move(value));
                     return true;
                 }
 
@@ -54,7 +59,35 @@ namespace lysithea_vm
                 return true;
             }
 
+            // The top count values in order, or null if there aren't that many.
+            inline T *peek_top(int count)
+            {
+                return stack_size() >= count ? data.data() + (data.size() - count) : nullptr;
+            }
+
+            inline void drop_top()
+            {
+                data.pop_back();
+            }
+
             inline int stack_size() const { return static_cast<int>(data.size()); }
+            inline int max_stack_size() const { return max_size; }
+
+            inline const T *data_from(int index) const { return data.data() + index; }
+            inline T *data_from(int index) { return data.data() + index; }
+
+            // Keeps this stack's reserved space, unlike assigning, so pointers into it stay valid.
+            inline void copy_from(const fixed_stack &input)
+            {
+                data.clear();
+                data.insert(data.end(), input.data.begin(), input.data.end());
+            }
+
+            // Removes values from the middle of the stack, anything above them is moved down.
+            inline void erase(int index, int count)
+            {
+                data.erase(data.begin() + index, data.begin() + (index + count));
+            }
 
             const std::vector<T> stack_data() const
             {
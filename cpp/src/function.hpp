@@ -10,6 +10,11 @@
 
 namespace lysithea_vm
 {
+    class virtual_machine;
+
+    // A function body compiled ahead of time by the aot_compiler, it runs from the virtual machine's program counter until it has to hand back.
+    using aot_function_body = void (*)(virtual_machine &vm);
+
     class function
     {
         public:
@@ -21,9 +26,22 @@ namespace lysithea_vm
             std::shared_ptr<debug_symbols> symbols;
             const bool has_name;
 
+            // Set by the verifier, jump_targets holds the resolved line for each jump with a known label and -1 otherwise.
+            bool verified;
+            std::vector<int> jump_targets;
+
+            // Set by the assembler for nested functions that use variables of the functions they are in, get_upvalue and
+            // set_upvalue use the index into captures. Each capture slot is -1 when the variable belongs to the enclosing
+            // function, otherwise it is passed down from the enclosing function's own captures at that index.
+            std::vector<std::string> captures;
+            std::vector<int> capture_slots;
+
+            // Set when a compiled version of the function has been installed, the virtual machine runs it instead of interpreting the code.
+            aot_function_body native_body;
+
             // Constructor
             function(const std::vector<code_line> &code, const std::vector<std::string> &parameters, const std::unordered_map<std::string, int> &labels, const std::string &name, std::shared_ptr<debug_symbols> debug_symbols) :
-                name(name.size() > 0 ? name : "anonymous"), code(code), parameters(parameters), labels(labels), has_name(name.size() > 0), symbols(debug_symbols) { }
+                name(name.size() > 0 ? name : "anonymous"), code(code), parameters(parameters), labels(labels), has_name(name.size() > 0), symbols(debug_symbols), verified(false), native_body(nullptr) { }
 
             // Methods
     };
@@ -0,0 +1,47 @@
+#include "lookup_cache.hpp"
+
+namespace lysithea_vm
+{
+    lookup_cache_entry *lookup_cache::fill(int line, scope &current, const scope *builtin, const std::string &key)
+    {
+        auto &entry = entries[line];
+        entry.scope_id = 0;
+
+        auto parent_versions = scope::parent_versions.load(std::memory_order_relaxed);
+        auto depth = 0;
+        for (auto search = &current; search; search = search->parent.get(), depth++)
+        {
+            auto find = search->values.find(key);
+            if (find != search->values.end())
+            {
+                entry.scope_id = current.id;
+                entry.versions = add_versions(current, builtin, depth);
+                entry.parent_versions = parent_versions;
+                entry.depth = depth;
+                entry.holder = search;
+                entry.found = &find->second;
+                entry.constant = search->is_constant(key);
+                return &entry;
+            }
+        }
+
+        if (builtin)
+        {
+            auto find = builtin->values.find(key);
+            if (find != builtin->values.end())
+            {
+                entry.scope_id = current.id;
+                entry.versions = add_versions(current, builtin, -1);
+                entry.parent_versions = parent_versions;
+                entry.depth = -1;
+                entry.holder = nullptr;
+                // Only read from as there is no holder to write through.
+                entry.found = const_cast<value *>(&find->second);
+                entry.constant = true;
+                return &entry;
+            }
+        }
+
+        return nullptr;
+    }
+} // lysithea_vm
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "scope.hpp"
+#include "function.hpp"
+#include "./values/value.hpp"
+
+namespace lysithea_vm
+{
+    // Where a line last found its variable, along with what is needed to tell if it would still be found there.
+    class lookup_cache_entry
+    {
+        public:
+            // Fields
+            // The scope the lookup started from, 0 when there is nothing cached.
+            std::uint64_t scope_id;
+            // The version of the scope the lookup started from, added to the builtin scope's version if it came from there.
+            std::uint64_t versions;
+            // The scope::parent_versions when the lookup was made, a variable being added to any of the parents changes it.
+            std::uint64_t parent_versions;
+            // How many parents up the variable was found, -1 when it came from the builtin scope.
+            int depth;
+            // The scope holding the variable, null for builtins which are never changed through the cache.
+            scope *holder;
+            value *found;
+            bool constant;
+
+            // Constructor
+            lookup_cache_entry() : scope_id(0), versions(0), parent_versions(0), depth(0), holder(nullptr), found(nullptr), constant(false) { }
+
+            // Methods
+            // The variable itself, captured variables are kept inside a cell.
+            inline value &variable() const
+            {
+                auto cell = scope::get_cell(*found);
+                return cell ? cell->data : *found;
+            }
+    };
+
+    // The cached lookups of one function for one virtual machine, with an entry for each line.
+    //
+    // An entry is used while the lookup starts from the same scope and none of the scopes searched have had a variable
+    // added or removed. The parents are covered by scope::parent_versions, so checking an entry takes the same time
+    // however far up the variable was found, rather than hashing the name at each scope.
+    // The variables are kept in the scope's map so the pointer to them stays the same until they are removed.
+    class lookup_cache
+    {
+        public:
+            // Fields
+            // Kept so that the function is not freed and its address used by another function while it is a key.
+            std::shared_ptr<function> code;
+            std::vector<lookup_cache_entry> entries;
+
+            // Constructor
+            lookup_cache(std::shared_ptr<function> code) : code(code), entries(code->code.size()) { }
+
+            // Methods
+            // Gives back the cached lookup for the line if it can still be used.
+            inline lookup_cache_entry *find(int line, const scope &current, const scope *builtin)
+            {
+                auto &entry = entries[line];
+                if (entry.scope_id != 0 && entry.scope_id == current.id && entry.versions == add_versions(current, builtin, entry.depth) &&
+                    entry.parent_versions == scope::parent_versions.load(std::memory_order_relaxed))
+                {
+                    return &entry;
+                }
+                return nullptr;
+            }
+
+            // Looks up the key in the scopes and the builtin scope, caching where it was found. Returns null if it was not found.
+            lookup_cache_entry *fill(int line, scope &current, const scope *builtin, const std::string &key);
+
+        private:
+            // Methods
+            static inline std::uint64_t add_versions(const scope &current, const scope *builtin, int depth)
+            {
+                return depth < 0 && builtin ? current.version + builtin->version : current.version;
+            }
+    };
+} // lysithea_vm
@@ -0,0 +1,86 @@
+#include "memory_tracker.hpp"
+
+#include <new>
+
+#include "./errors/memory_limit_error.hpp"
+
+namespace lysithea_vm
+{
+    thread_local memory_tracker *memory_tracker::current_tracker = nullptr;
+
+    memory_tracker::memory_tracker() :
+        live_bytes(0), peak_bytes(0), total_allocations(0), memory_limit(0), current_operator(vm_operator::unknown),
+        operator_allocations(num_vm_operators, 0), pooled_bytes(0), concurrent(false), live_blocks(0), released(false)
+    {
+        for (auto &iter : pools)
+        {
+            iter = nullptr;
+        }
+    }
+
+    memory_tracker::~memory_tracker()
+    {
+        for (auto iter : chunks)
+        {
+            ::operator delete(iter);
+        }
+    }
+
+    std::shared_ptr<memory_tracker> memory_tracker::create()
+    {
+        return std::shared_ptr<memory_tracker>(new memory_tracker(), &memory_tracker::release);
+    }
+
+    void memory_tracker::release(memory_tracker *input)
+    {
+        bool finished;
+        {
+            std::unique_lock<std::mutex> guard(input->lock, std::defer_lock);
+            if (input->concurrent)
+            {
+                guard.lock();
+            }
+
+            input->released = true;
+            finished = input->live_blocks == 0;
+        }
+
+        if (finished)
+        {
+            delete input;
+        }
+    }
+
+    void memory_tracker::fill_pool(std::size_t index)
+    {
+        auto block_size = (index + 1) * size_class_step;
+        auto chunk = static_cast<char *>(::operator new(chunk_size));
+        chunks.push_back(chunk);
+        pooled_bytes += chunk_size;
+
+        // Link the blocks in address order so that allocations made one after another sit next to each other.
+        free_block *head = pools[index];
+        for (auto offset = chunk_size - chunk_size % block_size; offset >= block_size; offset -= block_size)
+        {
+            auto block = reinterpret_cast<free_block *>(chunk + offset - block_size);
+            block->next = head;
+            head = block;
+        }
+        pools[index] = head;
+    }
+
+    void memory_tracker::throw_limit_error(std::size_t size) const
+    {
+        throw memory_limit_error(memory_limit, size);
+    }
+
+    void memory_tracker::reset_counts()
+    {
+        peak_bytes = live_bytes;
+        total_allocations = 0;
+        for (auto &iter : operator_allocations)
+        {
+            iter = 0;
+        }
+    }
+} // lysithea_vm
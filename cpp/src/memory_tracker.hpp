@@ -0,0 +1,193 @@
+#pragma once
+
+#include <new>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <mutex>
+
+#include "operator.hpp"
+
+namespace lysithea_vm
+{
+    // Keeps count of the memory held by the values, scopes, arrays and objects made while a virtual machine is running.
+    // Allocations are tracked when made through a tracking_allocator while the tracker is current for the thread.
+    // A tracker is only meant to be used by one thread at a time, the same as its virtual machine, unless it is
+    // concurrent. Forking a virtual machine makes its tracker concurrent since the values they share could be freed by either.
+    //
+    // Small allocations come from size class pools carved out of larger chunks, freed blocks go back onto their pool
+    // instead of to malloc, so the scopes and arguments made for each function call reuse the same memory.
+    class memory_tracker
+    {
+        public:
+            static const std::size_t size_class_step = 16;
+            static const std::size_t max_pooled_size = 256;
+            static const std::size_t num_size_classes = max_pooled_size / size_class_step;
+            static const std::size_t chunk_size = 16 * 1024;
+
+            // Fields
+            std::size_t live_bytes;
+            std::size_t peak_bytes;
+            std::size_t total_allocations;
+            // 0 means no limit, otherwise allocating past it throws a memory_limit_error.
+            std::size_t memory_limit;
+            // The operator being run, used to count the allocations made by each operator.
+            vm_operator current_operator;
+            std::vector<std::size_t> operator_allocations;
+            // Bytes held by the pools, both in use and free.
+            std::size_t pooled_bytes;
+            // Locks each allocation and free, this needs to be set before any other thread can use the tracker.
+            bool concurrent;
+
+            // Methods
+            // Values can outlive their virtual machine, so the tracker is only deleted once it has been released and the last tracked block is freed.
+            static std::shared_ptr<memory_tracker> create();
+
+            inline void *allocate(std::size_t size)
+            {
+                if (concurrent)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    return allocate_block(size);
+                }
+                return allocate_block(size);
+            }
+
+            inline void deallocate(void *ptr, std::size_t size)
+            {
+                bool finished;
+                if (concurrent)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    finished = deallocate_block(ptr, size);
+                }
+                else
+                {
+                    finished = deallocate_block(ptr, size);
+                }
+
+                if (finished)
+                {
+                    delete this;
+                }
+            }
+
+            void reset_counts();
+
+            inline std::size_t allocations_for(vm_operator op) const
+            {
+                return operator_allocations[static_cast<std::size_t>(op)];
+            }
+
+            // The tracker that new allocations are counted against on this thread, can be null.
+            static inline memory_tracker *current() { return current_tracker; }
+
+        private:
+            friend class memory_scope;
+
+            struct free_block
+            {
+                free_block *next;
+            };
+
+            // Fields
+            static thread_local memory_tracker *current_tracker;
+            std::size_t live_blocks;
+            bool released;
+            std::mutex lock;
+            free_block *pools[num_size_classes];
+            std::vector<void *> chunks;
+
+            // Constructor
+            memory_tracker();
+            ~memory_tracker();
+            memory_tracker(const memory_tracker &) = delete;
+            memory_tracker &operator=(const memory_tracker &) = delete;
+
+            // Methods
+            static inline std::size_t size_class(std::size_t size) { return (size - 1) / size_class_step; }
+
+            inline void *allocate_block(std::size_t size)
+            {
+                if (memory_limit > 0 && live_bytes + size > memory_limit)
+                {
+                    throw_limit_error(size);
+                }
+
+                void *result;
+                if (size <= max_pooled_size && size > 0)
+                {
+                    auto &pool = pools[size_class(size)];
+                    if (!pool)
+                    {
+                        fill_pool(size_class(size));
+                    }
+
+                    result = pool;
+                    pool = pool->next;
+                }
+                else
+                {
+                    result = ::operator new(size);
+                }
+
+                live_blocks++;
+                live_bytes += size;
+                if (live_bytes > peak_bytes)
+                {
+                    peak_bytes = live_bytes;
+                }
+                total_allocations++;
+                operator_allocations[static_cast<std::size_t>(current_operator)]++;
+
+                return result;
+            }
+
+            // Returns true when the tracker has been released and this was the last block, so it can be deleted.
+            inline bool deallocate_block(void *ptr, std::size_t size)
+            {
+                live_bytes -= size;
+                live_blocks--;
+
+                if (size <= max_pooled_size && size > 0)
+                {
+                    auto &pool = pools[size_class(size)];
+                    auto block = static_cast<free_block *>(ptr);
+                    block->next = pool;
+                    pool = block;
+                }
+                else
+                {
+                    ::operator delete(ptr);
+                }
+
+                return released && live_blocks == 0;
+            }
+
+            void fill_pool(std::size_t index);
+            void throw_limit_error(std::size_t size) const;
+            static void release(memory_tracker *input);
+    };
+
+    // Makes a tracker current for the thread until the end of the C++ scope.
+    class memory_scope
+    {
+        public:
+            // Constructor
+            memory_scope(memory_tracker *input) : previous(memory_tracker::current_tracker)
+            {
+                memory_tracker::current_tracker = input;
+            }
+            ~memory_scope()
+            {
+                memory_tracker::current_tracker = previous;
+            }
+
+            memory_scope(const memory_scope &) = delete;
+            memory_scope &operator=(const memory_scope &) = delete;
+
+        private:
+            // Fields
+            memory_tracker *previous;
+    };
+} // lysithea_vm
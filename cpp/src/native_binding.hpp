@@ -0,0 +1,385 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+#include <typeinfo>
+#include <type_traits>
+
+#include "virtual_machine.hpp"
+#include "./values/value.hpp"
+#include "./values/args_span.hpp"
+#include "./values/array_value.hpp"
+#include "./values/object_value.hpp"
+#include "./values/builtin_function_value.hpp"
+
+namespace lysithea_vm
+{
+    template <typename T>
+    class native_object_value;
+
+    // Gives each bound C++ type its own id without needing RTTI.
+    template <typename T>
+    inline const void *native_type_id()
+    {
+        static const char id = 0;
+        return &id;
+    }
+
+    // Converts an argument into the type taken by a bound C++ function.
+    // Any type without a specialisation is expected to be a native object of that type.
+    template <typename T>
+    struct native_arg
+    {
+        inline static T &get(const args_span &args, int index)
+        {
+            auto result = native_object_value<T>::cast(args.get_index(index));
+            if (!result)
+            {
+                throw std::bad_cast();
+            }
+            return *result->data;
+        }
+    };
+
+    template <>
+    struct native_arg<double>
+    {
+        inline static double get(const args_span &args, int index) { return args.get_number(index); }
+    };
+
+    template <>
+    struct native_arg<float>
+    {
+        inline static float get(const args_span &args, int index) { return static_cast<float>(args.get_number(index)); }
+    };
+
+    template <>
+    struct native_arg<int>
+    {
+        inline static int get(const args_span &args, int index) { return args.get_int(index); }
+    };
+
+    template <>
+    struct native_arg<bool>
+    {
+        inline static bool get(const args_span &args, int index) { return args.get_bool(index); }
+    };
+
+    template <>
+    struct native_arg<std::string>
+    {
+        inline static std::string get(const args_span &args, int index) { return args.get_index(index).to_string(); }
+    };
+
+    template <>
+    struct native_arg<value>
+    {
+        inline static const value &get(const args_span &args, int index) { return args.get_index(index); }
+    };
+
+    template <>
+    struct native_arg<array_value>
+    {
+        inline static const array_value &get(const args_span &args, int index) { return *args.get_index<const array_value>(index); }
+    };
+
+    template <>
+    struct native_arg<object_value>
+    {
+        inline static const object_value &get(const args_span &args, int index) { return *args.get_index<const object_value>(index); }
+    };
+
+    // Converts the result of a bound C++ function into a value.
+    template <typename T>
+    struct native_result
+    {
+        inline static value to_value(const T &input) { return value(input); }
+    };
+
+    template <int... Indices>
+    struct native_indices { };
+
+    template <int N, int... Indices>
+    struct make_native_indices : make_native_indices<N - 1, N - 1, Indices...> { };
+
+    template <int... Indices>
+    struct make_native_indices<0, Indices...>
+    {
+        using type = native_indices<Indices...>;
+    };
+
+    // Works out the result and argument types of a function pointer, member function pointer or functor.
+    // The result of the call is pushed onto the stack unless it returns void.
+    template <typename F>
+    struct callable_traits : callable_traits<decltype(&F::operator())> { };
+
+    template <typename R, typename... Args>
+    struct callable_traits<R (*)(Args...)>
+    {
+        static const int num_args = sizeof...(Args);
+
+        template <typename F>
+        inline static void call(F &&callable, virtual_machine &vm, const args_span &args)
+        {
+            call_indexed(callable, vm, args, typename make_native_indices<sizeof...(Args)>::type());
+        }
+
+        template <typename F, int... Indices>
+        inline static void call_indexed(F &&callable, virtual_machine &vm, const args_span &args, native_indices<Indices...>)
+        {
+            vm.push_stack(native_result<typename std::decay<R>::type>::to_value(callable(native_arg<typename std::decay<Args>::type>::get(args, Indices)...)));
+        }
+    };
+
+    template <typename... Args>
+    struct callable_traits<void (*)(Args...)>
+    {
+        static const int num_args = sizeof...(Args);
+
+        template <typename F>
+        inline static void call(F &&callable, virtual_machine &vm, const args_span &args)
+        {
+            call_indexed(callable, vm, args, typename make_native_indices<sizeof...(Args)>::type());
+        }
+
+        template <typename F, int... Indices>
+        inline static void call_indexed(F &&callable, virtual_machine &vm, const args_span &args, native_indices<Indices...>)
+        {
+            callable(native_arg<typename std::decay<Args>::type>::get(args, Indices)...);
+        }
+    };
+
+    template <typename R, typename... Args>
+    struct callable_traits<R (&)(Args...)> : callable_traits<R (*)(Args...)> { };
+
+    template <typename C, typename R, typename... Args>
+    struct callable_traits<R (C::*)(Args...)> : callable_traits<R (*)(Args...)> { };
+
+    template <typename C, typename R, typename... Args>
+    struct callable_traits<R (C::*)(Args...) const> : callable_traits<R (*)(Args...)> { };
+
+    // Generates the glue between the VM and a plain C++ function at compile time.
+    template <typename Signature>
+    struct native_binding
+    {
+        template <Signature F>
+        static void call(virtual_machine &vm, const args_span &args)
+        {
+            callable_traits<Signature>::call(F, vm, args);
+        }
+    };
+
+    // Makes a builtin for a C++ function, eg: make_native_binding<double (*)(double), &::sin>()
+    template <typename Signature, Signature F>
+    inline value make_native_binding()
+    {
+        return value::make_native(&native_binding<Signature>::template call<F>);
+    }
+
+    // A builtin function that holds onto a C++ callable, such as a lambda with captures.
+    template <typename F>
+    class bound_function_value : public builtin_function_value
+    {
+        public:
+            // Fields
+            mutable F callable;
+
+            // Constructor
+            bound_function_value(F callable) : builtin_function_value(builtin_function_callback()), callable(std::move(callable))
+            {
+                uses_args_span = true;
+            }
+
+            // Methods
+            virtual void invoke_native(virtual_machine &vm, const args_span &args) const
+            {
+                callable_traits<F>::call(callable, vm, args);
+            }
+    };
+
+    // Makes a builtin for any C++ callable, the argument and result types are taken from its signature.
+    template <typename F>
+    inline value make_bound_function(F callable)
+    {
+        return value(make_tracked<bound_function_value<F>>(std::move(callable)));
+    }
+
+    // Describes the properties and methods of a C++ type that are visible to scripts.
+    template <typename T>
+    class native_class
+    {
+        public:
+            using member_getter = std::function<value (const std::shared_ptr<T> &)>;
+
+            // Fields
+            std::string name;
+            std::unordered_map<std::string, member_getter> members;
+            // Make the bound function for a method, each object only makes it the first time it is used.
+            std::unordered_map<std::string, member_getter> methods;
+
+            // Constructor
+            native_class(const std::string &name) : name(name) { }
+
+            // Methods
+            template <typename R>
+            native_class &add_property(const std::string &key, R T::*field)
+            {
+                members[key] = [field](const std::shared_ptr<T> &input)
+                {
+                    return native_result<typename std::decay<R>::type>::to_value((*input).*field);
+                };
+                return *this;
+            }
+
+            template <typename R>
+            native_class &add_property(const std::string &key, R (T::*getter)() const)
+            {
+                members[key] = [getter](const std::shared_ptr<T> &input)
+                {
+                    return native_result<typename std::decay<R>::type>::to_value(((*input).*getter)());
+                };
+                return *this;
+            }
+
+            template <typename R, typename... Args>
+            native_class &add_method(const std::string &key, R (T::*method)(Args...))
+            {
+                methods[key] = [method](const std::shared_ptr<T> &input)
+                {
+                    return make_bound_function([input, method](Args... args) -> R { return ((*input).*method)(args...); });
+                };
+                return *this;
+            }
+
+            template <typename R, typename... Args>
+            native_class &add_method(const std::string &key, R (T::*method)(Args...) const)
+            {
+                methods[key] = [method](const std::shared_ptr<T> &input)
+                {
+                    return make_bound_function([input, method](Args... args) -> R { return ((*input).*method)(args...); });
+                };
+                return *this;
+            }
+
+            std::vector<std::string> keys() const
+            {
+                std::vector<std::string> result;
+                for (const auto &iter : members)
+                {
+                    result.push_back(iter.first);
+                }
+                for (const auto &iter : methods)
+                {
+                    result.push_back(iter.first);
+                }
+                std::sort(result.begin(), result.end());
+                return result;
+            }
+    };
+
+    class native_object_base : public complex_value
+    {
+        public:
+            // Fields
+            static const complex_kind kind_tag = complex_kind::native_object;
+            const void *type_id;
+
+            // Constructor
+            native_object_base(const void *type_id) : complex_value(kind_tag), type_id(type_id) { }
+    };
+
+    // A C++ object that scripts can read properties from and call methods on like an object.
+    template <typename T>
+    class native_object_value : public native_object_base
+    {
+        public:
+            using class_ptr = std::shared_ptr<const native_class<T>>;
+
+            // Fields
+            std::shared_ptr<T> data;
+            class_ptr type;
+
+            // Constructor
+            native_object_value(std::shared_ptr<T> data, class_ptr type) :
+                native_object_base(native_type_id<T>()), data(data), type(type) { }
+
+            // Methods
+            virtual int compare_to(const complex_value *input) const
+            {
+                auto other = complex_cast<const native_object_base>(input);
+                if (!other || other->type_id != type_id)
+                {
+                    return 1;
+                }
+
+                return data == static_cast<const native_object_value *>(other)->data ? 0 : 1;
+            }
+
+            virtual std::size_t get_hash() const { return std::hash<const void *>()(data.get()); }
+
+            virtual std::string to_string() const { return type->name; }
+            virtual std::string type_name() const { return type->name; }
+
+            virtual bool is_object() const { return true; }
+            virtual std::vector<std::string> object_keys() const { return type->keys(); }
+
+            virtual bool try_get(const std::string &key, value &result) const
+            {
+                auto find = type->members.find(key);
+                if (find != type->members.end())
+                {
+                    result = find->second(data);
+                    return true;
+                }
+
+                auto find_method = type->methods.find(key);
+                if (find_method == type->methods.end())
+                {
+                    return false;
+                }
+
+                // Forked virtual machines on other threads can share the object.
+                std::lock_guard<std::mutex> lock(bound_methods_mutex);
+                auto find_bound = bound_methods.find(key);
+                if (find_bound == bound_methods.end())
+                {
+                    find_bound = bound_methods.emplace(key, find_method->second(data)).first;
+                }
+                result = find_bound->second;
+                return true;
+            }
+
+            static inline const native_object_value *cast(const value &input)
+            {
+                auto base = complex_cast<const native_object_base>(input.data.get());
+                if (base && base->type_id == native_type_id<T>())
+                {
+                    return static_cast<const native_object_value *>(base);
+                }
+                return nullptr;
+            }
+
+            static inline value make_value(std::shared_ptr<T> data, class_ptr type)
+            {
+                return value(make_tracked<native_object_value>(data, type));
+            }
+
+        private:
+            // Fields
+            mutable std::mutex bound_methods_mutex;
+            mutable std::unordered_map<std::string, value> bound_methods;
+    };
+
+    template <typename T>
+    inline value make_native_object(std::shared_ptr<T> data, typename native_object_value<T>::class_ptr type)
+    {
+        return native_object_value<T>::make_value(data, type);
+    }
+} // lysithea_vm
@@ -8,8 +8,9 @@ namespace lysithea_vm
 
         // General
         push, to_argument,
-        call, call_direct, call_return,
-        get_property, get, set, define,
+        call, call_direct, tail_call, call_return,
+        get_property, get, get_move, set, define,
+        get_upvalue, set_upvalue,
         jump, jump_true, jump_false,
 
         // Misc
@@ -28,6 +29,15 @@ namespace lysithea_vm
         inc, dec, unary_negative,
 
         // Value create
-        make_array, make_object
+        make_array, make_object, make_closure,
+
+        // Quickened, only made by the virtual machine for lines that have only seen numbers
+        add_number, sub_number, multiply_number, divide_number,
+        less_than_number, less_than_equals_number,
+        greater_than_number, greater_than_equals_number,
+        equals_number, not_equals_number
     };
+
+    // The number of operators, this needs to be updated when an operator is added to the end.
+    const int num_vm_operators = static_cast<int>(vm_operator::not_equals_number) + 1;
 } // namespace lysithea_vm
@@ -0,0 +1,402 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <utility>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "tracking_allocator.hpp"
+
+namespace lysithea_vm
+{
+    // A hash array mapped trie that shares its structure with copies of itself.
+    // Each level of the trie uses 5 bits of the key's hash to pick one of 32 slots, only the used slots are stored.
+    // Copying is constant time and setting or removing a key copies at most one path through the trie.
+    // Nodes that are only used by one map are updated in place.
+    // Iteration order follows the hashes of the keys and not the keys themselves.
+    template <typename K, typename V, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>>
+    class persistent_map
+    {
+        private:
+            static const int bits = 5;
+            static const std::uint32_t mask = (1 << bits) - 1;
+
+            struct node;
+            using node_ptr = std::shared_ptr<node>;
+
+            struct entry
+            {
+                // Fields
+                std::size_t hash;
+                node_ptr child;
+                std::pair<K, V> pair;
+
+                // Constructor
+                entry(std::size_t hash, const K &key, const V &value) : hash(hash), pair(key, value) { }
+                entry(std::size_t hash, node_ptr child) : hash(hash), child(child) { }
+            };
+
+            struct node
+            {
+                // Fields
+                std::uint32_t bitmap;
+                bool is_collision;
+                std::vector<entry, tracking_allocator<entry>> entries;
+
+                // Constructor
+                node() : bitmap(0), is_collision(false) { }
+            };
+
+        public:
+            class const_iterator
+            {
+                public:
+                    using iterator_category = std::forward_iterator_tag;
+                    using value_type = std::pair<K, V>;
+                    using difference_type = std::ptrdiff_t;
+                    using pointer = const value_type *;
+                    using reference = const value_type &;
+
+                    // Constructor
+                    const_iterator() { }
+                    const_iterator(const node *root)
+                    {
+                        if (root)
+                        {
+                            stack.emplace_back(root, 0);
+                            settle();
+                        }
+                    }
+
+                    // Methods
+                    inline reference operator*() const { return stack.back().first->entries[stack.back().second].pair; }
+                    inline pointer operator->() const { return &**this; }
+
+                    inline const_iterator &operator++()
+                    {
+                        stack.back().second++;
+                        settle();
+                        return *this;
+                    }
+                    inline const_iterator operator++(int) { auto result = *this; ++*this; return result; }
+
+                    inline bool operator==(const const_iterator &other) const
+                    {
+                        if (stack.empty() || other.stack.empty())
+                        {
+                            return stack.empty() == other.stack.empty();
+                        }
+                        return stack.back() == other.stack.back();
+                    }
+                    inline bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+                private:
+                    // Fields
+                    std::vector<std::pair<const node *, std::size_t>> stack;
+
+                    // Methods
+                    void settle()
+                    {
+                        // Move down until the top of the stack is a key value pair.
+                        while (!stack.empty())
+                        {
+                            auto &top = stack.back();
+                            if (top.second >= top.first->entries.size())
+                            {
+                                stack.pop_back();
+                                if (!stack.empty())
+                                {
+                                    stack.back().second++;
+                                }
+                                continue;
+                            }
+
+                            const auto &found = top.first->entries[top.second];
+                            if (!found.child)
+                            {
+                                return;
+                            }
+                            stack.emplace_back(found.child.get(), 0);
+                        }
+                    }
+            };
+
+            using iterator = const_iterator;
+            using key_type = K;
+            using mapped_type = V;
+            using value_type = std::pair<K, V>;
+            using size_type = std::size_t;
+
+            // Constructor
+            persistent_map() : count(0) { }
+            persistent_map(std::initializer_list<value_type> input) : count(0)
+            {
+                for (const auto &iter : input)
+                {
+                    set(iter.first, iter.second);
+                }
+            }
+
+            // Methods
+            inline std::size_t size() const { return count; }
+            inline bool empty() const { return count == 0; }
+
+            inline const_iterator begin() const { return const_iterator(root.get()); }
+            inline const_iterator end() const { return const_iterator(); }
+            inline const_iterator cbegin() const { return begin(); }
+            inline const_iterator cend() const { return end(); }
+
+            inline void clear()
+            {
+                count = 0;
+                root.reset();
+            }
+
+            const V *find_value(const K &key) const
+            {
+                auto hash = Hash()(key);
+                auto current = root.get();
+                for (auto shift = 0; current; shift += bits)
+                {
+                    if (current->is_collision)
+                    {
+                        for (const auto &iter : current->entries)
+                        {
+                            if (Equal()(iter.pair.first, key))
+                            {
+                                return &iter.pair.second;
+                            }
+                        }
+                        return nullptr;
+                    }
+
+                    auto bit = bit_for(hash, shift);
+                    if ((current->bitmap & bit) == 0)
+                    {
+                        return nullptr;
+                    }
+
+                    const auto &found = current->entries[index_for(current->bitmap, bit)];
+                    if (found.child)
+                    {
+                        current = found.child.get();
+                        continue;
+                    }
+
+                    return found.hash == hash && Equal()(found.pair.first, key) ? &found.pair.second : nullptr;
+                }
+
+                return nullptr;
+            }
+
+            inline bool try_get(const K &key, V &result) const
+            {
+                auto found = find_value(key);
+                if (found)
+                {
+                    result = *found;
+                    return true;
+                }
+                return false;
+            }
+
+            inline std::size_t count_key(const K &key) const { return find_value(key) ? 1 : 0; }
+            inline bool contains(const K &key) const { return find_value(key) != nullptr; }
+
+            void set(const K &key, const V &input)
+            {
+                if (assoc(root, 0, Hash()(key), key, input))
+                {
+                    count++;
+                }
+            }
+
+            // Returns a writable reference, adding a default value if the key is missing.
+            V &operator[](const K &key)
+            {
+                auto hash = Hash()(key);
+                if (!contains(key))
+                {
+                    set(key, V());
+                }
+
+                auto current = &root;
+                for (auto shift = 0; ; shift += bits)
+                {
+                    make_unique(*current);
+                    auto &current_node = **current;
+                    if (current_node.is_collision)
+                    {
+                        for (auto &iter : current_node.entries)
+                        {
+                            if (Equal()(iter.pair.first, key))
+                            {
+                                return iter.pair.second;
+                            }
+                        }
+                    }
+
+                    auto &found = current_node.entries[index_for(current_node.bitmap, bit_for(hash, shift))];
+                    if (!found.child)
+                    {
+                        return found.pair.second;
+                    }
+                    current = &found.child;
+                }
+            }
+
+            std::size_t erase(const K &key)
+            {
+                if (!contains(key))
+                {
+                    return 0;
+                }
+
+                dissoc(root, 0, Hash()(key), key);
+                count--;
+                if (count == 0)
+                {
+                    root.reset();
+                }
+                return 1;
+            }
+
+        private:
+            // Fields
+            std::size_t count;
+            node_ptr root;
+
+            // Methods
+            inline static std::uint32_t bit_for(std::size_t hash, int shift)
+            {
+                return static_cast<std::uint32_t>(1) << ((hash >> shift) & mask);
+            }
+
+            inline static std::size_t index_for(std::uint32_t bitmap, std::uint32_t bit)
+            {
+                return std::bitset<32>(bitmap & (bit - 1)).count();
+            }
+
+            inline static void make_unique(node_ptr &input)
+            {
+                if (input.use_count() > 1)
+                {
+                    input = make_tracked<node>(*input);
+                }
+            }
+
+            // Returns true if the key was not already in the map.
+            static bool assoc(node_ptr &current, int shift, std::size_t hash, const K &key, const V &input)
+            {
+                if (!current)
+                {
+                    current = make_tracked<node>();
+                }
+                else
+                {
+                    make_unique(current);
+                }
+
+                auto &entries = current->entries;
+                if (current->is_collision)
+                {
+                    for (auto &iter : entries)
+                    {
+                        if (Equal()(iter.pair.first, key))
+                        {
+                            iter.pair.second = input;
+                            return false;
+                        }
+                    }
+                    entries.emplace_back(hash, key, input);
+                    return true;
+                }
+
+                auto bit = bit_for(hash, shift);
+                auto index = index_for(current->bitmap, bit);
+                if ((current->bitmap & bit) == 0)
+                {
+                    current->bitmap |= bit;
+                    entries.emplace(entries.begin() + index, hash, key, input);
+                    return true;
+                }
+
+                auto &found = entries[index];
+                if (found.child)
+                {
+                    return assoc(found.child, shift + bits, hash, key, input);
+                }
+
+                if (found.hash == hash && Equal()(found.pair.first, key))
+                {
+                    found.pair.second = input;
+                    return false;
+                }
+
+                // Two keys share this slot so move the existing one down a level, or into a collision node if the hashes are the same.
+                auto child = make_tracked<node>();
+                if (found.hash == hash)
+                {
+                    child->is_collision = true;
+                    child->entries.push_back(found);
+                    child->entries.emplace_back(hash, key, input);
+                }
+                else
+                {
+                    assoc(child, shift + bits, found.hash, found.pair.first, found.pair.second);
+                    assoc(child, shift + bits, hash, key, input);
+                }
+
+                found = entry(found.hash, child);
+                return true;
+            }
+
+            // Only called when the key is known to be in the map.
+            static void dissoc(node_ptr &current, int shift, std::size_t hash, const K &key)
+            {
+                make_unique(current);
+                auto &entries = current->entries;
+                if (current->is_collision)
+                {
+                    for (auto iter = entries.begin(); iter != entries.end(); ++iter)
+                    {
+                        if (Equal()(iter->pair.first, key))
+                        {
+                            entries.erase(iter);
+                            return;
+                        }
+                    }
+                    return;
+                }
+
+                auto bit = bit_for(hash, shift);
+                auto index = index_for(current->bitmap, bit);
+                auto &found = entries[index];
+                if (found.child)
+                {
+                    dissoc(found.child, shift + bits, hash, key);
+
+                    // Pull a single remaining key value pair back up into this node.
+                    const auto &child_entries = found.child->entries;
+                    if (child_entries.size() == 1 && !child_entries[0].child)
+                    {
+                        auto remaining = child_entries[0];
+                        found = remaining;
+                    }
+                    else if (child_entries.empty())
+                    {
+                        current->bitmap &= ~bit;
+                        entries.erase(entries.begin() + index);
+                    }
+                    return;
+                }
+
+                current->bitmap &= ~bit;
+                entries.erase(entries.begin() + index);
+            }
+    };
+} // lysithea_vm
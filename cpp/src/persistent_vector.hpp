@@ -0,0 +1,406 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <utility>
+#include <cstddef>
+#include <initializer_list>
+
+#include "tracking_allocator.hpp"
+
+namespace lysithea_vm
+{
+    // A vector that shares its structure with copies of itself.
+    // Values are stored in a trie of 32 wide nodes with the last partial node kept as a separate tail.
+    // Copying is constant time, and setting a value or pushing onto the end copies at most one path through the trie.
+    // Nodes that are only used by one vector are updated in place.
+    template <typename T>
+    class persistent_vector
+    {
+        private:
+            static const int bits = 5;
+            static const std::size_t width = 1 << bits;
+            static const std::size_t mask = width - 1;
+
+            struct node
+            {
+                // Fields
+                std::vector<T, tracking_allocator<T>> values;
+                std::vector<std::shared_ptr<node>, tracking_allocator<std::shared_ptr<node>>> children;
+            };
+
+            using node_ptr = std::shared_ptr<node>;
+
+        public:
+            class const_iterator
+            {
+                public:
+                    using iterator_category = std::random_access_iterator_tag;
+                    using value_type = T;
+                    using difference_type = std::ptrdiff_t;
+                    using pointer = const T *;
+                    using reference = const T &;
+
+                    // Fields
+                    const persistent_vector *parent;
+                    std::size_t index;
+
+                    // Constructor
+                    const_iterator() : parent(nullptr), index(0), leaf(nullptr), leaf_start(0) { }
+                    const_iterator(const persistent_vector *parent, std::size_t index) : parent(parent), index(index), leaf(nullptr), leaf_start(0) { }
+
+                    // Methods
+                    inline reference operator*() const
+                    {
+                        // Keep hold of the current leaf so that walking through the vector only looks up each leaf once.
+                        if (!leaf || index < leaf_start || index >= leaf_start + width)
+                        {
+                            leaf = parent->leaf_for(index);
+                            leaf_start = index & ~mask;
+                        }
+                        return leaf->values[index & mask];
+                    }
+                    inline pointer operator->() const { return &**this; }
+                    inline reference operator[](difference_type offset) const { return (*parent)[index + offset]; }
+
+                    inline const_iterator &operator++() { ++index; return *this; }
+                    inline const_iterator operator++(int) { auto result = *this; ++index; return result; }
+                    inline const_iterator &operator--() { --index; return *this; }
+                    inline const_iterator operator--(int) { auto result = *this; --index; return result; }
+                    inline const_iterator &operator+=(difference_type offset) { index += offset; return *this; }
+                    inline const_iterator &operator-=(difference_type offset) { index -= offset; return *this; }
+                    inline const_iterator operator+(difference_type offset) const { auto result = *this; return result += offset; }
+                    inline const_iterator operator-(difference_type offset) const { auto result = *this; return result -= offset; }
+                    inline difference_type operator-(const const_iterator &other) const { return static_cast<difference_type>(index) - static_cast<difference_type>(other.index); }
+
+                    inline bool operator==(const const_iterator &other) const { return index == other.index; }
+                    inline bool operator!=(const const_iterator &other) const { return index != other.index; }
+                    inline bool operator<(const const_iterator &other) const { return index < other.index; }
+                    inline bool operator<=(const const_iterator &other) const { return index <= other.index; }
+                    inline bool operator>(const const_iterator &other) const { return index > other.index; }
+                    inline bool operator>=(const const_iterator &other) const { return index >= other.index; }
+
+                private:
+                    // Fields
+                    mutable const node *leaf;
+                    mutable std::size_t leaf_start;
+            };
+
+            using iterator = const_iterator;
+            using value_type = T;
+            using size_type = std::size_t;
+
+            // Constructor
+            persistent_vector() : count(0), shift(bits) { }
+            explicit persistent_vector(std::size_t size) : persistent_vector(size, T()) { }
+            persistent_vector(std::size_t size, const T &input) : count(0), shift(bits)
+            {
+                for (std::size_t i = 0; i < size; i++)
+                {
+                    push_back(input);
+                }
+            }
+            template <typename Iter, typename = typename std::iterator_traits<Iter>::iterator_category>
+            persistent_vector(Iter first, Iter last) : count(0), shift(bits)
+            {
+                for (; first != last; ++first)
+                {
+                    push_back(*first);
+                }
+            }
+            persistent_vector(std::initializer_list<T> input) : persistent_vector(input.begin(), input.end()) { }
+            persistent_vector(const persistent_vector &input) = default;
+            persistent_vector(persistent_vector &&input) : count(input.count), shift(input.shift), root(std::move(input.root)), tail(std::move(input.tail))
+            {
+                input.clear();
+            }
+
+            // Operators
+            persistent_vector &operator=(const persistent_vector &input) = default;
+            persistent_vector &operator=(persistent_vector &&input)
+            {
+                if (this != &input)
+                {
+                    count = input.count;
+                    shift = input.shift;
+                    root = std::move(input.root);
+                    tail = std::move(input.tail);
+                    input.clear();
+                }
+                return *this;
+            }
+
+            // Methods
+            inline std::size_t size() const { return count; }
+            inline bool empty() const { return count == 0; }
+
+            inline const_iterator begin() const { return const_iterator(this, 0); }
+            inline const_iterator end() const { return const_iterator(this, count); }
+            inline const_iterator cbegin() const { return begin(); }
+            inline const_iterator cend() const { return end(); }
+
+            inline const T &operator[](std::size_t index) const { return leaf_for(index)->values[index & mask]; }
+            inline const T &front() const { return (*this)[0]; }
+            inline const T &back() const { return (*this)[count - 1]; }
+
+            // Returns a writable reference, any nodes shared with another vector are copied first.
+            inline T &operator[](std::size_t index)
+            {
+                if (index >= tail_offset())
+                {
+                    make_unique(tail);
+                    return tail->values[index & mask];
+                }
+
+                auto current = &root;
+                for (auto level = shift; ; level -= bits)
+                {
+                    make_unique(*current);
+                    if (level == 0)
+                    {
+                        return (*current)->values[index & mask];
+                    }
+                    current = &(*current)->children[(index >> level) & mask];
+                }
+            }
+            inline T &front() { return (*this)[0]; }
+            inline T &back() { return (*this)[count - 1]; }
+
+            inline void set(std::size_t index, const T &input)
+            {
+                (*this)[index] = input;
+            }
+
+            void push_back(const T &input)
+            {
+                if (!tail)
+                {
+                    tail = make_tracked<node>();
+                    tail->values.reserve(width);
+                }
+                else if (tail->values.size() == width)
+                {
+                    // The new tail is made first so that running out of memory leaves the vector as it was.
+                    auto new_tail = make_tracked<node>();
+                    new_tail->values.reserve(width);
+                    push_tail_into_trie();
+                    tail = std::move(new_tail);
+                }
+                else
+                {
+                    make_unique(tail);
+                }
+
+                tail->values.push_back(input);
+                count++;
+            }
+
+            template <typename... Args>
+            inline void emplace_back(Args&&... args)
+            {
+                push_back(T(std::forward<Args>(args)...));
+            }
+
+            inline void pop_back()
+            {
+                erase(end() - 1);
+            }
+
+            inline void clear()
+            {
+                count = 0;
+                shift = bits;
+                root.reset();
+                tail.reset();
+            }
+
+            inline void reserve(std::size_t size) { }
+
+            // Inserting and erasing keep everything before the change shared and rebuild the rest.
+            const_iterator insert(const_iterator position, const T &input)
+            {
+                auto index = position.index;
+                if (index == count)
+                {
+                    push_back(input);
+                    return const_iterator(this, index);
+                }
+
+                auto result = take(index);
+                result.push_back(input);
+                result.append(*this, index, count);
+                *this = std::move(result);
+                return const_iterator(this, index);
+            }
+
+            template <typename Iter>
+            const_iterator insert(const_iterator position, Iter first, Iter last)
+            {
+                auto index = position.index;
+                auto result = take(index);
+                for (; first != last; ++first)
+                {
+                    result.push_back(*first);
+                }
+                result.append(*this, index, count);
+                *this = std::move(result);
+                return const_iterator(this, index);
+            }
+
+            inline const_iterator erase(const_iterator position)
+            {
+                return erase(position, position + 1);
+            }
+
+            const_iterator erase(const_iterator first, const_iterator last)
+            {
+                auto index = first.index;
+                auto result = take(index);
+                result.append(*this, last.index, count);
+                *this = std::move(result);
+                return const_iterator(this, index);
+            }
+
+            // Returns a vector of the first size values, which shares all the full leaves with this vector.
+            persistent_vector take(std::size_t size) const
+            {
+                persistent_vector result;
+                std::size_t index = 0;
+                for (; index + width <= size && index + width <= tail_offset(); index += width)
+                {
+                    result.push_leaf(leaf_node_for(index));
+                }
+
+                result.append(*this, index, size);
+                return result;
+            }
+
+        private:
+            // Fields
+            std::size_t count;
+            int shift;
+            node_ptr root;
+            node_ptr tail;
+
+            // Methods
+            inline std::size_t tail_offset() const
+            {
+                if (count < width)
+                {
+                    return 0;
+                }
+                return ((count - 1) >> bits) << bits;
+            }
+
+            inline const node *leaf_for(std::size_t index) const
+            {
+                if (index >= tail_offset())
+                {
+                    return tail.get();
+                }
+
+                auto current = root.get();
+                for (auto level = shift; level > 0; level -= bits)
+                {
+                    current = current->children[(index >> level) & mask].get();
+                }
+                return current;
+            }
+
+            inline const node_ptr &leaf_node_for(std::size_t index) const
+            {
+                auto current = &root;
+                for (auto level = shift; level > 0; level -= bits)
+                {
+                    current = &(*current)->children[(index >> level) & mask];
+                }
+                return *current;
+            }
+
+            inline static void make_unique(node_ptr &input)
+            {
+                if (input.use_count() > 1)
+                {
+                    input = make_tracked<node>(*input);
+                }
+            }
+
+            void append(const persistent_vector &input, std::size_t start, std::size_t end)
+            {
+                for (auto iter = const_iterator(&input, start); iter.index < end; ++iter)
+                {
+                    push_back(*iter);
+                }
+            }
+
+            // Adds a full leaf to the end, only valid when the vector's size is a multiple of the node width.
+            void push_leaf(const node_ptr &leaf)
+            {
+                if (tail)
+                {
+                    push_tail_into_trie();
+                }
+
+                tail = leaf;
+                count += width;
+            }
+
+            void push_tail_into_trie()
+            {
+                // The tail is full, move it into the trie adding a new level if the root is also full.
+                if ((count >> bits) > (static_cast<std::size_t>(1) << shift))
+                {
+                    auto new_root = make_tracked<node>();
+                    new_root->children.push_back(root);
+                    new_root->children.push_back(new_path(shift, tail));
+                    root = new_root;
+                    shift += bits;
+                }
+                else
+                {
+                    push_tail(shift, root, tail);
+                }
+            }
+
+            void push_tail(int level, node_ptr &parent, const node_ptr &tail_node)
+            {
+                if (!parent)
+                {
+                    // Made whole before being set so that running out of memory part way leaves the trie as it was.
+                    parent = new_path(level, tail_node);
+                    return;
+                }
+                make_unique(parent);
+
+                auto sub_index = ((count - 1) >> level) & mask;
+                auto &children = parent->children;
+                if (level == bits)
+                {
+                    children.push_back(tail_node);
+                    return;
+                }
+
+                if (sub_index < children.size())
+                {
+                    push_tail(level - bits, children[sub_index], tail_node);
+                }
+                else
+                {
+                    children.push_back(new_path(level - bits, tail_node));
+                }
+            }
+
+            static node_ptr new_path(int level, const node_ptr &input)
+            {
+                if (level == 0)
+                {
+                    return input;
+                }
+
+                auto result = make_tracked<node>();
+                result->children.push_back(new_path(level - bits, input));
+                return result;
+            }
+    };
+} // lysithea_vm
@@ -4,23 +4,81 @@
 
 namespace lysithea_vm
 {
-    scope::scope() { }
-    scope::scope(std::shared_ptr<scope> parent): parent(parent) { }
+    std::atomic<std::uint64_t> scope::parent_versions(0);
+
+    scope::scope() : owner(0), id(0), version(0), num_children(0) { }
+    scope::scope(std::shared_ptr<scope> parent): parent(parent), owner(0), id(0), version(0), num_children(0)
+    {
+        if (this->parent)
+        {
+            this->parent->num_children++;
+        }
+    }
+    // A copy starts without any children of its own.
+    scope::scope(const scope &input) : values(input.values), constants(input.constants), parent(input.parent), upvalues(input.upvalues),
+        owner(input.owner), id(input.id), version(input.version), num_children(0)
+    {
+        if (parent)
+        {
+            parent->num_children++;
+        }
+    }
+
+    scope::~scope()
+    {
+        if (parent)
+        {
+            parent->num_children--;
+        }
+    }
+
+    // The children stay with this scope, they are not copied.
+    scope &scope::operator=(const scope &input)
+    {
+        values = input.values;
+        constants = input.constants;
+        if (parent != input.parent)
+        {
+            set_parent(input.parent);
+        }
+        upvalues = input.upvalues;
+        owner = input.owner;
+        id = input.id;
+        version = input.version;
+        return *this;
+    }
+
+    void scope::set_parent(std::shared_ptr<scope> input)
+    {
+        if (parent)
+        {
+            parent->num_children--;
+        }
+        parent = std::move(input);
+        if (parent)
+        {
+            parent->num_children++;
+        }
+        parent_versions++;
+    }
 
     void scope::clear()
     {
         values.clear();
         constants.clear();
+        changed();
     }
 
     void scope::combine_scope(const scope &input)
     {
-        for (auto iter : input.values)
+        changed();
+
+        for (const auto &iter : input.values)
         {
             values[iter.first] = iter.second;
         }
 
-        for (auto iter : input.constants)
+        for (const auto &iter : input.constants)
         {
             constants[iter.first] = iter.second;
         }
@@ -39,7 +97,23 @@ namespace lysithea_vm
             return false;
         }
 
-        values[key] = input;
+        auto find = values.find(key);
+        if (find == values.end())
+        {
+            values.emplace(key, std::move(input));
+            changed();
+            return true;
+        }
+
+        // Defining the variable again keeps it in the same place, and in the same cell so that closures see the new value.
+        if (auto cell = get_cell(find->second))
+        {
+            cell->data = std::move(input);
+        }
+        else
+        {
+            find->second = std::move(input);
+        }
         return true;
     }
 
@@ -76,13 +150,20 @@ namespace lysithea_vm
         auto find = values.find(key);
         if (find != values.end())
         {
-            find->second = input;
+            if (auto cell = get_cell(find->second))
+            {
+                cell->data = std::move(input);
+            }
+            else
+            {
+                find->second = std::move(input);
+            }
             return true;
         }
 
         if (parent)
         {
-            return parent->try_set(key, input);
+            return parent->try_set(key, std::move(input));
         }
 
         return false;
@@ -93,7 +174,8 @@ namespace lysithea_vm
         auto find = values.find(key);
         if (find != values.cend())
         {
-            result = find->second;
+            auto cell = get_cell(find->second);
+            result = cell ? cell->data : find->second;
             return true;
         }
 
@@ -135,6 +217,21 @@ namespace lysithea_vm
         return false;
     }
 
+    const scope *scope::find_key_scope(const std::string &key) const
+    {
+        auto current = this;
+        while (current)
+        {
+            if (current->values.find(key) != current->values.cend())
+            {
+                return current;
+            }
+            current = current->parent.get();
+        }
+
+        return nullptr;
+    }
+
     bool scope::is_constant(const std::string &key) const
     {
         auto find = constants.find(key);
@@ -144,5 +241,15 @@ namespace lysithea_vm
     void scope::set_constant(const std::string &key)
     {
         constants.emplace(key, true);
+        changed();
+    }
+
+    void scope::changed()
+    {
+        version++;
+        if (num_children > 0)
+        {
+            parent_versions++;
+        }
     }
 } // lysithea_vm
\ No newline at end of file
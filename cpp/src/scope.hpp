@@ -3,25 +3,51 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <cstdint>
+#include <atomic>
 
 #include "./values/value.hpp"
 #include "./values/builtin_function_value.hpp"
+#include "./values/cell_value.hpp"
+#include "./tracking_allocator.hpp"
 
 namespace lysithea_vm
 {
+    template <typename T>
+    using scope_map = std::unordered_map<std::string, T, std::hash<std::string>, std::equal_to<std::string>, tracking_allocator<std::pair<const std::string, T>>>;
+
     class scope
     {
         public:
             // Fields
-            std::unordered_map<std::string, value> values;
-            std::unordered_map<std::string, bool> constants;
+            scope_map<value> values;
+            scope_map<bool> constants;
+            // Only changed through set_parent so that the parent's count of children stays right.
             std::shared_ptr<scope> parent;
+            // The cells captured by the closure that this scope was made to call.
+            upvalue_list upvalues;
+            // The virtual machine that is allowed to change this scope in place, forked virtual machines copy it first.
+            std::uint64_t owner;
+            // Given by the virtual machine that made the scope so that its lookup caches can tell scopes apart, 0 if it was made elsewhere.
+            std::uint64_t id;
+            // Goes up each time a variable is added or removed, a cached lookup that searched this scope is only used while it is the same.
+            std::uint64_t version;
+            // How many scopes have this one as their parent, the scopes of forked virtual machines can be made on other threads.
+            std::atomic<int> num_children;
+
+            // Goes up each time a scope that is the parent of another has a variable added or removed, or a scope is given a new parent.
+            // A cached lookup only has to check this and the scope it started from, not each of the parents that it searched.
+            static std::atomic<std::uint64_t> parent_versions;
 
             // Constructor
             scope();
             scope(std::shared_ptr<scope> parent);
+            scope(const scope &input);
+            ~scope();
 
             // Methods
+            scope &operator=(const scope &input);
+            void set_parent(std::shared_ptr<scope> input);
             void clear();
             void combine_scope(const scope &input);
 
@@ -34,8 +60,23 @@ namespace lysithea_vm
             bool try_get_key(const std::string &key, value &result) const;
             bool try_get_number(const std::string &key, double &result) const;
             bool try_get_bool(const std::string &key, bool &result) const;
+            const scope *find_key_scope(const std::string &key) const;
 
             bool is_constant(const std::string &key) const;
             void set_constant(const std::string &key);
+
+            // Variables captured by a closure are kept in a cell, the methods above read and write the value inside it.
+            static inline cell_value *get_cell(const value &input)
+            {
+                if (input.is_complex() && input.data->kind == complex_kind::cell)
+                {
+                    return static_cast<cell_value *>(input.data.get());
+                }
+                return nullptr;
+            }
+
+        private:
+            // Methods
+            void changed();
     };
 } // lysithea_vm
\ No newline at end of file
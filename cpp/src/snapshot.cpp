@@ -0,0 +1,760 @@
+#include "snapshot.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "virtual_machine.hpp"
+#include "./values/values.hpp"
+#include "./values/variable_value.hpp"
+
+namespace lysithea_vm
+{
+    namespace
+    {
+        const char snapshot_magic[] = { 'L', 'Y', 'S', 'S' };
+        const std::uint8_t snapshot_version = 2;
+
+        enum class snapshot_tag : std::uint8_t
+        {
+            undefined, null, is_true, is_false, number, reference,
+            string, variable, array, arguments, object, function, builtin, number_array, set, cell, closure
+        };
+
+        // Scopes are written as 0 for null, 1 for a new scope that follows, or the index of a scope already written plus 2.
+        const std::uint32_t scope_null = 0;
+        const std::uint32_t scope_new = 1;
+        const std::uint32_t scope_index_start = 2;
+
+        class snapshot_writer
+        {
+            public:
+                // Fields
+                std::string data;
+
+                // Constructor
+                snapshot_writer(const std::unordered_map<const function *, std::uint32_t> &function_ids, const std::unordered_map<const complex_value *, std::string> &builtin_paths) :
+                    function_ids(function_ids), builtin_paths(builtin_paths) { }
+
+                // Methods
+                inline void write_byte(std::uint8_t input)
+                {
+                    data.push_back(static_cast<char>(input));
+                }
+
+                inline void write_varint(std::uint64_t input)
+                {
+                    while (input >= 0x80)
+                    {
+                        write_byte(static_cast<std::uint8_t>(input | 0x80));
+                        input >>= 7;
+                    }
+                    write_byte(static_cast<std::uint8_t>(input));
+                }
+
+                inline void write_double(double input)
+                {
+                    std::uint64_t bits;
+                    std::memcpy(&bits, &input, sizeof(bits));
+                    for (auto i = 0; i < 8; i++)
+                    {
+                        write_byte(static_cast<std::uint8_t>(bits >> (i * 8)));
+                    }
+                }
+
+                inline void write_string(const std::string &input)
+                {
+                    write_varint(input.size());
+                    data.append(input);
+                }
+
+                inline void write_tag(snapshot_tag input)
+                {
+                    write_byte(static_cast<std::uint8_t>(input));
+                }
+
+                void write_function(const function *input)
+                {
+                    auto find = function_ids.find(input);
+                    if (find == function_ids.end())
+                    {
+                        throw std::runtime_error("Unable to snapshot function that is not part of the script: " + input->name);
+                    }
+                    write_varint(find->second);
+                }
+
+                void write_value(const value &input)
+                {
+                    switch (input.type)
+                    {
+                        case value_type::undefined: write_tag(snapshot_tag::undefined); return;
+                        case value_type::null: write_tag(snapshot_tag::null); return;
+                        case value_type::is_true: write_tag(snapshot_tag::is_true); return;
+                        case value_type::is_false: write_tag(snapshot_tag::is_false); return;
+                        case value_type::number:
+                        {
+                            write_tag(snapshot_tag::number);
+                            write_double(input.number);
+                            return;
+                        }
+                        case value_type::complex: break;
+                    }
+
+                    const auto complex = input.data.get();
+                    auto find = value_ids.find(complex);
+                    if (find != value_ids.end())
+                    {
+                        write_tag(snapshot_tag::reference);
+                        write_varint(find->second);
+                        return;
+                    }
+
+                    // A closure can be stored in a cell that it captured, so cells are given their id before their contents.
+                    if (complex->kind == complex_kind::cell)
+                    {
+                        value_ids[complex] = static_cast<std::uint32_t>(value_ids.size());
+                        write_tag(snapshot_tag::cell);
+                        write_value(static_cast<const cell_value *>(complex)->data);
+                        return;
+                    }
+
+                    write_complex(complex);
+
+                    // Other values can't refer back to themselves, so the id is given once the contents are written the same as when reading.
+                    auto id = static_cast<std::uint32_t>(value_ids.size());
+                    value_ids[complex] = id;
+                }
+
+                void write_complex(const complex_value *input)
+                {
+                    switch (input->kind)
+                    {
+                        case complex_kind::string:
+                        {
+                            write_tag(snapshot_tag::string);
+                            write_string(static_cast<const string_value *>(input)->to_string());
+                            return;
+                        }
+                        case complex_kind::variable:
+                        {
+                            write_tag(snapshot_tag::variable);
+                            write_string(static_cast<const variable_value *>(input)->data);
+                            return;
+                        }
+                        case complex_kind::array:
+                        {
+                            auto array = static_cast<const array_value *>(input);
+                            write_tag(array->is_arguments_value ? snapshot_tag::arguments : snapshot_tag::array);
+                            write_varint(array->data.size());
+                            for (const auto &iter : array->data)
+                            {
+                                write_value(iter);
+                            }
+                            return;
+                        }
+                        case complex_kind::object:
+                        {
+                            auto object = static_cast<const object_value *>(input);
+                            write_tag(snapshot_tag::object);
+                            write_varint(object->data.size());
+                            for (const auto &iter : object->data)
+                            {
+                                write_string(iter.first);
+                                write_value(iter.second);
+                            }
+                            return;
+                        }
+                        case complex_kind::function:
+                        {
+                            auto func = static_cast<const function_value *>(input);
+                            if (func->captures.empty())
+                            {
+                                write_tag(snapshot_tag::function);
+                                write_function(func->data.get());
+                                return;
+                            }
+
+                            write_tag(snapshot_tag::closure);
+                            write_function(func->data.get());
+                            write_upvalues(func->captures);
+                            return;
+                        }
+                        case complex_kind::builtin_function:
+                        {
+                            auto find = builtin_paths.find(input);
+                            if (find == builtin_paths.end())
+                            {
+                                throw std::runtime_error("Unable to snapshot builtin function that is not in the builtin scope");
+                            }
+                            write_tag(snapshot_tag::builtin);
+                            write_string(find->second);
+                            return;
+                        }
+                        case complex_kind::number_array:
+                        {
+                            auto numbers = static_cast<const number_array_value *>(input);
+                            write_tag(snapshot_tag::number_array);
+                            write_varint(numbers->data.size());
+                            for (auto iter : numbers->data)
+                            {
+                                write_double(iter);
+                            }
+                            return;
+                        }
+                        case complex_kind::set:
+                        {
+                            auto set = static_cast<const set_value *>(input);
+                            write_tag(snapshot_tag::set);
+                            write_varint(set->data.size());
+                            for (const auto &iter : set->data)
+                            {
+                                write_value(iter.first);
+                            }
+                            return;
+                        }
+                        default:
+                        {
+                            throw std::runtime_error("Unable to snapshot value of type: " + input->type_name());
+                        }
+                    }
+                }
+
+                void write_scope(const std::shared_ptr<scope> &input)
+                {
+                    if (!input)
+                    {
+                        write_varint(scope_null);
+                        return;
+                    }
+
+                    auto find = scope_ids.find(input.get());
+                    if (find != scope_ids.end())
+                    {
+                        write_varint(find->second + scope_index_start);
+                        return;
+                    }
+
+                    auto id = static_cast<std::uint32_t>(scope_ids.size());
+                    scope_ids[input.get()] = id;
+
+                    write_varint(scope_new);
+                    write_scope(input->parent);
+
+                    write_varint(input->values.size());
+                    for (const auto &iter : input->values)
+                    {
+                        write_string(iter.first);
+                        write_value(iter.second);
+                    }
+
+                    write_varint(input->constants.size());
+                    for (const auto &iter : input->constants)
+                    {
+                        write_string(iter.first);
+                        write_byte(iter.second ? 1 : 0);
+                    }
+
+                    write_upvalues(input->upvalues);
+                }
+
+                void write_upvalues(const upvalue_list &input)
+                {
+                    write_varint(input.size());
+                    for (const auto &iter : input)
+                    {
+                        write_value(iter);
+                    }
+                }
+
+            private:
+                // Fields
+                const std::unordered_map<const function *, std::uint32_t> &function_ids;
+                const std::unordered_map<const complex_value *, std::string> &builtin_paths;
+                std::unordered_map<const complex_value *, std::uint32_t> value_ids;
+                std::unordered_map<const scope *, std::uint32_t> scope_ids;
+        };
+
+        class snapshot_reader
+        {
+            public:
+                // Constructor
+                snapshot_reader(const std::string &data, const std::vector<std::shared_ptr<function>> &functions,
+                    const std::vector<value> &function_values, const std::unordered_map<std::string, value> &builtins) :
+                    position(data.data()), end(data.data() + data.size()),
+                    functions(functions), function_values(function_values), builtins(builtins) { }
+
+                // Methods
+                inline void need(std::size_t size) const
+                {
+                    if (static_cast<std::size_t>(end - position) < size)
+                    {
+                        throw std::runtime_error("Unable to restore snapshot, data ended early");
+                    }
+                }
+
+                inline std::uint8_t read_byte()
+                {
+                    need(1);
+                    return static_cast<std::uint8_t>(*position++);
+                }
+
+                inline std::uint64_t read_varint()
+                {
+                    std::uint64_t result = 0;
+                    for (auto shift = 0; shift < 64; shift += 7)
+                    {
+                        auto byte = read_byte();
+                        result |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+                        if ((byte & 0x80) == 0)
+                        {
+                            return result;
+                        }
+                    }
+                    throw std::runtime_error("Unable to restore snapshot, invalid number");
+                }
+
+                // Used for counts so that bad data can't ask for a huge amount of memory up front.
+                inline std::size_t read_count()
+                {
+                    auto result = read_varint();
+                    if (result > static_cast<std::uint64_t>(end - position))
+                    {
+                        throw std::runtime_error("Unable to restore snapshot, invalid count");
+                    }
+                    return static_cast<std::size_t>(result);
+                }
+
+                inline double read_double()
+                {
+                    need(8);
+                    std::uint64_t bits = 0;
+                    for (auto i = 0; i < 8; i++)
+                    {
+                        bits |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(position[i])) << (i * 8);
+                    }
+                    position += 8;
+
+                    double result;
+                    std::memcpy(&result, &bits, sizeof(result));
+                    return result;
+                }
+
+                inline std::string read_string()
+                {
+                    auto size = read_count();
+                    std::string result(position, size);
+                    position += size;
+                    return result;
+                }
+
+                std::shared_ptr<function> read_function()
+                {
+                    auto id = read_varint();
+                    if (id >= functions.size())
+                    {
+                        throw std::runtime_error("Unable to restore snapshot, unknown function id");
+                    }
+                    return functions[id];
+                }
+
+                value read_value()
+                {
+                    auto tag = static_cast<snapshot_tag>(read_byte());
+                    switch (tag)
+                    {
+                        case snapshot_tag::undefined: return value();
+                        case snapshot_tag::null: return value::make_null();
+                        case snapshot_tag::is_true: return value(true);
+                        case snapshot_tag::is_false: return value(false);
+                        case snapshot_tag::number: return value(read_double());
+                        case snapshot_tag::reference:
+                        {
+                            auto id = read_varint();
+                            if (id >= values.size())
+                            {
+                                throw std::runtime_error("Unable to restore snapshot, unknown value id");
+                            }
+                            return values[id];
+                        }
+                        case snapshot_tag::cell:
+                        {
+                            auto cell = make_tracked<cell_value>(value(), 0);
+                            values.push_back(value(cell));
+                            cell->data = read_value();
+                            return value(cell);
+                        }
+                        default: break;
+                    }
+
+                    auto result = read_complex(tag);
+                    values.push_back(result);
+                    return result;
+                }
+
+                upvalue_list read_upvalues()
+                {
+                    auto count = read_count();
+                    upvalue_list result;
+                    for (std::size_t i = 0; i < count; i++)
+                    {
+                        auto captured = read_value();
+                        if (!captured.is_undefined() && !scope::get_cell(captured))
+                        {
+                            throw std::runtime_error("Unable to restore snapshot, captured variable is not a cell");
+                        }
+                        result.push_back(std::move(captured));
+                    }
+                    return result;
+                }
+
+                value read_complex(snapshot_tag tag)
+                {
+                    switch (tag)
+                    {
+                        case snapshot_tag::string: return value(read_string());
+                        case snapshot_tag::variable: return value(make_tracked<variable_value>(read_string()));
+                        case snapshot_tag::array:
+                        case snapshot_tag::arguments:
+                        {
+                            auto count = read_count();
+                            array_vector data;
+                            for (std::size_t i = 0; i < count; i++)
+                            {
+                                data.push_back(read_value());
+                            }
+                            return array_value::make_value(data, tag == snapshot_tag::arguments);
+                        }
+                        case snapshot_tag::object:
+                        {
+                            auto count = read_count();
+                            object_map data;
+                            for (std::size_t i = 0; i < count; i++)
+                            {
+                                auto key = read_string();
+                                data.set(key, read_value());
+                            }
+                            return object_value::make_value(data);
+                        }
+                        case snapshot_tag::function:
+                        {
+                            auto id = read_varint();
+                            if (id >= functions.size())
+                            {
+                                throw std::runtime_error("Unable to restore snapshot, unknown function id");
+                            }
+                            if (!function_values[id].is_undefined())
+                            {
+                                return function_values[id];
+                            }
+                            return value(make_tracked<function_value>(functions[id]));
+                        }
+                        case snapshot_tag::closure:
+                        {
+                            auto code = read_function();
+                            return value(make_tracked<function_value>(code, read_upvalues()));
+                        }
+                        case snapshot_tag::builtin:
+                        {
+                            auto path = read_string();
+                            auto find = builtins.find(path);
+                            if (find == builtins.end())
+                            {
+                                throw std::runtime_error("Unable to restore snapshot, unknown builtin: " + path);
+                            }
+                            return find->second;
+                        }
+                        case snapshot_tag::number_array:
+                        {
+                            auto count = read_count();
+                            number_vector data;
+                            data.reserve(count);
+                            for (std::size_t i = 0; i < count; i++)
+                            {
+                                data.push_back(read_double());
+                            }
+                            return number_array_value::make_value(std::move(data));
+                        }
+                        case snapshot_tag::set:
+                        {
+                            auto count = read_count();
+                            set_map data;
+                            for (std::size_t i = 0; i < count; i++)
+                            {
+                                data.set(read_value(), true);
+                            }
+                            return set_value::make_value(data);
+                        }
+                        default:
+                        {
+                            throw std::runtime_error("Unable to restore snapshot, unknown value tag");
+                        }
+                    }
+                }
+
+                std::shared_ptr<scope> read_scope()
+                {
+                    auto id = read_varint();
+                    if (id == scope_null)
+                    {
+                        return nullptr;
+                    }
+                    if (id != scope_new)
+                    {
+                        id -= scope_index_start;
+                        if (id >= scopes.size())
+                        {
+                            throw std::runtime_error("Unable to restore snapshot, unknown scope id");
+                        }
+                        return scopes[id];
+                    }
+
+                    auto result = make_tracked<scope>();
+                    scopes.push_back(result);
+
+                    result->set_parent(read_scope());
+
+                    auto num_values = read_count();
+                    for (std::size_t i = 0; i < num_values; i++)
+                    {
+                        auto key = read_string();
+                        result->values[key] = read_value();
+                    }
+
+                    auto num_constants = read_count();
+                    for (std::size_t i = 0; i < num_constants; i++)
+                    {
+                        auto key = read_string();
+                        result->constants[key] = read_byte() != 0;
+                    }
+
+                    result->upvalues = read_upvalues();
+
+                    return result;
+                }
+
+                // Every scope that has been read so far.
+                inline const std::vector<std::shared_ptr<scope>> &read_scopes() const
+                {
+                    return scopes;
+                }
+
+            private:
+                // Fields
+                const char *position;
+                const char *end;
+                const std::vector<std::shared_ptr<function>> &functions;
+                const std::vector<value> &function_values;
+                const std::unordered_map<std::string, value> &builtins;
+                std::vector<value> values;
+                std::vector<std::shared_ptr<scope>> scopes;
+        };
+    }
+
+    snapshot_context::snapshot_context(std::shared_ptr<script> target) : target(target)
+    {
+        add_function(target->code, value());
+
+        if (target->builtin_scope)
+        {
+            // Named functions are constants in the builtin scope, the keys are sorted so that their ids don't depend on the hash order.
+            std::vector<std::string> keys;
+            for (const auto &iter : target->builtin_scope->values)
+            {
+                keys.push_back(iter.first);
+            }
+            std::sort(keys.begin(), keys.end());
+
+            for (const auto &key : keys)
+            {
+                const auto &input = target->builtin_scope->values.find(key)->second;
+                add_code_value(input);
+                add_builtins(key, input, 0);
+            }
+        }
+    }
+
+    std::string snapshot_context::save(const virtual_machine &vm) const
+    {
+        snapshot_writer writer(function_ids, builtin_paths);
+        writer.data.append(snapshot_magic, sizeof(snapshot_magic));
+        writer.write_byte(snapshot_version);
+
+        writer.write_byte((vm.running ? 1 : 0) | (vm.paused ? 2 : 0));
+        writer.write_varint(static_cast<std::uint64_t>(vm.program_counter));
+        writer.write_function(vm.current_code.get());
+        writer.write_scope(vm.global_scope);
+        writer.write_scope(vm.current_scope);
+
+        auto stack_size = vm.stack.stack_size();
+        auto stack_data = vm.stack.data_from(0);
+        writer.write_varint(static_cast<std::uint64_t>(stack_size));
+        for (auto i = 0; i < stack_size; i++)
+        {
+            writer.write_value(stack_data[i]);
+        }
+
+        auto frames_size = vm.stack_trace.stack_size();
+        auto frames_data = vm.stack_trace.data_from(0);
+        writer.write_varint(static_cast<std::uint64_t>(frames_size));
+        for (auto i = 0; i < frames_size; i++)
+        {
+            const auto &frame = frames_data[i];
+            writer.write_varint(static_cast<std::uint64_t>(frame.line_counter));
+            writer.write_function(frame.code.get());
+            writer.write_scope(frame.frame_scope);
+        }
+
+        return writer.data;
+    }
+
+    void snapshot_context::restore(virtual_machine &vm, const std::string &data) const
+    {
+        if (data.size() < sizeof(snapshot_magic) + 1 || data.compare(0, sizeof(snapshot_magic), snapshot_magic, sizeof(snapshot_magic)) != 0)
+        {
+            throw std::runtime_error("Unable to restore snapshot, not snapshot data");
+        }
+        if (static_cast<std::uint8_t>(data[sizeof(snapshot_magic)]) != snapshot_version)
+        {
+            throw std::runtime_error("Unable to restore snapshot, unsupported version");
+        }
+
+        // Everything is read before the virtual machine is changed so that bad data leaves it as it was.
+        memory_scope tracking(vm.memory.get());
+        snapshot_reader reader(data, functions, function_values, builtins);
+        reader.need(sizeof(snapshot_magic) + 1);
+        for (std::size_t i = 0; i < sizeof(snapshot_magic) + 1; i++)
+        {
+            reader.read_byte();
+        }
+
+        auto flags = reader.read_byte();
+        auto program_counter = static_cast<int>(reader.read_varint());
+        auto current_code = reader.read_function();
+        auto global_scope = reader.read_scope();
+        auto current_scope = reader.read_scope();
+
+        auto stack_size = reader.read_count();
+        if (stack_size > static_cast<std::size_t>(vm.stack.max_stack_size()))
+        {
+            throw std::runtime_error("Unable to restore snapshot, operand stack is too small");
+        }
+        std::vector<value> stack;
+        stack.reserve(stack_size);
+        for (std::size_t i = 0; i < stack_size; i++)
+        {
+            stack.push_back(reader.read_value());
+        }
+
+        auto frames_size = reader.read_count();
+        if (frames_size > static_cast<std::size_t>(vm.stack_trace.max_stack_size()))
+        {
+            throw std::runtime_error("Unable to restore snapshot, stack trace is too small");
+        }
+        std::vector<scope_frame> frames;
+        frames.reserve(frames_size);
+        for (std::size_t i = 0; i < frames_size; i++)
+        {
+            auto line_counter = static_cast<int>(reader.read_varint());
+            auto code = reader.read_function();
+            frames.emplace_back(line_counter, code, reader.read_scope());
+        }
+
+        vm.stack.clear();
+        for (auto &iter : stack)
+        {
+            vm.stack.push(std::move(iter));
+        }
+
+        vm.stack_trace.clear();
+        for (auto &iter : frames)
+        {
+            vm.stack_trace.push(std::move(iter));
+        }
+
+        vm.builtin_scope = target->builtin_scope;
+        vm.current_code = current_code;
+        vm.global_scope = global_scope;
+        vm.current_scope = current_scope;
+        vm.program_counter = program_counter;
+        vm.cell_copies.clear();
+        vm.clear_lookup_caches();
+        for (const auto &iter : reader.read_scopes())
+        {
+            iter->id = vm.next_scope_id++;
+        }
+        vm.running = (flags & 1) != 0;
+        vm.paused = (flags & 2) != 0;
+    }
+
+    void snapshot_context::add_function(std::shared_ptr<function> input, const value &function_value)
+    {
+        auto find = function_ids.find(input.get());
+        if (find != function_ids.end())
+        {
+            if (function_values[find->second].is_undefined())
+            {
+                function_values[find->second] = function_value;
+            }
+            return;
+        }
+
+        function_ids[input.get()] = static_cast<std::uint32_t>(functions.size());
+        functions.push_back(input);
+        function_values.push_back(function_value);
+
+        for (const auto &iter : input->code)
+        {
+            add_code_value(iter.value);
+        }
+    }
+
+    void snapshot_context::add_code_value(const value &input)
+    {
+        if (auto func = input.get_complex<const function_value>())
+        {
+            add_function(func->data, input);
+        }
+        else if (auto array = input.get_complex<const array_value>())
+        {
+            for (const auto &iter : array->data)
+            {
+                add_code_value(iter);
+            }
+        }
+        else if (auto object = input.get_complex<const object_value>())
+        {
+            for (const auto &iter : object->data)
+            {
+                add_code_value(iter.second);
+            }
+        }
+    }
+
+    void snapshot_context::add_builtins(const std::string &path, const value &input, int depth)
+    {
+        if (!input.is_complex())
+        {
+            return;
+        }
+
+        auto complex = input.data.get();
+        if (complex->kind == complex_kind::builtin_function)
+        {
+            if (builtin_paths.find(complex) == builtin_paths.end())
+            {
+                builtin_paths[complex] = path;
+                builtins[path] = input;
+            }
+        }
+        else if (depth < 2)
+        {
+            if (auto object = input.get_complex<const object_value>())
+            {
+                for (const auto &iter : object->data)
+                {
+                    add_builtins(path + "." + iter.first, iter.second, depth + 1);
+                }
+            }
+        }
+    }
+} // lysithea_vm
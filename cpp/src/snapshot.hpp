@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "script.hpp"
+#include "function.hpp"
+#include "./values/value.hpp"
+
+namespace lysithea_vm
+{
+    class virtual_machine;
+
+    // Saves and restores the state of a virtual machine running a script as compact binary data.
+    //
+    // A snapshot holds the operand stack, the scope frames, the program counter, the current code and every scope
+    // and value that they reach. Values and scopes used in more than one place are only written once.
+    // Functions are written as ids into the script and builtins as their path in the builtin scope (eg: "math.sin"),
+    // so the same script has to be loaded to restore a snapshot.
+    //
+    // The context is made once per script and can then be used for as many saves and restores as needed.
+    class snapshot_context
+    {
+        public:
+            // Fields
+            std::shared_ptr<script> target;
+
+            // Constructor
+            snapshot_context(std::shared_ptr<script> target);
+
+            // Methods
+            // The virtual machine should be between steps, or in a native function that was called without arguments.
+            std::string save(const virtual_machine &vm) const;
+            void restore(virtual_machine &vm, const std::string &data) const;
+
+        private:
+            // Fields
+            std::vector<std::shared_ptr<function>> functions;
+            std::vector<value> function_values;
+            std::unordered_map<const function *, std::uint32_t> function_ids;
+            std::unordered_map<const complex_value *, std::string> builtin_paths;
+            std::unordered_map<std::string, value> builtins;
+
+            // Methods
+            void add_function(std::shared_ptr<function> input, const value &function_value);
+            void add_code_value(const value &input);
+            void add_builtins(const std::string &prefix, const value &input, int depth);
+    };
+} // lysithea_vm
@@ -16,73 +16,122 @@ namespace lysithea_vm
         auto result = std::make_shared<scope>();
 
         auto functions = std::make_shared<object_value>();
-        functions->data["join"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["join"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            vm.push_stack(value(std::make_shared<array_value>(args.data, false)));
+            vm.push_stack(array_value::make_value(array_vector(args.begin(), args.end())));
         });
-        functions->data["length"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["length"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.get_index<const array_value>(0);
-            vm.push_stack(top->array_length());
+            const auto &top = args.get_index(0);
+            if (top.is_number_array())
+            {
+                vm.push_stack(top.get_complex()->array_length());
+                return;
+            }
+
+            vm.push_stack(args.get_index<const array_value>(0)->array_length());
         });
-        functions->data["get"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["get"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
+            value found;
+            if (args.get_index(0).is_number_array())
+            {
+                if (!args[0].get_complex()->try_get(args.get_int(1), found))
+                {
+                    throw std::out_of_range("Error getting array at index, out of range");
+                }
+                vm.push_stack(found);
+                return;
+            }
+
             auto top = args.get_index<const array_value>(0);
             auto index = args.get_int(1);
             vm.push_stack(get(top->data, index));
         });
-        functions->data["set"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["set"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.get_index<const array_value>(0);
             auto index = args.get_int(1);
             auto input = args.get_index(2);
+            auto unique = args.get_unique_index<array_value>(0);
+            if (unique)
+            {
+                set_in_place(unique->data, index, input);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            auto top = args.get_index<const array_value>(0);
             vm.push_stack(set(top->data, index, input));
-        });
-        functions->data["insert"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        }, true);
+        functions->data["insert"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.get_index<const array_value>(0);
             auto index = args.get_int(1);
             auto input = args.get_index(2);
+            auto unique = args.get_unique_index<array_value>(0);
+            if (unique)
+            {
+                insert_in_place(unique->data, index, input);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            auto top = args.get_index<const array_value>(0);
             vm.push_stack(insert(top->data, index, input));
-        });
-        functions->data["insertFlatten"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        }, true);
+        functions->data["insertFlatten"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.get_index<const array_value>(0);
             auto index = args.get_int(1);
             auto input = args.get_index<const array_value>(2);
+            auto unique = args.get_unique_index<array_value>(0);
+            if (unique)
+            {
+                insert_flatten_in_place(unique->data, index, input->data);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            auto top = args.get_index<const array_value>(0);
             vm.push_stack(insert_flatten(top->data, index, input->data));
-        });
-        functions->data["removeAt"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        }, true);
+        functions->data["removeAt"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.get_index<const array_value>(0);
             auto index = args.get_int(1);
+            auto unique = args.get_unique_index<array_value>(0);
+            if (unique)
+            {
+                remove_at_in_place(unique->data, index);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            auto top = args.get_index<const array_value>(0);
             vm.push_stack(remove_at(top->data, index));
-        });
-        functions->data["remove"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        }, true);
+        functions->data["remove"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index(0);
             auto input = args.get_index(1);
             vm.push_stack(remove(top, input));
         });
-        functions->data["removeAll"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["removeAll"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index(0);
             auto input = args.get_index(1);
             vm.push_stack(remove_all(top, input));
         });
-        functions->data["contains"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["contains"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index<const array_value>(0);
             auto input = args.get_index(1);
             vm.push_stack(contains(top->data, input));
         });
-        functions->data["indexOf"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["indexOf"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index<const array_value>(0);
             auto input = args.get_index(1);
             vm.push_stack(index_of(top->data, input));
         });
-        functions->data["sublist"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["sublist"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index<const array_value>(0);
             auto index = args.get_int(1);
@@ -98,14 +147,7 @@ namespace lysithea_vm
     value standard_array_library::set(const array_vector &target, int index, const value &input)
     {
         array_vector arr(target);
-        if (index < 0)
-        {
-            arr[arr.size() + index] = input;
-        }
-        else
-        {
-            arr[index] = input;
-        }
+        set_in_place(arr, index, input);
         return array_value::make_value(arr);
     }
     value standard_array_library::get(const array_vector &target, int index)
@@ -115,27 +157,51 @@ namespace lysithea_vm
     value standard_array_library::insert(const array_vector &target, int index, const value &input)
     {
         array_vector arr(target);
-        arr.insert(get_iter(arr, index), input);
+        insert_in_place(arr, index, input);
         return array_value::make_value(arr);
     }
     value standard_array_library::insert_flatten(const array_vector &target, int index, const array_vector &input)
     {
         array_vector arr(target);
-        arr.insert(get_iter(arr, index), input.cbegin(), input.cend());
+        insert_flatten_in_place(arr, index, input);
         return array_value::make_value(arr);
     }
     value standard_array_library::remove_at(const array_vector &target, int index)
     {
         array_vector arr(target);
-        arr.erase(get_iter(arr, index));
+        remove_at_in_place(arr, index);
         return array_value::make_value(arr);
     }
+
+    void standard_array_library::set_in_place(array_vector &target, int index, const value &input)
+    {
+        if (index < 0)
+        {
+            target[target.size() + index] = input;
+        }
+        else
+        {
+            target[index] = input;
+        }
+    }
+    void standard_array_library::insert_in_place(array_vector &target, int index, const value &input)
+    {
+        target.insert(get_iter(target, index), input);
+    }
+    void standard_array_library::insert_flatten_in_place(array_vector &target, int index, const array_vector &input)
+    {
+        target.insert(get_iter(target, index), input.cbegin(), input.cend());
+    }
+    void standard_array_library::remove_at_in_place(array_vector &target, int index)
+    {
+        target.erase(get_iter(target, index));
+    }
     value standard_array_library::remove(const value &target, const value &input)
     {
         const auto &arr = target.get_complex<const array_value>()->data;
         for (auto i = 0; i < arr.size(); i++)
         {
-            if (arr[i].compare_to(input) == 0)
+            if (arr[i].equals(input))
             {
                 array_vector result(arr);
                 result.erase(result.begin() + i);
@@ -148,44 +214,36 @@ namespace lysithea_vm
     value standard_array_library::remove_all(const value &target, const value &input)
     {
         const auto &arr = target.get_complex<const array_value>()->data;
-        auto i = 0;
-        auto found_to_remove = false;
-
-        for (; i < arr.size(); i++)
+        auto first = arr.begin();
+        for (; first != arr.end(); ++first)
         {
-            if (arr[i].compare_to(input) == 0)
+            if (first->equals(input))
             {
-                found_to_remove = true;
                 break;
             }
         }
 
-        if (found_to_remove)
+        if (first == arr.end())
         {
-            array_vector result(arr);
-            result.erase(result.begin() + i);
-            auto arr_offset = -1;
-            i++;
+            return target;
+        }
 
-            for (; i < arr.size(); i++)
+        // Everything before the first match is shared, the rest is copied over in one pass.
+        auto result = arr.take(first.index);
+        for (auto iter = first + 1; iter != arr.end(); ++iter)
+        {
+            if (!iter->equals(input))
             {
-                if (arr[i].compare_to(input) == 0)
-                {
-                    result.erase(result.begin() + (i - arr_offset));
-                    arr_offset--;
-                }
+                result.push_back(*iter);
             }
-
-            return array_value::make_value(result);
         }
-
-        return target;
+        return array_value::make_value(result);
     }
     value standard_array_library::contains(const array_vector &target, const value &input)
     {
         for (auto i = 0; i < target.size(); i++)
         {
-            if (target[i].compare_to(input) == 0)
+            if (target[i].equals(input))
             {
                 return lysithea_vm::value(true);
             }
@@ -198,7 +256,7 @@ namespace lysithea_vm
     {
         for (auto i = 0; i < target.size(); i++)
         {
-            if (target[i].compare_to(input) == 0)
+            if (target[i].equals(input))
             {
                 return lysithea_vm::value(i);
             }
@@ -219,6 +277,11 @@ namespace lysithea_vm
             offset = target.size() + index;
         }
 
+        if (offset == 0 && length > 0 && length <= target.size())
+        {
+            return array_value::make_value(target.take(length));
+        }
+
         if (length < 0 || offset + length > target.size())
         {
             array_vector result(target.cbegin() + offset, target.cend());
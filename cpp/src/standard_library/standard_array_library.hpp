@@ -31,6 +31,11 @@ namespace lysithea_vm
             static value index_of(const array_vector &target, const value &value);
             static value sublist(const array_vector &target, int index, int length);
 
+            static void set_in_place(array_vector &target, int index, const value &input);
+            static void insert_in_place(array_vector &target, int index, const value &input);
+            static void insert_flatten_in_place(array_vector &target, int index, const array_vector &input);
+            static void remove_at_in_place(array_vector &target, int index);
+
             inline static array_vector::const_iterator get_iter(const array_vector &value, int index)
             {
                 if (index < 0)
@@ -11,6 +11,7 @@
 namespace lysithea_vm
 {
     std::shared_ptr<const scope> standard_assert_library::library_scope = create_scope();
+    std::atomic<int> standard_assert_library::failures(0);
 
     std::shared_ptr<scope> standard_assert_library::create_scope()
     {
@@ -18,11 +19,12 @@ namespace lysithea_vm
 
         auto functions = std::make_shared<object_value>();
 
-        functions->data["true"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["true"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index(0);
             if (!top.is_true())
             {
+                failures++;
                 vm.running = false;
                 std::cout << "Assert expected true\n";
                 vm.print_stack_trace_debug();
@@ -30,23 +32,25 @@ namespace lysithea_vm
             }
         });
 
-        functions->data["false"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["false"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index(0);
             if (!top.is_false())
             {
+                failures++;
                 vm.running = false;
                 std::cout << "Assert expected false\n";
                 vm.print_stack_trace_debug();
             }
         });
 
-        functions->data["equals"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["equals"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto expected = args.get_index(0);
             auto actual = args.get_index(1);
             if (expected.compare_to(actual) != 0)
             {
+                failures++;
                 vm.running = false;
                 std::cout << "Assert expected equals:"
                     << "\nExpected: " << expected.to_string()
@@ -56,12 +60,13 @@ namespace lysithea_vm
             }
         });
 
-        functions->data["notEquals"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["notEquals"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto expected = args.get_index(0);
             auto actual = args.get_index(1);
             if (expected.compare_to(actual) == 0)
             {
+                failures++;
                 vm.running = false;
                 std::cout << "Assert expected not equals:"
                     << "\nExpected: " << expected.to_string()
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <memory>
+#include <atomic>
 
 namespace lysithea_vm
 {
@@ -12,6 +13,8 @@ namespace lysithea_vm
         public:
             // Fields
             static std::shared_ptr<const scope> library_scope;
+            // How many asserts have failed, so that a test runner can report them in its exit code.
+            static std::atomic<int> failures;
 
             // Methods
             static std::shared_ptr<scope> create_scope();
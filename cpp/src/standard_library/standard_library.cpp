@@ -26,5 +26,13 @@ namespace lysithea_vm
         {
             input.combine_scope(*standard_misc_library::library_scope);
         }
+        if (libraries & standard_library::number_array)
+        {
+            input.combine_scope(*standard_number_array_library::library_scope);
+        }
+        if (libraries & standard_library::set)
+        {
+            input.combine_scope(*standard_set_library::library_scope);
+        }
     }
 } // lysithea_vm
\ No newline at end of file
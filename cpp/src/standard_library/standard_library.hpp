@@ -5,6 +5,8 @@
 #include "standard_array_library.hpp"
 #include "standard_object_library.hpp"
 #include "standard_misc_library.hpp"
+#include "standard_number_array_library.hpp"
+#include "standard_set_library.hpp"
 
 namespace lysithea_vm
 {
@@ -21,7 +23,9 @@ namespace lysithea_vm
                 array = 1 << 2,
                 object = 1 << 3,
                 misc = 1 << 4,
-                all = (1 << 5) - 1
+                number_array = 1 << 5,
+                set = 1 << 6,
+                all = (1 << 7) - 1
             };
 
             // Fields
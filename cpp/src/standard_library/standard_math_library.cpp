@@ -3,7 +3,10 @@
 #include <math.h>
 
 #include "../virtual_machine.hpp"
+#include "../native_binding.hpp"
 #include "../values/object_value.hpp"
+#include "../values/number_array_value.hpp"
+#include "./standard_number_array_library.hpp"
 #include "../utils.hpp"
 #include "../scope.hpp"
 
@@ -23,59 +26,26 @@ namespace lysithea_vm
         functions->data["PI"] = value(M_PI);
         functions->data["DegToRad"] = value(M_DEG_TO_RAD);
 
-        functions->data["sin"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &top = args.get_number(0);
-            vm.push_stack(sin(top));
-        });
-        functions->data["cos"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &top = args.get_number(0);
-            vm.push_stack(cos(top));
-        });
-        functions->data["tan"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &top = args.get_number(0);
-            vm.push_stack(tan(top));
-        });
+        functions->data["sin"] = make_native_binding<double (*)(double), &::sin>();
+        functions->data["cos"] = make_native_binding<double (*)(double), &::cos>();
+        functions->data["tan"] = make_native_binding<double (*)(double), &::tan>();
 
-        functions->data["pow"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &x = args.get_number(0);
-            const auto &y = args.get_number(1);
-            vm.push_stack(pow(x, y));
-        });
-        functions->data["exp"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &x = args.get_number(0);
-            vm.push_stack(exp(x));
-        });
-        functions->data["floor"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &x = args.get_number(0);
-            vm.push_stack(floor(x));
-        });
-        functions->data["ceil"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &x = args.get_number(0);
-            vm.push_stack(ceil(x));
-        });
-        functions->data["round"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &x = args.get_number(0);
-            vm.push_stack(round(x));
-        });
-        functions->data["isNaN"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["pow"] = make_native_binding<double (*)(double, double), &::pow>();
+        functions->data["exp"] = make_native_binding<double (*)(double), &::exp>();
+        functions->data["floor"] = make_native_binding<double (*)(double), &::floor>();
+        functions->data["ceil"] = make_native_binding<double (*)(double), &::ceil>();
+        functions->data["round"] = make_native_binding<double (*)(double), &::round>();
+        functions->data["isNaN"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             const auto &x = args.get_number(0);
             vm.push_stack(std::isnan(x));
         });
-        functions->data["isFinite"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["isFinite"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             const auto &x = args.get_number(0);
             vm.push_stack(std::isfinite(x));
         });
-        functions->data["parse"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["parse"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             const auto &top = args.get_index(0);
             if (top.is_number())
@@ -87,59 +57,64 @@ namespace lysithea_vm
             vm.push_stack(std::stod(top.to_string()));
         });
 
-        functions->data["log"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &x = args.get_number(0);
-            vm.push_stack(log(x));
-        });
-        functions->data["log2"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &x = args.get_number(0);
-            vm.push_stack(log2(x));
-        });
-        functions->data["log10"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &x = args.get_number(0);
-            vm.push_stack(log10(x));
-        });
-        functions->data["abs"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
-            const auto &x = args.get_number(0);
-            vm.push_stack(abs(x));
-        });
+        functions->data["log"] = make_native_binding<double (*)(double), &::log>();
+        functions->data["log2"] = make_native_binding<double (*)(double), &::log2>();
+        functions->data["log10"] = make_native_binding<double (*)(double), &::log10>();
+        functions->data["abs"] = make_native_binding<double (*)(double), &::fabs>();
 
-        functions->data["max"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["max"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto max = args.get_index(0);
-            for (auto iter = args.data.cbegin() + 1; iter != args.data.cend(); ++iter)
+            auto numbers = args.get_index(0).get_complex<const number_array_value>();
+            if (numbers && args.size() == 1)
+            {
+                vm.push_stack(standard_number_array_library::max(numbers->data.data(), numbers->data.size()));
+                return;
+            }
+
+            auto max = args.begin();
+            for (auto iter = args.begin() + 1; iter != args.end(); ++iter)
             {
-                if (iter->compare_to(max) > 0)
+                if (iter->is_number() && max->is_number() ? iter->get_number() > max->get_number() : iter->compare_to(*max) > 0)
                 {
-                    max = *iter;
+                    max = iter;
                 }
             }
 
-            vm.push_stack(max);
+            vm.push_stack(*max);
         });
 
-        functions->data["min"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["min"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto min = args.get_index(0);
-            for (auto iter = args.data.cbegin() + 1; iter != args.data.cend(); ++iter)
+            auto numbers = args.get_index(0).get_complex<const number_array_value>();
+            if (numbers && args.size() == 1)
             {
-                if (iter->compare_to(min) < 0)
+                vm.push_stack(standard_number_array_library::min(numbers->data.data(), numbers->data.size()));
+                return;
+            }
+
+            auto min = args.begin();
+            for (auto iter = args.begin() + 1; iter != args.end(); ++iter)
+            {
+                if (iter->is_number() && min->is_number() ? iter->get_number() < min->get_number() : iter->compare_to(*min) < 0)
                 {
-                    min = *iter;
+                    min = iter;
                 }
             }
 
-            vm.push_stack(min);
+            vm.push_stack(*min);
         });
 
-        functions->data["sum"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["sum"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
+            auto numbers = args.size() == 1 ? args[0].get_complex<const number_array_value>() : nullptr;
+            if (numbers)
+            {
+                vm.push_stack(standard_number_array_library::sum(numbers->data.data(), numbers->data.size()));
+                return;
+            }
+
             auto total = 0.0;
-            for (const auto &iter : args.data)
+            for (const auto &iter : args)
             {
                 if (!iter.is_number())
                 {
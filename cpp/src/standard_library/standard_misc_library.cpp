@@ -17,41 +17,41 @@ namespace lysithea_vm
     {
         auto result = std::make_shared<scope>();
 
-        result->try_define("typeof", [](virtual_machine &vm, const array_value &args) -> void
+        result->try_define("typeof", value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.data[0];
+            auto top = args[0];
             vm.push_stack(top.type_name());
-        });
+        }));
 
-        result->try_define("isDefined", [](virtual_machine &vm, const array_value &args) -> void
+        result->try_define("isDefined", value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.data[0].to_string();
+            auto top = args[0].to_string();
             value temp;
             auto is_defined = vm.current_scope->try_get_key(top, temp);
             vm.push_stack(is_defined);
-        });
+        }));
 
-        result->try_define("toString", [](virtual_machine &vm, const array_value &args) -> void
+        result->try_define("toString", value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.data[0];
+            auto top = args[0];
             vm.push_stack(top.to_string());
-        });
+        }));
 
-        result->try_define("compareTo", [](virtual_machine &vm, const array_value &args) -> void
+        result->try_define("compareTo", value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto left = args.data[0];
-            auto right = args.data[1];
+            auto left = args[0];
+            auto right = args[1];
             vm.push_stack(left.compare_to(right));
-        });
+        }));
 
-        result->try_define("print", [](virtual_machine &vm, const array_value &args) -> void
+        result->try_define("print", value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            for (auto iter : args.data)
+            for (const auto &iter : args)
             {
                 std::cout << iter.to_string();
             }
             std::cout << "\n";
-        });
+        }));
 
         return result;
     }
@@ -0,0 +1,391 @@
+#include "standard_number_array_library.hpp"
+
+#include <math.h>
+#include <stdexcept>
+
+#include "../virtual_machine.hpp"
+#include "../native_binding.hpp"
+#include "../values/object_value.hpp"
+#include "../values/array_value.hpp"
+#include "../values/builtin_function_value.hpp"
+#include "../scope.hpp"
+
+namespace lysithea_vm
+{
+    std::shared_ptr<const scope> standard_number_array_library::library_scope = create_scope();
+
+    std::shared_ptr<scope> standard_number_array_library::create_scope()
+    {
+        auto result = std::make_shared<scope>();
+
+        auto functions = std::make_shared<object_value>();
+        functions->data["create"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            auto length = args.get_int(0);
+            if (length < 0)
+            {
+                throw vm.make_error("Unable to create number array with a negative length: " + std::to_string(length));
+            }
+            auto fill = args.size() > 1 ? args.get_number(1) : 0.0;
+            vm.push_stack(number_array_value::make_value(number_vector(length, fill)));
+        });
+        functions->data["from"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            if (args.size() == 1 && !args[0].is_number())
+            {
+                vm.push_stack(number_array_value::make_value(to_numbers(args[0])));
+                return;
+            }
+
+            number_vector numbers;
+            numbers.reserve(args.size());
+            for (const auto &iter : args)
+            {
+                if (!iter.is_number())
+                {
+                    throw std::runtime_error("Unable to make number array from non number value: " + iter.to_string());
+                }
+                numbers.push_back(iter.get_number());
+            }
+            vm.push_stack(number_array_value::make_value(std::move(numbers)));
+        });
+        functions->data["toArray"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            const auto &top = args.get_index<const number_array_value>(0)->data;
+            array_vector result;
+            for (auto iter : top)
+            {
+                result.push_back(value(iter));
+            }
+            vm.push_stack(array_value::make_value(result));
+        });
+        functions->data["length"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            auto top = args.get_index<const number_array_value>(0);
+            vm.push_stack(top->array_length());
+        });
+        functions->data["get"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            auto top = args.get_index<const number_array_value>(0);
+            value result;
+            if (!top->try_get(args.get_int(1), result))
+            {
+                throw std::out_of_range("Error getting number array at index, out of range");
+            }
+            vm.push_stack(result);
+        });
+        functions->data["set"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            value result;
+            auto &target = get_writable(args, result);
+            auto index = args.get_int(1);
+            if (index < 0)
+            {
+                index += static_cast<int>(target.size());
+            }
+            if (index < 0 || index >= target.size())
+            {
+                throw std::out_of_range("Error setting number array at index, out of range");
+            }
+
+            target[index] = args.get_number(2);
+            vm.push_stack(result);
+        }, true);
+
+        functions->data["sum"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            const auto &top = args.get_index<const number_array_value>(0)->data;
+            vm.push_stack(sum(top.data(), top.size()));
+        });
+        functions->data["min"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            const auto &top = args.get_index<const number_array_value>(0)->data;
+            vm.push_stack(min(top.data(), top.size()));
+        });
+        functions->data["max"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            const auto &top = args.get_index<const number_array_value>(0)->data;
+            vm.push_stack(max(top.data(), top.size()));
+        });
+        functions->data["dot"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            const auto &left = args.get_index<const number_array_value>(0)->data;
+            const auto &right = get_other(left, args.get_index(1));
+            vm.push_stack(dot(left.data(), right.data(), left.size()));
+        });
+
+        functions->data["add"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            value result;
+            add_in_place(get_writable(args, result), args.get_index(1));
+            vm.push_stack(result);
+        }, true);
+        functions->data["multiply"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            value result;
+            multiply_in_place(get_writable(args, result), args.get_index(1));
+            vm.push_stack(result);
+        }, true);
+        functions->data["clamp"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            auto min = args.get_number(1);
+            auto max = args.get_number(2);
+            value result;
+            clamp_in_place(get_writable(args, result), min, max);
+            vm.push_stack(result);
+        }, true);
+        functions->data["map"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            const auto &func = args.get_index(1);
+            if (!func.is_function())
+            {
+                throw std::runtime_error("Number array map requires a function: " + func.to_string());
+            }
+
+            auto unary = find_unary_function(func);
+            auto builtin = func.get_complex<const builtin_function_value>();
+            if (!unary && !(builtin && builtin->uses_args_span))
+            {
+                // Other functions are run by the virtual machine for each number, they could read the array so the result is a new one.
+                const auto &top = args.get_index<const number_array_value>(0)->data;
+                number_vector mapped;
+                mapped.reserve(top.size());
+                for (auto iter : top)
+                {
+                    vm.push_stack(iter);
+                    vm.run_function(*func.get_complex(), 1);
+                    mapped.push_back(vm.pop_stack_number());
+                }
+                vm.push_stack(number_array_value::make_value(std::move(mapped)));
+                return;
+            }
+
+            value result;
+            auto &target = get_writable(args, result);
+            if (unary)
+            {
+                map_in_place(target, unary);
+            }
+            else
+            {
+                for (auto &iter : target)
+                {
+                    value input(iter);
+                    builtin->invoke_native(vm, args_span(&input, 1));
+                    iter = vm.pop_stack_number();
+                }
+            }
+
+            vm.push_stack(result);
+        }, true);
+
+        result->try_define("numberArray", value(functions));
+
+        return result;
+    }
+
+    number_vector standard_number_array_library::to_numbers(const value &input)
+    {
+        auto number_array = input.get_complex<const number_array_value>();
+        if (number_array)
+        {
+            return number_array->data;
+        }
+
+        auto array = input.get_complex<const array_value>();
+        if (!array)
+        {
+            throw std::runtime_error("Unable to make number array from: " + input.to_string());
+        }
+
+        number_vector result;
+        result.reserve(array->data.size());
+        for (const auto &iter : array->data)
+        {
+            if (!iter.is_number())
+            {
+                throw std::runtime_error("Unable to make number array from non number value: " + iter.to_string());
+            }
+            result.push_back(iter.get_number());
+        }
+        return result;
+    }
+
+    standard_number_array_library::unary_function standard_number_array_library::find_unary_function(const value &input)
+    {
+        struct known_function
+        {
+            native_function native;
+            unary_function func;
+        };
+
+        // The math library binds these at compile time, so its builtins can be matched back to the C function.
+        static const known_function known[] = {
+            { &native_binding<unary_function>::call<&::sin>, &::sin },
+            { &native_binding<unary_function>::call<&::cos>, &::cos },
+            { &native_binding<unary_function>::call<&::tan>, &::tan },
+            { &native_binding<unary_function>::call<&::exp>, &::exp },
+            { &native_binding<unary_function>::call<&::floor>, &::floor },
+            { &native_binding<unary_function>::call<&::ceil>, &::ceil },
+            { &native_binding<unary_function>::call<&::round>, &::round },
+            { &native_binding<unary_function>::call<&::log>, &::log },
+            { &native_binding<unary_function>::call<&::log2>, &::log2 },
+            { &native_binding<unary_function>::call<&::log10>, &::log10 },
+            { &native_binding<unary_function>::call<&::fabs>, &::fabs }
+        };
+
+        auto builtin = input.get_complex<const builtin_function_value>();
+        if (!builtin || !builtin->native)
+        {
+            return nullptr;
+        }
+
+        for (const auto &iter : known)
+        {
+            if (iter.native == builtin->native)
+            {
+                return iter.func;
+            }
+        }
+        return nullptr;
+    }
+
+    double standard_number_array_library::sum(const double *input, std::size_t count)
+    {
+        auto result = 0.0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            result += input[i];
+        }
+        return result;
+    }
+
+    double standard_number_array_library::min(const double *input, std::size_t count)
+    {
+        if (count == 0)
+        {
+            throw std::runtime_error("Unable to get the min of an empty number array");
+        }
+
+        auto result = input[0];
+        for (std::size_t i = 1; i < count; i++)
+        {
+            result = input[i] < result ? input[i] : result;
+        }
+        return result;
+    }
+
+    double standard_number_array_library::max(const double *input, std::size_t count)
+    {
+        if (count == 0)
+        {
+            throw std::runtime_error("Unable to get the max of an empty number array");
+        }
+
+        auto result = input[0];
+        for (std::size_t i = 1; i < count; i++)
+        {
+            result = input[i] > result ? input[i] : result;
+        }
+        return result;
+    }
+
+    double standard_number_array_library::dot(const double *left, const double *right, std::size_t count)
+    {
+        auto result = 0.0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            result += left[i] * right[i];
+        }
+        return result;
+    }
+
+    void standard_number_array_library::add_in_place(number_vector &target, const value &input)
+    {
+        auto data = target.data();
+        auto count = target.size();
+        if (input.is_number())
+        {
+            auto number = input.get_number();
+            for (std::size_t i = 0; i < count; i++)
+            {
+                data[i] += number;
+            }
+            return;
+        }
+
+        auto other = get_other(target, input).data();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            data[i] += other[i];
+        }
+    }
+
+    void standard_number_array_library::multiply_in_place(number_vector &target, const value &input)
+    {
+        auto data = target.data();
+        auto count = target.size();
+        if (input.is_number())
+        {
+            auto number = input.get_number();
+            for (std::size_t i = 0; i < count; i++)
+            {
+                data[i] *= number;
+            }
+            return;
+        }
+
+        auto other = get_other(target, input).data();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            data[i] *= other[i];
+        }
+    }
+
+    void standard_number_array_library::clamp_in_place(number_vector &target, double min, double max)
+    {
+        auto data = target.data();
+        auto count = target.size();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            auto clamped = data[i] < min ? min : data[i];
+            data[i] = clamped > max ? max : clamped;
+        }
+    }
+
+    void standard_number_array_library::map_in_place(number_vector &target, unary_function func)
+    {
+        for (auto &iter : target)
+        {
+            iter = func(iter);
+        }
+    }
+
+    number_vector &standard_number_array_library::get_writable(const args_span &args, value &result)
+    {
+        auto unique = args.get_unique_index<number_array_value>(0);
+        if (unique)
+        {
+            result = args[0];
+            return unique->data;
+        }
+
+        auto copy = make_tracked<number_array_value>(args.get_index<const number_array_value>(0)->data);
+        result = value(copy);
+        return copy->data;
+    }
+
+    const number_vector &standard_number_array_library::get_other(const number_vector &target, const value &input)
+    {
+        auto other = input.get_complex<const number_array_value>();
+        if (!other)
+        {
+            throw std::runtime_error("Number array operation expects a number or number array: " + input.to_string());
+        }
+        if (other->data.size() != target.size())
+        {
+            throw std::runtime_error("Number array operation expects arrays of the same length");
+        }
+        return other->data;
+    }
+} // lysithea_vm
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+#include "../values/value.hpp"
+#include "../values/args_span.hpp"
+#include "../values/number_array_value.hpp"
+
+namespace lysithea_vm
+{
+    class scope;
+
+    // Bulk math over number arrays, the loops work on plain doubles so the compiler can vectorise them.
+    class standard_number_array_library
+    {
+        public:
+            using unary_function = double (*)(double);
+
+            // Fields
+            static std::shared_ptr<const scope> library_scope;
+
+            // Methods
+            static std::shared_ptr<scope> create_scope();
+
+            static number_vector to_numbers(const value &input);
+            static unary_function find_unary_function(const value &input);
+
+            static double sum(const double *input, std::size_t count);
+            static double min(const double *input, std::size_t count);
+            static double max(const double *input, std::size_t count);
+            static double dot(const double *left, const double *right, std::size_t count);
+
+            static void add_in_place(number_vector &target, const value &input);
+            static void multiply_in_place(number_vector &target, const value &input);
+            static void clamp_in_place(number_vector &target, double min, double max);
+            static void map_in_place(number_vector &target, unary_function func);
+
+        private:
+            // Constructor
+            standard_number_array_library() { };
+
+            // Methods
+            // Returns the numbers to change, which belong to the first argument itself when nothing else is using it.
+            static number_vector &get_writable(const args_span &args, value &result);
+            static const number_vector &get_other(const number_vector &target, const value &input);
+    };
+} // lysithea_vm
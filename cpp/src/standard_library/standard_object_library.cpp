@@ -7,51 +7,114 @@ namespace lysithea_vm
 {
     std::shared_ptr<const scope> standard_object_library::library_scope = create_scope();
 
+    // Native objects can be read like objects through the members of their class, but they can not be changed.
+    static const complex_value *get_native_object(const args_span &args)
+    {
+        const auto &input = args.get_index(0);
+        if (input.is_complex() && input.data->kind == complex_kind::native_object)
+        {
+            return input.data.get();
+        }
+        return nullptr;
+    }
+
+    static void check_not_native_object(const args_span &args)
+    {
+        if (auto native = get_native_object(args))
+        {
+            throw std::runtime_error("Unable to change a native object: " + native->type_name());
+        }
+    }
+
     std::shared_ptr<scope> standard_object_library::create_scope()
     {
         auto result = std::make_shared<scope>();
 
         auto functions = std::make_shared<object_value>();
-        functions->data["join"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["join"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            vm.push_stack(object_value::join(args));
+            vm.push_stack(object_value::join(array_value(array_vector(args.begin(), args.end()), false)));
         });
-        functions->data["set"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["set"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto obj = args.get_index<const object_value>(0);
+            check_not_native_object(args);
             auto key = args.get_index<const string_value>(1);
             auto value = args.get_index(2);
-            vm.push_stack(set(obj->data, key->data, value));
-        });
-        functions->data["get"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
-        {
+            auto unique = args.get_unique_index<object_value>(0);
+            if (unique)
+            {
+                unique->data.set(key->to_string(), value);
+                vm.push_stack(args[0]);
+                return;
+            }
+
             auto obj = args.get_index<const object_value>(0);
+            vm.push_stack(set(obj->data, key->to_string(), value));
+        }, true);
+        functions->data["get"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
             auto key = args.get_index<const string_value>(1);
-            vm.push_stack(get(obj->data, key->data));
+            if (auto native = get_native_object(args))
+            {
+                value result;
+                vm.push_stack(native->try_get(key->to_string(), result) ? result : value::make_null());
+                return;
+            }
+
+            auto obj = args.get_index<const object_value>(0);
+            vm.push_stack(get(obj->data, key->to_string()));
         });
-        functions->data["keys"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["keys"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
+            if (auto native = get_native_object(args))
+            {
+                vm.push_stack(native_keys(*native));
+                return;
+            }
+
             auto obj = args.get_index<const object_value>(0);
             vm.push_stack(keys(obj->data));
         });
-        functions->data["values"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["values"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
+            if (auto native = get_native_object(args))
+            {
+                vm.push_stack(native_values(*native));
+                return;
+            }
+
             auto obj = args.get_index<const object_value>(0);
             vm.push_stack(values(obj->data));
         });
-        functions->data["length"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["length"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
+            if (auto native = get_native_object(args))
+            {
+                vm.push_stack(native->object_keys().size());
+                return;
+            }
+
             auto obj = args.get_index<const object_value>(0);
             vm.push_stack(obj->data.size());
         });
-        functions->data["removeKey"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["removeKey"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto obj = args.get_index(0);
+            check_not_native_object(args);
             auto key = args.get_index<const string_value>(1);
-            vm.push_stack(removeKey(obj, key->data));
-        });
-        functions->data["removeValues"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+            auto unique = args.get_unique_index<object_value>(0);
+            if (unique)
+            {
+                unique->data.erase(key->to_string());
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            auto obj = args.get_index(0);
+            vm.push_stack(removeKey(obj, key->to_string()));
+        }, true);
+        functions->data["removeValues"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
+            check_not_native_object(args);
             auto obj = args.get_index(0);
             auto values = args.get_index(1);
             vm.push_stack(removeValues(obj, values));
@@ -65,15 +128,15 @@ namespace lysithea_vm
     value standard_object_library::set(const object_map &target, const std::string &key, const value &input)
     {
         object_map obj(target);
-        obj[key] = input;
+        obj.set(key, input);
         return object_value::make_value(obj);
     }
     value standard_object_library::get(const object_map &target, const std::string &key)
     {
-        auto find = target.find(key);
-        if (find != target.end())
+        auto find = target.find_value(key);
+        if (find)
         {
-            return find->second;
+            return *find;
         }
         else
         {
@@ -84,18 +147,40 @@ namespace lysithea_vm
     value standard_object_library::keys(const object_map &target)
     {
         array_vector arr;
-        for (auto iter : target)
+        for (auto iter : object_value::sorted_pairs(target))
         {
-            arr.push_back(iter.first);
+            arr.push_back(iter->first);
         }
         return array_value::make_value(arr);
     }
     value standard_object_library::values(const object_map &target)
     {
         array_vector arr;
-        for (auto iter : target)
+        for (auto iter : object_value::sorted_pairs(target))
+        {
+            arr.push_back(iter->second);
+        }
+        return array_value::make_value(arr);
+    }
+
+    value standard_object_library::native_keys(const complex_value &target)
+    {
+        array_vector arr;
+        for (const auto &key : target.object_keys())
         {
-            arr.push_back(iter.second);
+            arr.push_back(value(key));
+        }
+        return array_value::make_value(arr);
+    }
+
+    value standard_object_library::native_values(const complex_value &target)
+    {
+        array_vector arr;
+        for (const auto &key : target.object_keys())
+        {
+            value result;
+            target.try_get(key, result);
+            arr.push_back(result);
         }
         return array_value::make_value(arr);
     }
@@ -103,32 +188,33 @@ namespace lysithea_vm
     value standard_object_library::removeKey(const value &target, const std::string &key)
     {
         auto obj_target = target.get_complex<const object_value>();
-        auto find = obj_target->data.find(key);
-        if (find == obj_target->data.cend())
+        if (!obj_target->data.contains(key))
         {
             return target;
         }
 
         object_map obj(obj_target->data);
-        obj.erase(obj.find(key));
+        obj.erase(key);
         return object_value::make_value(obj);
     }
 
     value standard_object_library::removeValues(const value &target, const value &input)
     {
         auto obj_target = target.get_complex<const object_value>();
-        object_map obj(obj_target->data);
-        for (auto iter = obj.begin(); iter != obj.end();)
+        std::vector<std::string> remove_keys;
+        for (const auto &iter : obj_target->data)
         {
-            if (iter->second.compare_to(input) == 0)
-            {
-                obj.erase(iter++);
-            }
-            else
+            if (iter.second.equals(input))
             {
-                ++iter;
+                remove_keys.push_back(iter.first);
             }
         }
+
+        object_map obj(obj_target->data);
+        for (const auto &key : remove_keys)
+        {
+            obj.erase(key);
+        }
         return object_value::make_value(obj);
     }
 } // lysithea_vm
\ No newline at end of file
@@ -23,6 +23,8 @@ namespace lysithea_vm
             static value get(const object_map &target, const std::string &key);
             static value keys(const object_map &target);
             static value values(const object_map &target);
+            static value native_keys(const complex_value &target);
+            static value native_values(const complex_value &target);
             static value removeKey(const value &target, const std::string &key);
             static value removeValues(const value &target, const value &input);
 
@@ -0,0 +1,185 @@
+#include "standard_set_library.hpp"
+
+#include "../virtual_machine.hpp"
+#include "../values/object_value.hpp"
+#include "../values/array_value.hpp"
+#include "../scope.hpp"
+
+namespace lysithea_vm
+{
+    std::shared_ptr<const scope> standard_set_library::library_scope = create_scope();
+
+    std::shared_ptr<scope> standard_set_library::create_scope()
+    {
+        auto result = std::make_shared<scope>();
+
+        auto functions = std::make_shared<object_value>();
+        functions->data["join"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            set_map result;
+            for (const auto &iter : args)
+            {
+                result.set(iter, true);
+            }
+            vm.push_stack(set_value::make_value(result));
+        });
+        functions->data["toArray"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            const auto &top = args.get_index<const set_value>(0)->data;
+            array_vector result;
+            for (const auto &iter : top)
+            {
+                result.push_back(iter.first);
+            }
+            vm.push_stack(array_value::make_value(result));
+        });
+        functions->data["length"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            vm.push_stack(args.get_index<const set_value>(0)->data.size());
+        });
+        functions->data["contains"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            auto top = args.get_index<const set_value>(0);
+            vm.push_stack(top->contains(args.get_index(1)));
+        });
+        functions->data["add"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            value result;
+            auto &target = get_writable(args, result);
+            for (auto iter = args.begin() + 1; iter != args.end(); ++iter)
+            {
+                target.set(*iter, true);
+            }
+            vm.push_stack(result);
+        }, true);
+        functions->data["remove"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            value result;
+            auto &target = get_writable(args, result);
+            for (auto iter = args.begin() + 1; iter != args.end(); ++iter)
+            {
+                target.erase(*iter);
+            }
+            vm.push_stack(result);
+        }, true);
+        functions->data["union"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            const auto &input = args.get_index<const set_value>(1)->data;
+            auto unique = args.get_unique_index<set_value>(0);
+            if (unique)
+            {
+                union_in_place(unique->data, input);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            vm.push_stack(set_union(args.get_index<const set_value>(0)->data, input));
+        }, true);
+        functions->data["intersect"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            auto left = args.get_index<const set_value>(0);
+            auto right = args.get_index<const set_value>(1);
+            vm.push_stack(intersect(left->data, right->data));
+        });
+        functions->data["difference"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
+        {
+            const auto &input = args.get_index<const set_value>(1)->data;
+            auto unique = args.get_unique_index<set_value>(0);
+            if (unique)
+            {
+                difference_in_place(unique->data, input);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            vm.push_stack(difference(args.get_index<const set_value>(0)->data, input));
+        }, true);
+
+        result->try_define("set", value(functions));
+
+        return result;
+    }
+
+    value standard_set_library::set_union(const set_map &left, const set_map &right)
+    {
+        // Copying is constant time, so start from the larger set.
+        if (left.size() >= right.size())
+        {
+            set_map result(left);
+            union_in_place(result, right);
+            return set_value::make_value(result);
+        }
+
+        set_map result(right);
+        union_in_place(result, left);
+        return set_value::make_value(result);
+    }
+
+    value standard_set_library::intersect(const set_map &left, const set_map &right)
+    {
+        const auto &smaller = left.size() <= right.size() ? left : right;
+        const auto &larger = left.size() <= right.size() ? right : left;
+
+        set_map result;
+        for (const auto &iter : smaller)
+        {
+            if (larger.contains(iter.first))
+            {
+                result.set(iter.first, true);
+            }
+        }
+        return set_value::make_value(result);
+    }
+
+    value standard_set_library::difference(const set_map &left, const set_map &right)
+    {
+        set_map result(left);
+        difference_in_place(result, right);
+        return set_value::make_value(result);
+    }
+
+    void standard_set_library::union_in_place(set_map &target, const set_map &input)
+    {
+        for (const auto &iter : input)
+        {
+            target.set(iter.first, true);
+        }
+    }
+
+    void standard_set_library::difference_in_place(set_map &target, const set_map &input)
+    {
+        if (input.size() <= target.size())
+        {
+            for (const auto &iter : input)
+            {
+                target.erase(iter.first);
+            }
+            return;
+        }
+
+        // When there is less to look through in the target, only keep what isn't in the input.
+        set_map result;
+        for (const auto &iter : target)
+        {
+            if (!input.contains(iter.first))
+            {
+                result.set(iter.first, true);
+            }
+        }
+        target = result;
+    }
+
+    set_map &standard_set_library::get_writable(const args_span &args, value &result)
+    {
+        auto unique = args.get_unique_index<set_value>(0);
+        if (unique)
+        {
+            result = args[0];
+            return unique->data;
+        }
+
+        auto copy = make_tracked<set_value>(args.get_index<const set_value>(0)->data);
+        result = value(copy);
+        return copy->data;
+    }
+} // lysithea_vm
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+#include "../values/value.hpp"
+#include "../values/args_span.hpp"
+#include "../values/set_value.hpp"
+
+namespace lysithea_vm
+{
+    class scope;
+
+    class standard_set_library
+    {
+        public:
+            // Fields
+            static std::shared_ptr<const scope> library_scope;
+
+            // Methods
+            static std::shared_ptr<scope> create_scope();
+
+            static value set_union(const set_map &left, const set_map &right);
+            static value intersect(const set_map &left, const set_map &right);
+            static value difference(const set_map &left, const set_map &right);
+
+            static void union_in_place(set_map &target, const set_map &input);
+            static void difference_in_place(set_map &target, const set_map &input);
+
+        private:
+            // Constructor
+            standard_set_library() { };
+
+            // Methods
+            // Returns the values to change, which belong to the first argument itself when nothing else is using it.
+            static set_map &get_writable(const args_span &args, value &result);
+    };
+} // lysithea_vm
@@ -16,54 +16,86 @@ namespace lysithea_vm
         auto result = std::make_shared<scope>();
 
         auto functions = std::make_shared<object_value>();
-        functions->data["length"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["length"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index<string_value>(0);
             vm.push_stack(top->data.size());
         });
-        functions->data["get"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["get"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index(0).to_string();
             auto index = args.get_int(1);
             vm.push_stack(get(top, index));
         });
-        functions->data["set"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["set"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.get_index(0).to_string();
             auto index = args.get_int(1);
             auto value = args.get_index(2).to_string();
+            auto unique = args.get_unique_index<string_value>(0);
+            if (unique)
+            {
+                set_in_place(unique->data, index, value);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            auto top = args.get_index(0).to_string();
             vm.push_stack(set(top, index, value));
-        });
-        functions->data["insert"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        }, true);
+        functions->data["insert"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.get_index(0).to_string();
             auto index = args.get_int(1);
             auto value = args.get_index(2).to_string();
+            auto unique = args.get_unique_index<string_value>(0);
+            if (unique)
+            {
+                insert_in_place(unique->data, index, value);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            auto top = args.get_index(0).to_string();
             vm.push_stack(insert(top, index, value));
-        });
-        functions->data["substring"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        }, true);
+        functions->data["substring"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto top = args.get_index(0).to_string();
             auto index = args.get_int(1);
             auto length = args.get_int(2);
             vm.push_stack(substring(top, index, length));
         });
-        functions->data["removeAt"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        functions->data["removeAt"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.get_index(0).to_string();
             auto index = args.get_int(1);
+            auto unique = args.get_unique_index<string_value>(0);
+            if (unique)
+            {
+                remove_at_in_place(unique->data, index);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            auto top = args.get_index(0).to_string();
             vm.push_stack(remove_at(top, index));
-        });
-        functions->data["removeAll"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        }, true);
+        functions->data["removeAll"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
-            auto top = args.get_index(0).to_string();
             auto values = args.get_index(1).to_string();
+            auto unique = args.get_unique_index<string_value>(0);
+            if (unique)
+            {
+                remove_all_in_place(unique->data, values);
+                vm.push_stack(args[0]);
+                return;
+            }
+
+            auto top = args.get_index(0).to_string();
             vm.push_stack(remove_all(top, values));
-        });
-        functions->data["join"] = value::make_builtin([](virtual_machine &vm, const array_value &args) -> void
+        }, true);
+        functions->data["join"] = value::make_native([](virtual_machine &vm, const args_span &args) -> void
         {
             auto separator = args.get_index(0).to_string();
-            vm.push_stack(join(separator, args.data.cbegin() + 1, args.data.cend()));
+            vm.push_stack(join(separator, args.begin() + 1, args.end()));
         });
 
         result->try_define("string", value(functions));
@@ -74,19 +106,19 @@ namespace lysithea_vm
     value standard_string_library::get(const std::string &target, int index)
     {
         auto ch = target[get_index(target, index)];
-        return value(std::make_shared<string_value>(std::string(ch, 1)));
+        return value(string_value::single_char(ch));
     }
     value standard_string_library::set(const std::string &target, int index, const std::string &input)
     {
-        std::stringstream ss;
-        index = get_index(target, index);
-        ss << target.substr(0, index) << input << target.substr(index + 1);
-        return value(ss.str());
+        auto copy = make_tracked<string_value>(target);
+        set_in_place(copy->data, index, input);
+        return value(copy);
     }
     value standard_string_library::insert(const std::string &target, int index, const std::string &input)
     {
-        std::string copy(target);
-        return value(copy.insert(get_index(target, index), input));
+        auto copy = make_tracked<string_value>(target);
+        insert_in_place(copy->data, index, input);
+        return value(copy);
     }
     value standard_string_library::substring(const std::string &target, int index, int length)
     {
@@ -94,23 +126,40 @@ namespace lysithea_vm
     }
     value standard_string_library::remove_at(const std::string &target, int index)
     {
-        std::string copy(target);
-        copy.erase(get_index(target, index), 1);
-        return copy;
+        auto copy = make_tracked<string_value>(target);
+        remove_at_in_place(copy->data, index);
+        return value(copy);
     }
     value standard_string_library::remove_all(const std::string &target, const std::string &values)
     {
-        std::string copy(target);
-        auto i = copy.find(values);
-        while (i != std::string::npos)
+        auto copy = make_tracked<string_value>(target);
+        remove_all_in_place(copy->data, values);
+        return value(copy);
+    }
+
+    void standard_string_library::set_in_place(tracked_string &target, int index, const std::string &input)
+    {
+        target.replace(get_index(target, index), 1, input.data(), input.size());
+    }
+    void standard_string_library::insert_in_place(tracked_string &target, int index, const std::string &input)
+    {
+        target.insert(get_index(target, index), input.data(), input.size());
+    }
+    void standard_string_library::remove_at_in_place(tracked_string &target, int index)
+    {
+        target.erase(get_index(target, index), 1);
+    }
+    void standard_string_library::remove_all_in_place(tracked_string &target, const std::string &values)
+    {
+        auto i = target.find(values.data(), 0, values.size());
+        while (i != tracked_string::npos)
         {
-            copy.erase(i, values.length());
-            i = copy.find(values, i);
+            target.erase(i, values.length());
+            i = target.find(values.data(), i, values.size());
         }
-        return copy;
     }
 
-    value standard_string_library::join(const std::string &separator, const std::vector<value>::const_iterator begin, const std::vector<value>::const_iterator end)
+    value standard_string_library::join(const std::string &separator, const value *begin, const value *end)
     {
         auto first = true;
         std::stringstream ss;
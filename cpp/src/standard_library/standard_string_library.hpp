@@ -3,6 +3,8 @@
 #include <string>
 #include <memory>
 #include "../values/value.hpp"
+#include "../values/array_value.hpp"
+#include "../values/string_value.hpp"
 
 namespace lysithea_vm
 {
@@ -24,9 +26,15 @@ namespace lysithea_vm
             static value substring(const std::string &target, int index, int length);
             static value remove_at(const std::string &target, int index);
             static value remove_all(const std::string &target, const std::string &values);
-            static value join(const std::string &separator, const std::vector<value>::const_iterator begin, const std::vector<value>::const_iterator end);
+            static value join(const std::string &separator, const value *begin, const value *end);
 
-            inline static int get_index(const std::string &input, int index)
+            static void set_in_place(tracked_string &target, int index, const std::string &input);
+            static void insert_in_place(tracked_string &target, int index, const std::string &input);
+            static void remove_at_in_place(tracked_string &target, int index);
+            static void remove_all_in_place(tracked_string &target, const std::string &values);
+
+            template <typename String>
+            inline static int get_index(const String &input, int index)
             {
                 if (index < 0)
                 {
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+
+#include "memory_tracker.hpp"
+
+namespace lysithea_vm
+{
+    // Counts its allocations against the memory tracker that was current when the allocator was made.
+    // Without a current tracker it is the same as std::allocator.
+    template <typename T>
+    class tracking_allocator
+    {
+        public:
+            using value_type = T;
+            using propagate_on_container_move_assignment = std::true_type;
+            using propagate_on_container_swap = std::true_type;
+
+            // Fields
+            memory_tracker *tracker;
+
+            // Constructor
+            tracking_allocator() : tracker(memory_tracker::current()) { }
+            tracking_allocator(memory_tracker *tracker) : tracker(tracker) { }
+            template <typename U>
+            tracking_allocator(const tracking_allocator<U> &input) : tracker(input.tracker) { }
+
+            // Methods
+            inline T *allocate(std::size_t count)
+            {
+                auto size = count * sizeof(T);
+                return static_cast<T *>(tracker ? tracker->allocate(size) : ::operator new(size));
+            }
+
+            inline void deallocate(T *ptr, std::size_t count)
+            {
+                if (tracker)
+                {
+                    tracker->deallocate(ptr, count * sizeof(T));
+                }
+                else
+                {
+                    ::operator delete(ptr);
+                }
+            }
+
+            // A copied container belongs to whichever tracker is current, not the one it was copied from.
+            inline tracking_allocator select_on_container_copy_construction() const
+            {
+                return tracking_allocator();
+            }
+
+            template <typename U>
+            struct rebind
+            {
+                using other = tracking_allocator<U>;
+            };
+
+            template <typename U>
+            inline bool operator==(const tracking_allocator<U> &input) const { return tracker == input.tracker; }
+            template <typename U>
+            inline bool operator!=(const tracking_allocator<U> &input) const { return tracker != input.tracker; }
+    };
+
+    // Used instead of std::make_shared for anything made while a script runs, so that it is counted by the virtual machine.
+    template <typename T, typename... Args>
+    inline std::shared_ptr<T> make_tracked(Args&&... args)
+    {
+        return std::allocate_shared<T>(tracking_allocator<T>(), std::forward<Args>(args)...);
+    }
+} // lysithea_vm
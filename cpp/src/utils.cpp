@@ -1,6 +1,7 @@
 #include "utils.hpp"
 
 #include <algorithm>
+#include <cstdio>
 
 namespace lysithea_vm
 {
@@ -10,9 +11,11 @@ namespace lysithea_vm
         {
             case vm_operator::call: return "call";
             case vm_operator::call_direct: return "callDirect";
+            case vm_operator::tail_call: return "tailCall";
             case vm_operator::call_return: return "return";
             case vm_operator::define: return "define";
             case vm_operator::get: return "get";
+            case vm_operator::get_move: return "getMove";
             case vm_operator::get_property: return "getProperty";
             case vm_operator::jump: return "jump";
             case vm_operator::jump_false: return "jumpFalse";
@@ -20,6 +23,9 @@ namespace lysithea_vm
             case vm_operator::push: return "push";
             case vm_operator::set: return "set";
             case vm_operator::to_argument: return "toArgument";
+            case vm_operator::get_upvalue: return "getUpvalue";
+            case vm_operator::set_upvalue: return "setUpvalue";
+            case vm_operator::make_closure: return "makeClosure";
 
             case vm_operator::string_concat: return "$";
 
@@ -46,20 +52,6 @@ namespace lysithea_vm
         return "unknown";
     }
 
-    int compare(double v1, double v2)
-    {
-        auto diff = v1 - v2;
-        if (std::abs(diff) < 0.0001)
-        {
-            return 0;
-        }
-        if (diff < 0.0)
-        {
-            return -1;
-        }
-        return 1;
-    }
-
     int compare(int v1, int v2)
     {
         auto diff = v1 - v2;
@@ -90,6 +82,14 @@ namespace lysithea_vm
         return 1;
     }
 
+    void append_number(std::string &target, double input)
+    {
+        // Same output as writing the number to a default stream but without creating one.
+        char buffer[32];
+        auto length = std::snprintf(buffer, sizeof(buffer), "%g", input);
+        target.append(buffer, length);
+    }
+
     bool starts_with_unpack(const std::string &input)
     {
         return input.length() > 3 && input[0] == '.' && input[1] == '.' && input[2] == '.';
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <cctype>
+#include <cmath>
 #include <vector>
 
 #include "operator.hpp"
@@ -11,13 +12,34 @@ namespace lysithea_vm
     vm_operator parse_operator(const std::string &input);
     std::string to_string(vm_operator input);
 
-    int compare(double v1, double v2);
+    // Inline so that the number versions of the comparison operators don't need a call.
+    inline int compare(double v1, double v2)
+    {
+        auto diff = v1 - v2;
+        if (std::abs(diff) < 0.0001)
+        {
+            return 0;
+        }
+        if (diff < 0.0)
+        {
+            return -1;
+        }
+        return 1;
+    }
+
     int compare(int v1, int v2);
     int compare(std::size_t v1, std::size_t v2);
 
+    void append_number(std::string &target, double input);
+
     bool starts_with_unpack(const std::string &input);
     std::vector<std::string> string_split(const std::string &input, const std::string &delimiter);
 
+    inline std::size_t hash_combine(std::size_t seed, std::size_t input)
+    {
+        return seed ^ (input + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+    }
+
     template <typename T>
     inline void push_range(std::vector<T> &target, const std::vector<T> &input)
     {
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <typeinfo>
+
+#include "./value.hpp"
+
+namespace lysithea_vm
+{
+    // A view of the arguments for a native function, usually the top of the operand stack.
+    // Only valid for the duration of the call.
+    class args_span
+    {
+        public:
+            // Fields
+            const value *data;
+            int count;
+
+            // Constructor
+            args_span(const value *data, int count) : data(data), count(count) { }
+
+            // Methods
+            inline int size() const { return count; }
+            inline const value *begin() const { return data; }
+            inline const value *end() const { return data + count; }
+            inline const value &operator[](int index) const { return data[index]; }
+
+            template <typename T>
+            inline std::shared_ptr<T> get_index(int index) const
+            {
+                auto casted = get_index(index).get_complex<T>();
+                if (!casted)
+                {
+                    throw std::bad_cast();
+                }
+
+                return casted;
+            }
+
+            template <typename T>
+            inline T *get_unique_index(int index) const
+            {
+                return get_index(index).get_unique_complex<T>();
+            }
+
+            inline bool get_bool(int index) const
+            {
+                const auto &result = get_index(index);
+                if (result.is_bool())
+                {
+                    return result.get_bool();
+                }
+                throw std::bad_cast();
+            }
+
+            inline double get_number(int index) const
+            {
+                const auto &result = get_index(index);
+                if (result.is_number())
+                {
+                    return result.get_number();
+                }
+                throw std::bad_cast();
+            }
+
+            inline int get_int(int index) const
+            {
+                const auto &result = get_index(index);
+                if (result.is_number())
+                {
+                    return result.get_int();
+                }
+                throw std::bad_cast();
+            }
+
+            inline const value &get_index(int index) const
+            {
+                if (index < 0)
+                {
+                    index += count;
+                }
+
+                if (index < 0 || index >= count)
+                {
+                    throw std::out_of_range("Error getting argument at index, out of range");
+                }
+
+                return data[index];
+            }
+    };
+} // lysithea_vm
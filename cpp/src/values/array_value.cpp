@@ -14,7 +14,7 @@ namespace lysithea_vm
 
     int array_value::compare_to(const complex_value *input) const
     {
-        auto other = dynamic_cast<const array_value *>(input);
+        auto other = complex_cast<const array_value>(input);
         if (!other)
         {
             return 1;
@@ -40,6 +40,34 @@ namespace lysithea_vm
         return 0;
     }
 
+    bool array_value::exactly_equals(const complex_value *input) const
+    {
+        auto other = complex_cast<const array_value>(input);
+        if (!other || other->data.size() != data.size())
+        {
+            return false;
+        }
+
+        for (auto i = 0; i < data.size(); i++)
+        {
+            if (!data[i].exactly_equals(other->data[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::size_t array_value::get_hash() const
+    {
+        std::size_t result = data.size();
+        for (const auto &iter : data)
+        {
+            result = hash_combine(result, iter.get_hash());
+        }
+        return result;
+    }
+
     bool array_value::try_get(const std::string &key, lysithea_vm::value &result) const
     {
         if (key == "length")
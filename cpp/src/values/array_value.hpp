@@ -7,15 +7,17 @@
 
 #include "./complex_value.hpp"
 #include "./value.hpp"
+#include "../persistent_vector.hpp"
 
 namespace lysithea_vm
 {
-    using array_vector = std::vector<value>;
+    using array_vector = persistent_vector<value>;
 
     class array_value : public complex_value
     {
         public:
             // Fields
+            static const complex_kind kind_tag = complex_kind::array;
             static value empty;
 
             array_vector data;
@@ -23,10 +25,10 @@ namespace lysithea_vm
 
             // Constructor
             array_value(bool is_arguments_value)
-                : is_arguments_value(is_arguments_value) {
+                : complex_value(kind_tag), is_arguments_value(is_arguments_value) {
             }
             array_value(const array_vector &value, bool is_arguments_value)
-                : data(value), is_arguments_value(is_arguments_value) { }
+                : complex_value(kind_tag), data(value), is_arguments_value(is_arguments_value) { }
 
             virtual ~array_value() { }
 
@@ -40,7 +42,7 @@ namespace lysithea_vm
                     throw std::out_of_range("Error getting array at index, out of range");
                 }
 
-                auto casted = std::dynamic_pointer_cast<T>(data[index].get_complex());
+                auto casted = data[index].get_complex<T>();
                 if (!casted)
                 {
                     throw std::bad_cast();
@@ -49,6 +51,18 @@ namespace lysithea_vm
                 return casted;
             }
 
+            template <typename T>
+            inline T *get_unique_index(int index) const
+            {
+                index = calc_index(index);
+                if (index < 0 || index >= data.size())
+                {
+                    throw std::out_of_range("Error getting array at index, out of range");
+                }
+
+                return data[index].get_unique_complex<T>();
+            }
+
             inline bool get_bool(int index) const
             {
                 auto result = get_index(index);
@@ -92,11 +106,13 @@ namespace lysithea_vm
 
             static inline lysithea_vm::value make_value(const array_vector &input, bool is_argument_value = false)
             {
-                return lysithea_vm::value(std::make_shared<array_value>(input, is_argument_value));
+                return lysithea_vm::value(make_tracked<array_value>(input, is_argument_value));
             }
 
             // Value Methods
             virtual int compare_to(const complex_value *input) const;
+            virtual std::size_t get_hash() const;
+            virtual bool exactly_equals(const complex_value *input) const;
             virtual std::string to_string() const;
             virtual std::string type_name() const
             {
@@ -104,7 +120,6 @@ namespace lysithea_vm
             }
 
             // Array methods
-            virtual bool is_array() const { return true; }
             virtual int array_length() const { return static_cast<int>(data.size()); }
 
             virtual bool try_get(int index, lysithea_vm::value &result) const
@@ -1,7 +0,0 @@
-#include "bool_value.hpp"
-
-namespace lysithea_vm
-{
-    const bool_value bool_value::True(true);
-    const bool_value bool_value::False(false);
-} // lysithea_vm
\ No newline at end of file
@@ -0,0 +1,23 @@
+#include "builtin_function_value.hpp"
+
+#include <vector>
+
+#include "../virtual_machine.hpp"
+#include "./array_value.hpp"
+#include "./args_span.hpp"
+
+namespace lysithea_vm
+{
+    void builtin_function_value::invoke(virtual_machine &vm, std::shared_ptr<const array_value> args, bool push_to_stack_trace) const
+    {
+        if (uses_args_span)
+        {
+            // The array isn't stored in one block so the arguments are copied out for the span.
+            std::vector<value> native_args(args->data.cbegin(), args->data.cend());
+            invoke_native(vm, args_span(native_args.data(), static_cast<int>(native_args.size())));
+            return;
+        }
+
+        data(vm, *args);
+    }
+} // lysithea_vm
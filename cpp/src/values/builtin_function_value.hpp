@@ -8,37 +8,66 @@
 namespace lysithea_vm
 {
     class virtual_machine;
+    class args_span;
 
     using builtin_function_callback = std::function<void (virtual_machine &, const array_value &)>;
+    // Native functions are given their arguments in place on the stack instead of being copied into an array.
+    using native_function = void (*)(virtual_machine &, const args_span &);
 
     class builtin_function_value : public complex_value
     {
         public:
             // Fields
+            static const complex_kind kind_tag = complex_kind::builtin_function;
+
             builtin_function_callback data;
+            native_function native;
+            // When true the arguments are passed as an args_span to invoke_native instead of as an array.
+            bool uses_args_span;
+            // When true the function returns its first argument changed in place if nothing else holds a reference to it.
+            bool can_update_in_place;
 
             // Constructor
-            builtin_function_value(builtin_function_callback data) : data(data) { }
+            builtin_function_value(builtin_function_callback data) : complex_value(kind_tag), data(data), native(nullptr), uses_args_span(false), can_update_in_place(false) { }
+            builtin_function_value(builtin_function_callback data, bool can_update_in_place) : complex_value(kind_tag), data(data), native(nullptr), uses_args_span(false), can_update_in_place(can_update_in_place) { }
+            builtin_function_value(native_function native, bool can_update_in_place) : complex_value(kind_tag), native(native), uses_args_span(true), can_update_in_place(can_update_in_place) { }
 
             // Methods
             virtual int compare_to(const complex_value *input) const
             {
-                auto other = dynamic_cast<const builtin_function_value *>(input);
+                auto other = complex_cast<const builtin_function_value>(input);
                 if (!other)
                 {
                     return 1;
                 }
 
+                if (native || other->native)
+                {
+                    return native == other->native ? 0 : 1;
+                }
+
+                if (uses_args_span || other->uses_args_span)
+                {
+                    return this == other ? 0 : 1;
+                }
+
                 return &data == &(other->data) ? 0 : 1;
             }
 
+            virtual std::size_t get_hash() const
+            {
+                return native ? std::hash<const void *>()(reinterpret_cast<const void *>(native)) : std::hash<const void *>()(this);
+            }
+
             virtual std::string to_string() const { return "builtin-function"; }
             virtual std::string type_name() const { return "builtin-function"; }
-            virtual bool is_function() const { return true; }
 
-            virtual void invoke(virtual_machine &vm, std::shared_ptr<const array_value> args, bool push_to_stack_trace) const
+            virtual void invoke(virtual_machine &vm, std::shared_ptr<const array_value> args, bool push_to_stack_trace) const;
+
+            // Overridden by functions that carry their own state, such as bound C++ callables.
+            virtual void invoke_native(virtual_machine &vm, const args_span &args) const
             {
-                data(vm, *args);
+                native(vm, args);
             }
     };
 } // lysithea_vm
\ No newline at end of file
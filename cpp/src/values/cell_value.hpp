@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "./complex_value.hpp"
+#include "./value.hpp"
+#include "../tracking_allocator.hpp"
+
+namespace lysithea_vm
+{
+    // Holds a variable that has been captured by a closure.
+    //
+    // The scope that defined the variable keeps the cell in place of the value, so reading and writing by name and
+    // through the closure's upvalues see the same variable. Scopes unwrap cells so they are never pushed onto the stack.
+    class cell_value : public complex_value
+    {
+        public:
+            // Fields
+            static const complex_kind kind_tag = complex_kind::cell;
+
+            value data;
+            // The virtual machine that is allowed to change this cell in place, the same as a scope's owner.
+            std::uint64_t owner;
+
+            // Constructor
+            cell_value(value data, std::uint64_t owner) : complex_value(kind_tag), data(std::move(data)), owner(owner) { }
+
+            // Methods
+            virtual int compare_to(const complex_value *input) const
+            {
+                return input == this ? 0 : 1;
+            }
+
+            virtual std::string to_string() const { return data.to_string(); }
+            virtual std::string type_name() const { return "cell"; }
+
+            virtual void visit_values(const std::function<void (const std::shared_ptr<complex_value> &)> &callback) const
+            {
+                if (data.is_complex())
+                {
+                    callback(data.data);
+                }
+            }
+    };
+
+    // The cells captured by a closure in the order of its function's captures, an undefined entry is looked up by name instead.
+    using upvalue_list = std::vector<value, tracking_allocator<value>>;
+
+} // lysithea_vm
@@ -4,24 +4,42 @@
 #include <vector>
 #include <memory>
 #include <stdexcept>
+#include <type_traits>
+#include <functional>
 
 namespace lysithea_vm
 {
     class value;
     class virtual_machine;
     class array_value;
+    class scope;
+
+    // Tags each kind of complex value so that checking the type doesn't need RTTI.
+    enum class complex_kind
+    {
+        string, variable, array, object, function, builtin_function, native_object, number_array, set, cell
+    };
 
     class complex_value
     {
         public:
+            // Fields
+            const complex_kind kind;
+
             // Constructor
+            complex_value(complex_kind kind) : kind(kind) { }
             virtual ~complex_value() { }
 
             // Methods
             virtual int compare_to(const complex_value *input) const = 0;
             virtual std::string to_string() const = 0;
             virtual std::string type_name() const = 0;
-            virtual bool is_string() const { return false; }
+            inline bool is_string() const { return kind == complex_kind::string; }
+
+            // Values that are exactly equal must have the same hash, the default suits types that are only equal to themselves.
+            virtual std::size_t get_hash() const { return std::hash<const void *>()(this); }
+            // Like compare_to giving 0 but numbers have to match exactly, used by hashed containers where numbers are hashed exactly.
+            virtual bool exactly_equals(const complex_value *input) const { return compare_to(input) == 0; }
 
             // Boolean methods
             virtual bool is_true() const { return false; }
@@ -37,19 +55,46 @@ namespace lysithea_vm
             virtual bool try_get(const std::string &key, value &result) const { return false; }
 
             // Array methods
-            virtual bool is_array() const { return false; }
+            inline bool is_array() const { return kind == complex_kind::array; }
+            inline bool is_number_array() const { return kind == complex_kind::number_array; }
             virtual int array_length() const { return 0; }
             virtual bool try_get(int index, value &result) const { return false; }
 
             // Function methods
-            virtual bool is_function() const { return false; }
+            inline bool is_function() const { return kind == complex_kind::function || kind == complex_kind::builtin_function; }
             virtual void invoke(virtual_machine &vm, std::shared_ptr<const array_value> args, bool push_to_stack_trace) const
             {
                 throw std::runtime_error("Attempting to invoke a function that does not override the invoke method");
             }
 
+            // Lets the cycle collector follow any scopes that this value keeps alive.
+            virtual void visit_scopes(const std::function<void (const std::shared_ptr<scope> &)> &callback) const { }
+            // Lets the cycle collector follow the values that this value keeps alive, eg: the cells captured by a closure.
+            virtual void visit_values(const std::function<void (const std::shared_ptr<complex_value> &)> &callback) const { }
+
         private:
             // Fields
             static const std::vector<std::string> empty_object_keys;
     };
+
+    // Casts to the given complex value type when the kind matches, otherwise returns null.
+    template <typename T, typename U>
+    inline T *complex_cast(U *input)
+    {
+        if (input && input->kind == std::remove_const<T>::type::kind_tag)
+        {
+            return static_cast<T *>(input);
+        }
+        return nullptr;
+    }
+
+    template <typename T>
+    inline std::shared_ptr<T> complex_pointer_cast(const std::shared_ptr<complex_value> &input)
+    {
+        if (input && input->kind == std::remove_const<T>::type::kind_tag)
+        {
+            return std::static_pointer_cast<T>(input);
+        }
+        return nullptr;
+    }
 } // lysithea_vm
\ No newline at end of file
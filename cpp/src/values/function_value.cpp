@@ -7,6 +7,6 @@ namespace lysithea_vm
 {
     void function_value::invoke(virtual_machine &vm, std::shared_ptr<const array_value> args, bool push_to_stack_trace) const
     {
-        vm.execute_function(data, args, push_to_stack_trace);
+        vm.execute_function(data, args, push_to_stack_trace, captures.empty() ? nullptr : &captures);
     }
 } // lysithea_vm
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <memory>
 #include <string>
 #include "./complex_value.hpp"
+#include "./cell_value.hpp"
 #include "../function.hpp"
 
 namespace lysithea_vm
@@ -13,29 +14,59 @@ namespace lysithea_vm
     {
         public:
             // Fields
+            static const complex_kind kind_tag = complex_kind::function;
+
             function_ptr data;
+            // Only set for closures made by make_closure.
+            upvalue_list captures;
 
             // Constructor
-            function_value(function_ptr data) : data(data) { }
-            function_value(function data) : data(std::make_shared<function>(data)) { }
+            function_value(function_ptr data) : complex_value(kind_tag), data(data) { }
+            function_value(function_ptr data, upvalue_list captures) : complex_value(kind_tag), data(data), captures(std::move(captures)) { }
+            function_value(function data) : complex_value(kind_tag), data(std::make_shared<function>(data)) { }
 
             // Methods
             virtual int compare_to(const complex_value *input) const
             {
-                auto other = dynamic_cast<const function_value *>(input);
+                auto other = complex_cast<const function_value>(input);
                 if (!other)
                 {
                     return 1;
                 }
 
-                return data.get() == other->data.get() ? 0 : 1;
+                if (data.get() != other->data.get() || captures.size() != other->captures.size())
+                {
+                    return 1;
+                }
+
+                // Closures of the same function are only the same when they captured the same variables.
+                for (auto i = 0; i < captures.size(); i++)
+                {
+                    if (captures[i].data.get() != other->captures[i].data.get())
+                    {
+                        return 1;
+                    }
+                }
+                return 0;
             }
 
+            virtual std::size_t get_hash() const { return std::hash<const void *>()(data.get()); }
+
             virtual std::string to_string() const { return "function:" + data->name; }
             virtual std::string type_name() const { return "function"; }
-            virtual bool is_function() const { return true; }
 
             virtual void invoke(virtual_machine &vm, std::shared_ptr<const array_value> args, bool push_to_stack_trace) const;
+
+            virtual void visit_values(const std::function<void (const std::shared_ptr<complex_value> &)> &callback) const
+            {
+                for (const auto &iter : captures)
+                {
+                    if (iter.is_complex())
+                    {
+                        callback(iter.data);
+                    }
+                }
+            }
     };
 
 } // lysithea_vm
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "number_array_value.hpp"
+
+#include "../utils.hpp"
+
+namespace lysithea_vm
+{
+    int number_array_value::compare_to(const complex_value *input) const
+    {
+        auto other = complex_cast<const number_array_value>(input);
+        if (!other)
+        {
+            return 1;
+        }
+
+        auto compare_length = compare(data.size(), other->data.size());
+        if (compare_length != 0)
+        {
+            return compare_length;
+        }
+
+        for (std::size_t i = 0; i < data.size(); i++)
+        {
+            auto compare_value = compare(data[i], other->data[i]);
+            if (compare_value != 0)
+            {
+                return compare_value;
+            }
+        }
+
+        return 0;
+    }
+
+    bool number_array_value::exactly_equals(const complex_value *input) const
+    {
+        auto other = complex_cast<const number_array_value>(input);
+        if (!other || other->data.size() != data.size())
+        {
+            return false;
+        }
+
+        for (std::size_t i = 0; i < data.size(); i++)
+        {
+            if (!value(data[i]).exactly_equals(value(other->data[i])))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::size_t number_array_value::get_hash() const
+    {
+        std::size_t result = data.size();
+        for (auto iter : data)
+        {
+            result = hash_combine(result, value(iter).get_hash());
+        }
+        return result;
+    }
+
+    bool number_array_value::try_get(const std::string &key, value &result) const
+    {
+        if (key == "length")
+        {
+            result = value(data.size());
+            return true;
+        }
+
+        return false;
+    }
+
+    std::string number_array_value::to_string() const
+    {
+        std::string result("(");
+        for (std::size_t i = 0; i < data.size(); i++)
+        {
+            if (i > 0)
+            {
+                result += ' ';
+            }
+            append_number(result, data[i]);
+        }
+        result += ')';
+        return result;
+    }
+} // lysithea_vm
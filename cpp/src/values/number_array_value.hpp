@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+
+#include "./complex_value.hpp"
+#include "./value.hpp"
+#include "../tracking_allocator.hpp"
+
+namespace lysithea_vm
+{
+    // The numbers of arrays made while a script runs are counted by its virtual machine's memory tracker.
+    using number_vector = std::vector<double, tracking_allocator<double>>;
+
+    // An array of numbers stored next to each other, used for bulk math without boxing each number in a value.
+    // Indexing it returns a regular number value so it can be read like any other array.
+    class number_array_value : public complex_value
+    {
+        public:
+            // Fields
+            static const complex_kind kind_tag = complex_kind::number_array;
+
+            number_vector data;
+
+            // Constructor
+            number_array_value() : complex_value(kind_tag) { }
+            number_array_value(const number_vector &data) : complex_value(kind_tag), data(data) { }
+            number_array_value(number_vector &&data) : complex_value(kind_tag), data(std::move(data)) { }
+
+            // Value Methods
+            virtual int compare_to(const complex_value *input) const;
+            virtual std::size_t get_hash() const;
+            virtual bool exactly_equals(const complex_value *input) const;
+            virtual std::string to_string() const;
+            virtual std::string type_name() const { return "numberArray"; }
+
+            // Array methods
+            virtual int array_length() const { return static_cast<int>(data.size()); }
+
+            virtual bool try_get(int index, value &result) const
+            {
+                index = calc_index(index);
+                if (index < 0 || index >= data.size())
+                {
+                    return false;
+                }
+
+                result = value(data[index]);
+                return true;
+            }
+
+            inline int calc_index(int index) const
+            {
+                if (index < 0)
+                {
+                    return static_cast<int>(data.size()) + index;
+                }
+
+                return index;
+            }
+
+            // Object methods
+            virtual bool is_object() const { return true; }
+            virtual std::vector<std::string> object_keys() const
+            {
+                std::vector<std::string> result;
+                result.push_back("length");
+                return result;
+            }
+            virtual bool try_get(const std::string &key, value &result) const;
+
+            static inline value make_value(number_vector &&input)
+            {
+                return value(make_tracked<number_array_value>(std::move(input)));
+            }
+    };
+} // lysithea_vm
@@ -1,6 +1,7 @@
 #include "object_value.hpp"
 
 #include <sstream>
+#include <algorithm>
 
 #include "../utils.hpp"
 #include "../values/array_value.hpp"
@@ -11,7 +12,7 @@ namespace lysithea_vm
 
     int object_value::compare_to(const complex_value *input) const
     {
-        auto other = dynamic_cast<const object_value *>(input);
+        auto other = complex_cast<const object_value>(input);
         if (!other)
         {
             return 1;
@@ -27,28 +28,58 @@ namespace lysithea_vm
 
         for (auto iter = data.cbegin(); iter != data.cend(); ++iter)
         {
-            auto find_other = other_object.find(iter->first);
-            if (find_other == other_object.end())
+            auto find_other = other_object.find_value(iter->first);
+            if (!find_other)
             {
                 return 1;
             }
 
-            auto compare_value = iter->second.compare_to(find_other->second);
+            auto compare_value = iter->second.compare_to(*find_other);
             if (compare_value != 0)
             {
-                return 0;
+                return compare_value;
             }
         }
 
         return 0;
     }
 
+    bool object_value::exactly_equals(const complex_value *input) const
+    {
+        auto other = complex_cast<const object_value>(input);
+        if (!other || other->data.size() != data.size())
+        {
+            return false;
+        }
+
+        for (auto iter = data.cbegin(); iter != data.cend(); ++iter)
+        {
+            auto find_other = other->data.find_value(iter->first);
+            if (!find_other || !iter->second.exactly_equals(*find_other))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::size_t object_value::get_hash() const
+    {
+        // Added together so that the order of the pairs doesn't matter.
+        std::size_t result = data.size();
+        for (const auto &iter : data)
+        {
+            result += hash_combine(std::hash<std::string>()(iter.first), iter.second.get_hash());
+        }
+        return result;
+    }
+
     std::string object_value::to_string() const
     {
         std::stringstream ss;
         ss << '{';
         auto first = true;
-        for (const auto &iter : data)
+        for (const auto &iter : sorted_pairs(data))
         {
             if (!first)
             {
@@ -57,9 +88,9 @@ namespace lysithea_vm
             first = false;
 
             ss << '"';
-            ss << iter.first;
+            ss << iter->first;
             ss << "\" ";
-            ss << iter.second.to_string();
+            ss << iter->second.to_string();
         }
         ss << '}';
         return ss.str();
@@ -75,7 +106,7 @@ namespace lysithea_vm
             {
                 auto key = iter->to_string();
                 ++iter;
-                obj[key] = *iter;
+                obj.set(key, *iter);
             }
             else if (iter->is_object())
             {
@@ -85,7 +116,7 @@ namespace lysithea_vm
                     value obj_value;
                     if (complex->try_get(key, obj_value))
                     {
-                        obj[key] = obj_value;
+                        obj.set(key, obj_value);
                     }
                 }
             }
@@ -93,10 +124,26 @@ namespace lysithea_vm
             {
                 auto key = iter->to_string();
                 ++iter;
-                obj[key] = *iter;
+                obj.set(key, *iter);
             }
         }
 
         return object_value::make_value(obj);
     }
+
+    std::vector<const object_pair *> object_value::sorted_pairs(const object_map &input)
+    {
+        std::vector<const object_pair *> result;
+        result.reserve(input.size());
+        for (const auto &iter : input)
+        {
+            result.push_back(&iter);
+        }
+
+        std::sort(result.begin(), result.end(), [](const object_pair *left, const object_pair *right)
+        {
+            return left->first < right->first;
+        });
+        return result;
+    }
 } // lysithea_vm
\ No newline at end of file
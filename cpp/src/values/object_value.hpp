@@ -1,29 +1,35 @@
 #pragma once
 
 #include <memory>
-#include <map>
 #include <string>
+#include <vector>
+#include <utility>
 
 #include "./complex_value.hpp"
 #include "./value.hpp"
+#include "../persistent_map.hpp"
 
 namespace lysithea_vm
 {
-    using object_map = std::map<std::string, value>;
+    using object_map = persistent_map<std::string, value>;
+    using object_pair = std::pair<std::string, value>;
 
     class object_value : public complex_value
     {
         public:
             // Fields
+            static const complex_kind kind_tag = complex_kind::object;
             static value empty;
             object_map data;
 
             // Constructor
-            object_value() { }
-            object_value(const object_map &data) : data(data) { }
+            object_value() : complex_value(kind_tag) { }
+            object_value(const object_map &data) : complex_value(kind_tag), data(data) { }
 
             // Methods
             virtual int compare_to(const complex_value *input) const;
+            virtual std::size_t get_hash() const;
+            virtual bool exactly_equals(const complex_value *input) const;
             virtual std::string to_string() const;
 
             virtual std::string type_name() const { return "object"; }
@@ -33,9 +39,9 @@ namespace lysithea_vm
             {
                 std::vector<std::string> result;
 
-                for (const auto &iter : data)
+                for (const auto &iter : sorted_pairs(data))
                 {
-                    result.push_back(iter.first);
+                    result.push_back(iter->first);
                 }
 
                 return result;
@@ -43,21 +49,17 @@ namespace lysithea_vm
 
             virtual bool try_get(const std::string &key, lysithea_vm::value &result) const
             {
-                auto find = data.find(key);
-                if (find == data.end())
-                {
-                    return false;
-                }
-
-                result = find->second;
-                return true;
+                return data.try_get(key, result);
             }
 
             static inline lysithea_vm::value make_value(const object_map &input)
             {
-                return lysithea_vm::value(std::make_shared<object_value>(input));
+                return lysithea_vm::value(make_tracked<object_value>(input));
             }
 
             static value join(const array_value &args);
+
+            // The map is ordered by hash, anything that shows the order to the script uses this instead.
+            static std::vector<const object_pair *> sorted_pairs(const object_map &input);
     };
 } // lysithea_vm
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "set_value.hpp"
+
+namespace lysithea_vm
+{
+    value set_value::empty(std::make_shared<set_value>());
+
+    int set_value::compare_to(const complex_value *input) const
+    {
+        auto other = complex_cast<const set_value>(input);
+        if (!other)
+        {
+            return 1;
+        }
+
+        auto compare_length = compare(data.size(), other->data.size());
+        if (compare_length != 0)
+        {
+            return compare_length;
+        }
+
+        for (const auto &iter : data)
+        {
+            if (!other->contains(iter.first))
+            {
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    std::size_t set_value::get_hash() const
+    {
+        // Added together so that the order of the values doesn't matter.
+        std::size_t result = data.size();
+        for (const auto &iter : data)
+        {
+            result += iter.first.get_hash();
+        }
+        return result;
+    }
+
+    bool set_value::try_get(const std::string &key, value &result) const
+    {
+        if (key == "length")
+        {
+            result = value(data.size());
+            return true;
+        }
+
+        return false;
+    }
+
+    std::string set_value::to_string() const
+    {
+        std::string result("(");
+        auto first = true;
+        for (const auto &iter : data)
+        {
+            if (!first)
+            {
+                result += ' ';
+            }
+            first = false;
+
+            iter.first.append_to_string(result);
+        }
+        result += ')';
+        return result;
+    }
+} // lysithea_vm
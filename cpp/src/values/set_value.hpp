@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./complex_value.hpp"
+#include "./value.hpp"
+#include "../persistent_map.hpp"
+
+namespace lysithea_vm
+{
+    // Only the keys are used, the mapped value is always true.
+    using set_map = persistent_map<value, bool, value_hash, value_equal>;
+
+    // A collection of unique values with hashed lookups.
+    // Like objects it is ordered by the hashes of the values.
+    class set_value : public complex_value
+    {
+        public:
+            // Fields
+            static const complex_kind kind_tag = complex_kind::set;
+            static value empty;
+
+            set_map data;
+
+            // Constructor
+            set_value() : complex_value(kind_tag) { }
+            set_value(const set_map &data) : complex_value(kind_tag), data(data) { }
+
+            // Methods
+            virtual int compare_to(const complex_value *input) const;
+            virtual std::size_t get_hash() const;
+            virtual std::string to_string() const;
+            virtual std::string type_name() const { return "set"; }
+
+            inline bool contains(const value &input) const { return data.contains(input); }
+            inline void add(const value &input) { data.set(input, true); }
+            inline void remove(const value &input) { data.erase(input); }
+
+            // Object methods
+            virtual bool is_object() const { return true; }
+            virtual std::vector<std::string> object_keys() const
+            {
+                std::vector<std::string> result;
+                result.push_back("length");
+                return result;
+            }
+            virtual bool try_get(const std::string &key, value &result) const;
+
+            static inline value make_value(const set_map &input)
+            {
+                return value(make_tracked<set_value>(input));
+            }
+    };
+} // lysithea_vm
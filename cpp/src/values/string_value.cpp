@@ -1,5 +1,9 @@
 #include "string_value.hpp"
 
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+
 #include "./values.hpp"
 #include "../virtual_machine.hpp"
 
@@ -15,4 +19,80 @@ namespace lysithea_vm
 
         return false;
     }
+
+    std::shared_ptr<string_value> string_value::intern(const std::string &input)
+    {
+        if (input.size() == 1)
+        {
+            return single_char(input[0]);
+        }
+
+        // The assembler can run on several threads at once.
+        static std::mutex intern_mutex;
+        // Only weakly held so that strings from scripts that have been freed don't stay around, a string that is interned
+        // again after that is a new string but there is still only one alive for each text.
+        static std::unordered_map<std::string, std::weak_ptr<string_value>> interned_strings;
+        static std::size_t prune_at_size = 64;
+
+        std::lock_guard<std::mutex> lock(intern_mutex);
+        auto find = interned_strings.find(input);
+        if (find != interned_strings.end())
+        {
+            if (auto existing = find->second.lock())
+            {
+                return existing;
+            }
+        }
+
+        auto result = make_interned(input);
+        if (find != interned_strings.end())
+        {
+            find->second = result;
+            return result;
+        }
+
+        // Expired strings are removed each time the table doubles in size so the cost is spread over the interning.
+        if (interned_strings.size() >= prune_at_size)
+        {
+            for (auto iter = interned_strings.begin(); iter != interned_strings.end();)
+            {
+                if (iter->second.expired())
+                {
+                    iter = interned_strings.erase(iter);
+                }
+                else
+                {
+                    ++iter;
+                }
+            }
+            prune_at_size = std::max(static_cast<std::size_t>(64), interned_strings.size() * 2);
+        }
+
+        interned_strings.emplace(input, result);
+        return result;
+    }
+
+    std::shared_ptr<string_value> string_value::single_char(char input)
+    {
+        static const std::vector<std::shared_ptr<string_value>> single_chars = create_single_chars();
+        return single_chars[static_cast<unsigned char>(input)];
+    }
+
+    std::shared_ptr<string_value> string_value::make_interned(const std::string &input)
+    {
+        auto result = make_tracked<string_value>(input);
+        result->is_interned = true;
+        result->hash = hash_text(input.data(), input.size());
+        return result;
+    }
+
+    std::vector<std::shared_ptr<string_value>> string_value::create_single_chars()
+    {
+        std::vector<std::shared_ptr<string_value>> result;
+        for (auto i = 0; i < 256; i++)
+        {
+            result.push_back(make_interned(std::string(1, static_cast<char>(i))));
+        }
+        return result;
+    }
 } // lysithea_vm
\ No newline at end of file
@@ -3,26 +3,41 @@
 #include <memory>
 #include <string>
 #include <cstring>
+#include <functional>
 
 #include "./complex_value.hpp"
+#include "../tracking_allocator.hpp"
 
 namespace lysithea_vm
 {
+    // The characters of strings made while a script runs are counted by its virtual machine's memory tracker.
+    using tracked_string = std::basic_string<char, std::char_traits<char>, tracking_allocator<char>>;
+
     class string_value : public complex_value
     {
         public:
             // Fields
-            std::string data;
+            static const complex_kind kind_tag = complex_kind::string;
+
+            tracked_string data;
+            // Interned strings are shared by every use of the same text and are never changed, so their hash is only worked out once.
+            bool is_interned;
+            std::size_t hash;
 
             // Constructor
-            string_value(const std::string &data) : data(data) { }
-            string_value(const char *data) : data(data) { }
+            string_value(const std::string &data) : complex_value(kind_tag), data(data.data(), data.size()), is_interned(false), hash(0) { }
+            string_value(const char *data) : complex_value(kind_tag), data(data), is_interned(false), hash(0) { }
+            string_value(tracked_string &&data) : complex_value(kind_tag), data(std::move(data)), is_interned(false), hash(0) { }
 
             // Methods
-            virtual bool is_string() const { return true; }
             virtual int compare_to(const complex_value *input) const
             {
-                auto other = dynamic_cast<const string_value *>(input);
+                if (input == this)
+                {
+                    return 0;
+                }
+
+                auto other = complex_cast<const string_value>(input);
                 if (!other)
                 {
                     return 1;
@@ -31,9 +46,30 @@ namespace lysithea_vm
                 return strcmp(data.c_str(), other->data.c_str());
             }
 
+            inline bool equals(const string_value &other) const
+            {
+                if (&other == this)
+                {
+                    return true;
+                }
+
+                // There is only one interned string for each text.
+                if (is_interned && other.is_interned)
+                {
+                    return false;
+                }
+
+                return data == other.data;
+            }
+
+            virtual std::size_t get_hash() const
+            {
+                return is_interned ? hash : hash_text(data.data(), data.size());
+            }
+
             virtual std::string to_string() const
             {
-                return data;
+                return std::string(data.data(), data.size());
             }
 
             virtual std::string type_name() const
@@ -50,5 +86,25 @@ namespace lysithea_vm
                 return result;
             }
             virtual bool try_get(const std::string &key, lysithea_vm::value &result) const;
+
+            static std::shared_ptr<string_value> intern(const std::string &input);
+            static std::shared_ptr<string_value> single_char(char input);
+
+            // FNV-1a, the text is hashed directly so that the tracked buffer doesn't need copying into a std::string first.
+            static inline std::size_t hash_text(const char *text, std::size_t length)
+            {
+                std::size_t result = 14695981039346656037ULL & static_cast<std::size_t>(-1);
+                for (std::size_t i = 0; i < length; i++)
+                {
+                    result ^= static_cast<unsigned char>(text[i]);
+                    result *= static_cast<std::size_t>(1099511628211ULL);
+                }
+                return result;
+            }
+
+        private:
+            // Methods
+            static std::shared_ptr<string_value> make_interned(const std::string &input);
+            static std::vector<std::shared_ptr<string_value>> create_single_chars();
     };
 } // lysithea_vm
\ No newline at end of file
@@ -1,12 +1,14 @@
 #pragma once
 
 #include <cmath>
+#include <limits>
 #include <memory>
 #include <sstream>
 
 #include "./string_value.hpp"
 #include "./builtin_function_value.hpp"
 #include "../utils.hpp"
+#include "../tracking_allocator.hpp"
 
 namespace lysithea_vm
 {
@@ -34,8 +36,8 @@ namespace lysithea_vm
             value(unsigned int input) : type(value_type::number), number(static_cast<double>(input)) { }
             value(double input) : type(value_type::number), number(input) { }
             value(std::size_t input) : type(value_type::number), number(static_cast<double>(input)) { }
-            value(const char * input) : type(value_type::complex), data(std::make_shared<string_value>(input)) { }
-            value(const std::string &input) : type(value_type::complex), data(std::make_shared<string_value>(input)) { }
+            value(const char * input) : type(value_type::complex), data(make_tracked<string_value>(input)) { }
+            value(const std::string &input) : type(value_type::complex), data(make_tracked<string_value>(input)) { }
             value(complex_ptr input) : type(value_type::complex), data(input) { }
 
             // Methods
@@ -87,6 +89,15 @@ namespace lysithea_vm
                 return false;
             }
 
+            inline bool is_number_array() const
+            {
+                if (is_complex())
+                {
+                    return get_complex()->is_number_array();
+                }
+                return false;
+            }
+
             inline bool is_object() const
             {
                 if (is_complex())
@@ -133,7 +144,23 @@ namespace lysithea_vm
             template <typename T>
             inline std::shared_ptr<T> get_complex() const
             {
-                return std::dynamic_pointer_cast<T>(get_complex());
+                return complex_pointer_cast<T>(get_complex());
+            }
+
+            // Returns the complex value only when this is the last reference to it, so that it can be changed without that being seen anywhere else.
+            template <typename T>
+            inline T *get_unique_complex() const
+            {
+                if (!is_complex() || data.use_count() != 1)
+                {
+                    return nullptr;
+                }
+                // The intern table can still hand out a string once nothing else holds it, so it is never changed.
+                if (data->kind == complex_kind::string && static_cast<const string_value *>(data.get())->is_interned)
+                {
+                    return nullptr;
+                }
+                return complex_cast<T>(data.get());
             }
 
             int compare_to(const value &other) const
@@ -153,13 +180,82 @@ namespace lysithea_vm
                     case value_type::number:
                         return compare(get_number(), other.get_number());
                     case value_type::complex:
-                        return get_complex()->compare_to(other.get_complex().get());
+                        if (data->kind != other.data->kind)
+                        {
+                            return 1;
+                        }
+                        return data->compare_to(other.data.get());
                     default: break;
                 }
 
                 return 1;
             }
 
+            // Equality without going through compare_to for values that share the same data or are both strings.
+            inline bool equals(const value &other) const
+            {
+                if (type == value_type::complex && other.type == value_type::complex)
+                {
+                    if (data == other.data)
+                    {
+                        return true;
+                    }
+
+                    if (data->is_string() && other.data->is_string())
+                    {
+                        return static_cast<const string_value *>(data.get())->equals(*static_cast<const string_value *>(other.data.get()));
+                    }
+                }
+
+                return compare_to(other) == 0;
+            }
+
+            // Equality for hashed containers, unlike equals numbers have to match exactly rather than be within compare's tolerance.
+            inline bool exactly_equals(const value &other) const
+            {
+                if (type != other.type)
+                {
+                    return false;
+                }
+
+                switch (type)
+                {
+                    case value_type::number:
+                        return number == other.number || (std::isnan(number) && std::isnan(other.number));
+                    case value_type::complex:
+                        if (data == other.data)
+                        {
+                            return true;
+                        }
+                        if (data->is_string() && other.data->is_string())
+                        {
+                            return static_cast<const string_value *>(data.get())->equals(*static_cast<const string_value *>(other.data.get()));
+                        }
+                        return data->exactly_equals(other.data.get());
+                    default:
+                        return true;
+                }
+            }
+
+            // Numbers are hashed by their exact value, so only values that are exactly equal are sure to have the same hash.
+            std::size_t get_hash() const
+            {
+                switch (type)
+                {
+                    case value_type::number:
+                        // Makes sure that 0 and -0 have the same hash, and that every NaN does.
+                        if (std::isnan(number))
+                        {
+                            return std::hash<double>()(std::numeric_limits<double>::quiet_NaN());
+                        }
+                        return std::hash<double>()(number == 0.0 ? 0.0 : number);
+                    case value_type::complex:
+                        return data->get_hash();
+                    default:
+                        return static_cast<std::size_t>(type);
+                }
+            }
+
             std::string to_string() const
             {
                 switch (type)
@@ -169,9 +265,9 @@ namespace lysithea_vm
                     case value_type::null: return "null";
                     case value_type::number:
                     {
-                        std::stringstream ss;
-                        ss << std::noshowpoint << get_number();
-                        return ss.str();
+                        std::string result;
+                        append_number(result, get_number());
+                        return result;
                     }
                     case value_type::complex: return get_complex()->to_string();
                     default: break;
@@ -180,6 +276,40 @@ namespace lysithea_vm
                 return "undefined";
             }
 
+            // Adds the string form onto the end of the target, without a temporary string for numbers and strings.
+            inline void append_to_string(std::string &target) const
+            {
+                if (type == value_type::number)
+                {
+                    append_number(target, number);
+                    return;
+                }
+
+                auto str = is_complex() ? complex_cast<const string_value>(data.get()) : nullptr;
+                if (str)
+                {
+                    target.append(str->data.data(), str->data.size());
+                    return;
+                }
+
+                target += to_string();
+            }
+
+            // The same for a string value's own buffer, as used when a string is built up in place.
+            inline void append_to_string(tracked_string &target) const
+            {
+                auto str = is_complex() ? complex_cast<const string_value>(data.get()) : nullptr;
+                if (str)
+                {
+                    target.append(str->data.data(), str->data.size());
+                    return;
+                }
+
+                std::string text;
+                append_to_string(text);
+                target.append(text.data(), text.size());
+            }
+
             std::string type_name() const
             {
                 switch (type)
@@ -201,6 +331,16 @@ namespace lysithea_vm
                 return value(std::make_shared<builtin_function_value>(input));
             }
 
+            inline static value make_builtin(builtin_function_callback input, bool can_update_in_place)
+            {
+                return value(std::make_shared<builtin_function_value>(input, can_update_in_place));
+            }
+
+            inline static value make_native(native_function input, bool can_update_in_place = false)
+            {
+                return value(std::make_shared<builtin_function_value>(input, can_update_in_place));
+            }
+
             inline static value make_null()
             {
                 return value(value_type::null);
@@ -215,4 +355,15 @@ namespace lysithea_vm
             // Constructor
             value(value_type type) : type(type) { }
     };
+
+    // For using values as keys in hashed containers.
+    struct value_hash
+    {
+        inline std::size_t operator()(const value &input) const { return input.get_hash(); }
+    };
+
+    struct value_equal
+    {
+        inline bool operator()(const value &left, const value &right) const { return left.exactly_equals(right); }
+    };
 } // lysithea_vm
\ No newline at end of file
@@ -12,7 +12,7 @@ namespace lysithea_vm
         for (const auto &iter : properties.data)
         {
             int index;
-            if (current.is_array() && try_parse_index(iter, index))
+            if ((current.is_array() || current.is_number_array()) && try_parse_index(iter, index))
             {
                 if (!current.get_complex()->try_get(index, current))
                 {
@@ -49,7 +49,7 @@ namespace lysithea_vm
         {
             try
             {
-                result = std::stoi(is_string->data);
+                result = std::stoi(is_string->to_string());
                 return result >= 0;
             }
             catch (std::exception &exp)
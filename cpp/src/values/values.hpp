@@ -3,7 +3,10 @@
 #include "./value.hpp"
 #include "./complex_value.hpp"
 #include "./array_value.hpp"
+#include "./args_span.hpp"
 #include "./builtin_function_value.hpp"
 #include "./function_value.hpp"
+#include "./number_array_value.hpp"
+#include "./set_value.hpp"
 #include "./object_value.hpp"
 #include "./string_value.hpp"
\ No newline at end of file
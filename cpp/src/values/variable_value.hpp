@@ -12,11 +12,13 @@ namespace lysithea_vm
     {
         public:
             // Fields
+            static const complex_kind kind_tag = complex_kind::variable;
+
             std::string data;
 
             // Constructor
-            variable_value(const std::string data) : data(data) { }
-            variable_value(const char *data) : data(data) { }
+            variable_value(const std::string data) : complex_value(kind_tag), data(data) { }
+            variable_value(const char *data) : complex_value(kind_tag), data(data) { }
 
             // Methods
             bool is_label() const
@@ -26,7 +28,7 @@ namespace lysithea_vm
 
             virtual int compare_to(const complex_value *input) const
             {
-                auto other = dynamic_cast<const variable_value *>(input);
+                auto other = complex_cast<const variable_value>(input);
                 if (!other)
                 {
                     return 1;
@@ -35,6 +37,8 @@ namespace lysithea_vm
                 return strcmp(data.c_str(), other->data.c_str());
             }
 
+            virtual std::size_t get_hash() const { return std::hash<std::string>()(data); }
+
             virtual std::string to_string() const
             {
                 return data;
@@ -0,0 +1,121 @@
+#include "verifier.hpp"
+
+#include "./values/array_value.hpp"
+#include "./values/string_value.hpp"
+#include "./values/function_value.hpp"
+
+namespace lysithea_vm
+{
+    bool verifier::verify(function &input)
+    {
+        input.verified = false;
+        input.jump_targets.assign(input.code.size(), -1);
+
+        for (auto i = 0; i < input.code.size(); i++)
+        {
+            const auto &line = input.code[i];
+            if (!is_valid_line(input, line))
+            {
+                return false;
+            }
+
+            // Jumps to a known label are resolved now instead of looking up the label each time.
+            if (is_jump(line.op) && line.has_value())
+            {
+                auto find = input.labels.find(line.value.to_string());
+                if (find == input.labels.end())
+                {
+                    return false;
+                }
+                input.jump_targets[i] = find->second;
+            }
+        }
+
+        input.verified = true;
+        return true;
+    }
+
+    bool verifier::is_valid_line(const function &input, const code_line &line)
+    {
+        switch (line.op)
+        {
+            default: return false;
+
+            case vm_operator::push:
+                return line.has_value();
+
+            case vm_operator::call:
+            case vm_operator::string_concat:
+            case vm_operator::make_array:
+            case vm_operator::make_object:
+                return line.value.is_number() && line.value.get_int() >= 0;
+
+            case vm_operator::tail_call:
+                if (line.value.is_number())
+                {
+                    return line.value.get_int() >= 0;
+                }
+                // Fall through to check the same shape as call direct.
+            case vm_operator::call_direct:
+            {
+                if (!line.value.is_array())
+                {
+                    return false;
+                }
+
+                auto array_input = line.value.get_complex<const array_value>();
+                return array_input->data.size() == 2 &&
+                    array_input->data[0].is_function() &&
+                    array_input->data[1].is_number();
+            }
+
+            case vm_operator::inc:
+            case vm_operator::dec:
+                return line.value.is_complex();
+
+            case vm_operator::get:
+                return !line.has_value() || line.value.is_string();
+
+            case vm_operator::get_move:
+                return line.value.is_string();
+
+            case vm_operator::get_upvalue:
+            case vm_operator::set_upvalue:
+                return line.value.is_number() && line.value.get_int() >= 0 && line.value.get_int() < input.captures.size();
+
+            case vm_operator::make_closure:
+                return line.value.get_complex<const function_value>() != nullptr;
+
+            case vm_operator::get_property:
+            case vm_operator::to_argument:
+                return !line.has_value() || line.value.is_array();
+
+            case vm_operator::set:
+            case vm_operator::define:
+            case vm_operator::jump:
+            case vm_operator::jump_true:
+            case vm_operator::jump_false:
+            case vm_operator::call_return:
+            case vm_operator::greater_than:
+            case vm_operator::greater_than_equals:
+            case vm_operator::equals:
+            case vm_operator::not_equals:
+            case vm_operator::less_than:
+            case vm_operator::less_than_equals:
+            case vm_operator::op_not:
+            case vm_operator::op_and:
+            case vm_operator::op_or:
+            case vm_operator::add:
+            case vm_operator::sub:
+            case vm_operator::multiply:
+            case vm_operator::divide:
+            case vm_operator::unary_negative:
+                return true;
+        }
+    }
+
+    bool verifier::is_jump(vm_operator op)
+    {
+        return op == vm_operator::jump || op == vm_operator::jump_true || op == vm_operator::jump_false;
+    }
+} // lysithea_vm
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#include "function.hpp"
+
+namespace lysithea_vm
+{
+    // Checks the code of a function once after assembly so that the virtual machine can skip re-checking it on every step.
+    class verifier
+    {
+        public:
+            // Methods
+            static bool verify(function &input);
+            static bool is_valid_line(const function &input, const code_line &line);
+
+        private:
+            // Methods
+            static bool is_jump(vm_operator op);
+    };
+} // lysithea_vm
@@ -2,9 +2,11 @@
 
 #include <cmath>
 #include <iostream>
+#include <atomic>
 
 #include "./values/value_property_access.hpp"
 #include "./values/object_value.hpp"
+#include "./values/function_value.hpp"
 #include "./standard_library/standard_array_library.hpp"
 #include "./utils.hpp"
 #include "./errors/virtual_machine_error.hpp"
@@ -14,20 +16,62 @@ namespace lysithea_vm
 {
     std::shared_ptr<const array_value> virtual_machine::empty_args(std::make_shared<const array_value>(true));
 
+    namespace
+    {
+        std::atomic<std::uint64_t> next_scope_owner(1);
+    }
+
     virtual_machine::virtual_machine(int stack_size) :
         stack(stack_size), stack_trace(stack_size), program_counter(0), running(false), paused(false),
-        global_scope(std::make_shared<scope>())
+        memory(memory_tracker::create()), scope_owner(next_scope_owner++), shares_scopes(false),
+        next_scope_id(1), lookup_code(nullptr), current_lookups(nullptr), moved_variable(nullptr), moved_data(nullptr), moved_stack_index(0)
     {
+        memory_scope tracking(memory.get());
+        global_scope = make_scope(nullptr);
         current_scope = global_scope;
     }
 
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+    virtual_machine::~virtual_machine()
+    {
+        stack.clear();
+        stack_trace.clear();
+        release_scopes();
+    }
+#endif
+
+    void virtual_machine::release_scopes()
+    {
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+        // Scopes that were kept alive by the global scope, or that still keep it alive, are only found by starting from it.
+        if (global_scope)
+        {
+            collector.add_candidate(global_scope);
+        }
+#endif
+
+        current_scope.reset();
+        global_scope.reset();
+        cell_copies.clear();
+        clear_lookup_caches();
+
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+        collector.collect();
+#endif
+    }
+
     void virtual_machine::reset()
     {
         program_counter = 0;
-        global_scope = std::make_shared<scope>();
-        current_scope = global_scope;
         stack.clear();
         stack_trace.clear();
+
+        // Let go of the old scopes first so that a reset after hitting the memory limit has room for the new global scope.
+        release_scopes();
+
+        memory_scope tracking(memory.get());
+        global_scope = make_scope(nullptr);
+        current_scope = global_scope;
         running = false;
         paused = false;
     }
@@ -40,22 +84,91 @@ namespace lysithea_vm
 
         builtin_scope = script->builtin_scope;
         current_code = script->code;
+        clear_lookup_caches();
     }
 
     void virtual_machine::execute(std::shared_ptr<script> script)
     {
         change_to_script(script);
+        execute();
+    }
 
+    void virtual_machine::execute()
+    {
         running = true;
         paused = false;
 
-        while (running && !paused)
+        memory_scope tracking(memory.get());
+        try
+        {
+            while (running && !paused)
+            {
+                step_current();
+            }
+        }
+        catch (const memory_limit_error &exp)
+        {
+            restore_moved_variable();
+            throw create_memory_error(exp);
+        }
+        catch (...)
         {
-            step();
+            restore_moved_variable();
+            throw;
         }
     }
 
     void virtual_machine::step()
+    {
+        memory_scope tracking(memory.get());
+        try
+        {
+            step_current();
+        }
+        catch (const memory_limit_error &exp)
+        {
+            restore_moved_variable();
+            throw create_memory_error(exp);
+        }
+        catch (...)
+        {
+            restore_moved_variable();
+            throw;
+        }
+    }
+
+    void virtual_machine::restore_moved_variable()
+    {
+        // Only put back if the value has not been replaced on the stack, otherwise it was used up before the error.
+        if (moved_variable && moved_stack_index < stack.stack_size())
+        {
+            const auto &pushed = *stack.data_from(moved_stack_index);
+            if (pushed.is_complex() && pushed.data.get() == moved_data)
+            {
+                *moved_variable = pushed;
+            }
+        }
+        moved_variable = nullptr;
+    }
+
+    void virtual_machine::step_current()
+    {
+        if (current_code->native_body)
+        {
+            current_code->native_body(*this);
+        }
+        else if (current_code->verified)
+        {
+            step_impl<true>();
+        }
+        else
+        {
+            step_impl<false>();
+        }
+    }
+
+    template <bool verified>
+    void virtual_machine::step_impl()
     {
         if (program_counter >= current_code->code.size())
         {
@@ -67,8 +180,9 @@ namespace lysithea_vm
         }
 
         const auto &code_line = current_code->code[program_counter++];
+        memory->current_operator = code_line.op;
 
-        switch (code_line.op)
+        switch (verified ? code_line.current_op() : code_line.op)
         {
             default:
             {
@@ -76,7 +190,7 @@ namespace lysithea_vm
             }
             case vm_operator::push:
             {
-                if (!code_line.value.is_undefined())
+                if (verified || !code_line.value.is_undefined())
                 {
                     stack.push(code_line.value);
                 }
@@ -94,28 +208,98 @@ namespace lysithea_vm
                     throw virtual_machine_error(create_stack_trace(), std::string("Unable to convert input to argument: ") + top->to_string());
                 }
 
-                push_stack(std::make_shared<array_value>(top->data, true));
+                push_stack(make_tracked<array_value>(top->data, true));
                 break;
             }
             case vm_operator::get:
             {
                 auto key = get_operator_arg(code_line);
-                auto is_string = key.get_complex<string_value>();
+                auto is_string = verified && code_line.has_value() ?
+                    static_cast<const string_value *>(key.get_complex().get()) :
+                    key.get_complex<const string_value>().get();
                 if (!is_string)
                 {
                     throw virtual_machine_error(create_stack_trace(), std::string("Unable to get value, input needs to be a string: ") + key.to_string());
                 }
 
+                if (code_line.has_value())
+                {
+                    if (auto found = find_variable(code_line))
+                    {
+                        push_stack(found->variable());
+                        break;
+                    }
+                }
+                else
+                {
+                    value found_value;
+                    auto name = is_string->to_string();
+                    if (current_scope->try_get_key(name, found_value) ||
+                        (builtin_scope && builtin_scope->try_get_key(name, found_value)))
+                    {
+                        push_stack(std::move(found_value));
+                        break;
+                    }
+                }
+                throw virtual_machine_error(create_stack_trace(), std::string("Unable to find value to get: ") + key.to_string());
+            }
+            case vm_operator::get_move:
+            {
+                // Only emitted by the assembler when the variable is set again straight after, so the value can be taken out of the scope.
+                auto key = verified ?
+                    static_cast<const string_value *>(code_line.value.get_complex().get()) :
+                    code_line.value.get_complex<const string_value>().get();
+                if (!key)
+                {
+                    throw virtual_machine_error(create_stack_trace(), std::string("Unable to get value, input needs to be a string: ") + code_line.value.to_string());
+                }
+
+                // The value is expected to be set again straight away, until then it is left as null.
+                if (auto variable = writable_variable(find_variable(code_line)))
+                {
+                    push_moved(*variable);
+                    break;
+                }
+
+                // A scope shared with a forked virtual machine is copied first so that the fork still sees the value.
+                auto name = key->to_string();
+                prepare_scope_write(name);
+                if (auto variable = writable_variable(find_variable(code_line)))
+                {
+                    push_moved(*variable);
+                    break;
+                }
+
                 value found_value;
-                if (current_scope->try_get_key(is_string->data, found_value) ||
-                    (builtin_scope && builtin_scope->try_get_key(is_string->data, found_value)))
+                if (current_scope->try_get_key(name, found_value) ||
+                    (builtin_scope && builtin_scope->try_get_key(name, found_value)))
                 {
-                    push_stack(found_value);
+                    push_stack(std::move(found_value));
                 }
                 else
                 {
-                    throw virtual_machine_error(create_stack_trace(), std::string("Unable to find value to get: ") + key.to_string());
+                    throw virtual_machine_error(create_stack_trace(), std::string("Unable to find value to get: ") + name);
+                }
+                break;
+            }
+            case vm_operator::get_upvalue:
+            {
+                if (!verified && !(code_line.value.is_number() && code_line.value.get_int() >= 0 && code_line.value.get_int() < current_code->captures.size()))
+                {
+                    throw virtual_machine_error(create_stack_trace(), "GetUpvalue needs the index of a captured variable");
+                }
+
+                get_captured(code_line.value.get_int());
+                break;
+            }
+            case vm_operator::set_upvalue:
+            {
+                if (!verified && !(code_line.value.is_number() && code_line.value.get_int() >= 0 && code_line.value.get_int() < current_code->captures.size()))
+                {
+                    throw virtual_machine_error(create_stack_trace(), "SetUpvalue needs the index of a captured variable");
                 }
+
+                set_captured(code_line.value.get_int(), pop_stack());
                 break;
             }
             case vm_operator::get_property:
@@ -143,14 +327,26 @@ namespace lysithea_vm
             {
                 auto key = get_operator_arg(code_line);
                 auto value = pop_stack();
-                current_scope->try_define(key.to_string(), value);
+                writable_current_scope().try_define(key.to_string(), std::move(value));
                 break;
             }
             case vm_operator::set:
             {
+                moved_variable = nullptr;
                 auto key = get_operator_arg(code_line);
                 auto value = pop_stack();
-                if (!current_scope->try_set(key.to_string(), value))
+                if (code_line.has_value())
+                {
+                    if (auto variable = writable_variable(find_variable(code_line)))
+                    {
+                        *variable = std::move(value);
+                        break;
+                    }
+                }
+
+                auto key_string = key.to_string();
+                prepare_scope_write(key_string);
+                if (!current_scope->try_set(key_string, std::move(value)))
                 {
                     throw virtual_machine_error(create_stack_trace(), "Unable to set variable that has not been defined: " + key.to_string());
                 }
@@ -158,6 +354,15 @@ namespace lysithea_vm
             }
             case vm_operator::jump_false:
             {
+                if (verified && code_line.has_value())
+                {
+                    if (pop_stack().is_false())
+                    {
+                        program_counter = current_code->jump_targets[program_counter - 1];
+                    }
+                    break;
+                }
+
                 const auto label = get_operator_arg(code_line);
                 auto top = pop_stack();
                 if (top.is_false())
@@ -168,6 +373,15 @@ namespace lysithea_vm
             }
             case vm_operator::jump_true:
             {
+                if (verified && code_line.has_value())
+                {
+                    if (pop_stack().is_true())
+                    {
+                        program_counter = current_code->jump_targets[program_counter - 1];
+                    }
+                    break;
+                }
+
                 const auto label = get_operator_arg(code_line);
                 auto top = pop_stack();
                 if (top.is_true())
@@ -178,6 +392,12 @@ namespace lysithea_vm
             }
             case vm_operator::jump:
             {
+                if (verified && code_line.has_value())
+                {
+                    program_counter = current_code->jump_targets[program_counter - 1];
+                    break;
+                }
+
                 const auto label = get_operator_arg(code_line);
                 jump(label.to_string());
                 break;
@@ -189,7 +409,7 @@ namespace lysithea_vm
             }
             case vm_operator::call:
             {
-                if (!code_line.value.is_number())
+                if (!verified && !code_line.value.is_number())
                 {
                     throw virtual_machine_error(create_stack_trace(), "Call needs a num args code line input");
                 }
@@ -207,7 +427,13 @@ namespace lysithea_vm
             }
             case vm_operator::call_direct:
             {
-                auto error = false;
+                if (verified)
+                {
+                    const auto &array_input = static_cast<const array_value *>(code_line.value.get_complex().get())->data;
+                    call_function(*array_input[0].get_complex(), array_input[1].get_int(), true);
+                    break;
+                }
+
                 if (!code_line.value.is_array())
                 {
                     throw virtual_machine_error(create_stack_trace(), "Call direct needs an array input");
@@ -229,22 +455,62 @@ namespace lysithea_vm
                 call_function(*array_input->data[0].get_complex(), num_args.get_int(), true);
                 break;
             }
+            case vm_operator::tail_call:
+            {
+                if (code_line.value.is_number())
+                {
+                    auto top = pop_stack();
+                    if (!top.is_function())
+                    {
+                        throw virtual_machine_error(create_stack_trace(), "Tail call needs a function to run");
+                    }
+                    tail_call_function(*top.get_complex(), code_line.value.get_int());
+                    break;
+                }
+
+                if (!verified)
+                {
+                    auto array_input = code_line.value.get_complex<const array_value>();
+                    if (!array_input || array_input->data.size() != 2 ||
+                        !array_input->data[0].is_function() || !array_input->data[1].is_number())
+                    {
+                        throw virtual_machine_error(create_stack_trace(), "Tail call needs a num args input or two inputs of func and number");
+                    }
+                }
+
+                const auto &array_input = static_cast<const array_value *>(code_line.value.get_complex().get())->data;
+                tail_call_function(*array_input[0].get_complex(), array_input[1].get_int());
+                break;
+            }
 
             // Misc Operator
             case vm_operator::string_concat:
             {
-                if (!code_line.value.is_number())
+                if (!verified && !code_line.value.is_number())
                 {
                     throw virtual_machine_error(create_stack_trace(), "StringConcat operator needs the number of args to concat");
                 }
 
                 auto args = get_args(code_line.value.get_int());
-                std::stringstream ss;
-                for (auto iter : args->data)
+
+                // A first string that nothing else references is used as the builder, so repeated appends to a variable don't copy it each time.
+                auto builder = args->data.size() > 0 ? args->get_unique_index<string_value>(0) : nullptr;
+                if (builder)
+                {
+                    for (auto iter = args->data.cbegin() + 1; iter != args->data.cend(); ++iter)
+                    {
+                        iter->append_to_string(builder->data);
+                    }
+                    push_stack(args->data[0]);
+                    break;
+                }
+
+                std::string result;
+                for (const auto &iter : args->data)
                 {
-                    ss << iter.to_string();
+                    iter.append_to_string(result);
                 }
-                push_stack(ss.str());
+                push_stack(result);
                 break;
             }
 
@@ -252,6 +518,10 @@ namespace lysithea_vm
             case vm_operator::add:
             {
                 push_stack(get_operator_num(code_line) + pop_stack_number());
+                if (verified)
+                {
+                    code_line.record_number(vm_operator::add_number);
+                }
                 break;
             }
 
@@ -260,6 +530,10 @@ namespace lysithea_vm
                 auto right = get_operator_num(code_line);
                 auto left = pop_stack_number();
                 push_stack(left - right);
+                if (verified)
+                {
+                    code_line.record_number(vm_operator::sub_number);
+                }
                 break;
             }
 
@@ -272,6 +546,10 @@ namespace lysithea_vm
             case vm_operator::multiply:
             {
                 push_stack(get_operator_num(code_line) * pop_stack_number());
+                if (verified)
+                {
+                    code_line.record_number(vm_operator::multiply_number);
+                }
                 break;
             }
 
@@ -280,39 +558,59 @@ namespace lysithea_vm
                 auto right = get_operator_num(code_line);
                 auto left = pop_stack_number();
                 push_stack(left / right);
+                if (verified)
+                {
+                    code_line.record_number(vm_operator::divide_number);
+                }
                 break;
             }
 
             case vm_operator::inc:
             {
-                if (!code_line.value.is_complex())
+                if (!verified && !code_line.value.is_complex())
                 {
                     throw virtual_machine_error(create_stack_trace(), "Inc operator needs code line variable");
                 }
 
+                auto variable = writable_variable(find_variable(code_line));
+                if (variable && variable->is_number())
+                {
+                    *variable = value(variable->get_number() + 1.0);
+                    break;
+                }
+
                 auto key = code_line.value.to_string();
                 double found_value;
                 if (!current_scope->try_get_number(key, found_value))
                 {
                     throw virtual_machine_error(create_stack_trace(), "Inc operator could not find variable or was not a number");
                 }
+                prepare_scope_write(key);
                 current_scope->try_set(key, value(found_value + 1.0));
                 break;
             }
 
             case vm_operator::dec:
             {
-                if (!code_line.value.is_complex())
+                if (!verified && !code_line.value.is_complex())
                 {
                     throw virtual_machine_error(create_stack_trace(), "Dec operator needs code line variable");
                 }
 
+                auto variable = writable_variable(find_variable(code_line));
+                if (variable && variable->is_number())
+                {
+                    *variable = value(variable->get_number() - 1.0);
+                    break;
+                }
+
                 auto key = code_line.value.to_string();
                 double found_value;
                 if (!current_scope->try_get_number(key, found_value))
                 {
                     throw virtual_machine_error(create_stack_trace(), "Dec operator could not find variable or was not a number");
                 }
+                prepare_scope_write(key);
                 current_scope->try_set(key, value(found_value - 1.0));
                 break;
             }
@@ -322,6 +620,10 @@ namespace lysithea_vm
             {
                 auto right = get_operator_arg(code_line);
                 auto left = pop_stack();
+                if (verified)
+                {
+                    record_number_feedback(code_line, left, right, vm_operator::less_than_number);
+                }
                 push_stack(left.compare_to(right) < 0);
                 break;
             }
@@ -329,6 +631,10 @@ namespace lysithea_vm
             {
                 auto right = get_operator_arg(code_line);
                 auto left = pop_stack();
+                if (verified)
+                {
+                    record_number_feedback(code_line, left, right, vm_operator::less_than_equals_number);
+                }
                 push_stack(left.compare_to(right) <= 0);
                 break;
             }
@@ -336,20 +642,32 @@ namespace lysithea_vm
             {
                 auto right = get_operator_arg(code_line);
                 auto left = pop_stack();
-                push_stack(left.compare_to(right) == 0);
+                if (verified)
+                {
+                    record_number_feedback(code_line, left, right, vm_operator::equals_number);
+                }
+                push_stack(left.equals(right));
                 break;
             }
             case vm_operator::not_equals:
             {
                 auto right = get_operator_arg(code_line);
                 auto left = pop_stack();
-                push_stack(left.compare_to(right) != 0);
+                if (verified)
+                {
+                    record_number_feedback(code_line, left, right, vm_operator::not_equals_number);
+                }
+                push_stack(!left.equals(right));
                 break;
             }
             case vm_operator::greater_than:
             {
                 auto right = get_operator_arg(code_line);
                 auto left = pop_stack();
+                if (verified)
+                {
+                    record_number_feedback(code_line, left, right, vm_operator::greater_than_number);
+                }
                 push_stack(left.compare_to(right) > 0);
                 break;
             }
@@ -357,6 +675,10 @@ namespace lysithea_vm
             {
                 auto right = get_operator_arg(code_line);
                 auto left = pop_stack();
+                if (verified)
+                {
+                    record_number_feedback(code_line, left, right, vm_operator::greater_than_equals_number);
+                }
                 push_stack(left.compare_to(right) >= 0);
                 break;
             }
@@ -381,7 +703,7 @@ namespace lysithea_vm
             // Value Create
             case vm_operator::make_array:
             {
-                if (!code_line.value.is_number())
+                if (!verified && !code_line.value.is_number())
                 {
                     throw virtual_machine_error(create_stack_trace(), "MakeArray operator needs the number of args to pop");
                 }
@@ -392,7 +714,7 @@ namespace lysithea_vm
             }
             case vm_operator::make_object:
             {
-                if (!code_line.value.is_number())
+                if (!verified && !code_line.value.is_number())
                 {
                     throw virtual_machine_error(create_stack_trace(), "MakeObject operator needs the number of args to pop");
                 }
@@ -401,9 +723,148 @@ namespace lysithea_vm
                 push_stack(object_value::join(*args));
                 break;
             }
+            case vm_operator::make_closure:
+            {
+                auto input = verified ?
+                    static_cast<const function_value *>(code_line.value.get_complex().get()) :
+                    code_line.value.get_complex<const function_value>().get();
+                if (!input)
+                {
+                    throw virtual_machine_error(create_stack_trace(), "MakeClosure needs a function input");
+                }
+
+                push_stack(make_closure(*input));
+                break;
+            }
+
+            // Quickened Operators
+            // Each one checks that its operands are numbers and otherwise goes back to the unspecialised operator and runs the line again.
+            case vm_operator::add_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                left->number = right + left->number;
+                break;
+            }
+            case vm_operator::sub_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                left->number = left->number - right;
+                break;
+            }
+            case vm_operator::multiply_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                left->number = right * left->number;
+                break;
+            }
+            case vm_operator::divide_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                left->number = left->number / right;
+                break;
+            }
+            case vm_operator::less_than_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                *left = value(compare(left->number, right) < 0);
+                break;
+            }
+            case vm_operator::less_than_equals_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                *left = value(compare(left->number, right) <= 0);
+                break;
+            }
+            case vm_operator::greater_than_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                *left = value(compare(left->number, right) > 0);
+                break;
+            }
+            case vm_operator::greater_than_equals_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                *left = value(compare(left->number, right) >= 0);
+                break;
+            }
+            case vm_operator::equals_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                *left = value(compare(left->number, right) == 0);
+                break;
+            }
+            case vm_operator::not_equals_number:
+            {
+                double right;
+                auto left = peek_number_operands(code_line, right);
+                if (!left)
+                {
+                    deoptimise(code_line);
+                    break;
+                }
+                *left = value(compare(left->number, right) != 0);
+                break;
+            }
         }
     }
 
+    // Compiled functions fall back to the interpreter for the lines they don't handle themselves.
+    template void virtual_machine::step_impl<true>();
+
     std::shared_ptr<const array_value> virtual_machine::get_args(int num_args)
     {
         if (num_args == 0)
@@ -444,10 +905,10 @@ namespace lysithea_vm
                 }
             }
 
-            return std::make_shared<const array_value>(combined, true);
+            return make_tracked<const array_value>(combined, true);
         }
 
-        return std::make_shared<const array_value>(temp, true);
+        return make_tracked<const array_value>(temp, true);
     }
 
     void virtual_machine::jump(const std::string &label)
@@ -461,17 +922,431 @@ namespace lysithea_vm
         program_counter = find->second;
     }
 
+    std::shared_ptr<virtual_machine> virtual_machine::fork()
+    {
+        auto result = std::make_shared<virtual_machine>(stack.max_stack_size());
+
+        // The stacks are small and fixed in size, the scopes and values they point to are shared rather than copied.
+        result->stack.copy_from(stack);
+        result->stack_trace.copy_from(stack_trace);
+        result->program_counter = program_counter;
+        result->running = running;
+        result->paused = paused;
+        result->builtin_scope = builtin_scope;
+        result->current_code = current_code;
+        result->current_scope = current_scope;
+        result->global_scope = global_scope;
+        result->memory->memory_limit = memory->memory_limit;
+        result->cell_copies = cell_copies;
+        result->next_scope_id = next_scope_id;
+
+        // Neither virtual machine owns the scopes any more, so whichever changes one first makes its own copy.
+        scope_owner = next_scope_owner++;
+        shares_scopes = true;
+        result->shares_scopes = true;
+
+        // Values made by this virtual machine can now be freed from the forked one's thread.
+        memory->concurrent = true;
+
+        return result;
+    }
+
+    scope &virtual_machine::writable_global_scope()
+    {
+        if (shares_scopes && global_scope->owner != scope_owner)
+        {
+            memory_scope tracking(memory.get());
+            unshare_scope(global_scope.get());
+        }
+        return *global_scope;
+    }
+
+    std::shared_ptr<scope> virtual_machine::make_scope(std::shared_ptr<scope> parent)
+    {
+        auto result = make_tracked<scope>(std::move(parent));
+        result->owner = scope_owner;
+        result->id = next_scope_id++;
+        return result;
+    }
+
+    void virtual_machine::switch_lookup_cache()
+    {
+        auto find = lookup_caches.find(current_code.get());
+        if (find == lookup_caches.end())
+        {
+            find = lookup_caches.emplace(current_code.get(), lookup_cache(current_code)).first;
+        }
+
+        lookup_code = current_code.get();
+        current_lookups = &find->second;
+    }
+
+    void virtual_machine::clear_lookup_caches()
+    {
+        lookup_caches.clear();
+        lookup_code = nullptr;
+        current_lookups = nullptr;
+    }
+
+    void virtual_machine::unshare_scope(const scope *target)
+    {
+        std::unordered_map<const scope *, std::shared_ptr<scope>> copies;
+
+        current_scope = relink_scope(current_scope, target, copies);
+        global_scope = relink_scope(global_scope, target, copies);
+
+        auto frames = stack_trace.data_from(0);
+        for (auto i = 0; i < stack_trace.stack_size(); i++)
+        {
+            frames[i].frame_scope = relink_scope(frames[i].frame_scope, target, copies);
+        }
+
+        // Scopes have been given new parents, so the cached lookups may no longer be the ones that would be found.
+        clear_lookup_caches();
+    }
+
+    // Gives back the scope to use in place of input after the target has been copied.
+    // Shared scopes between the input and the target are copied as well, so that they point at the new parent.
+    std::shared_ptr<scope> virtual_machine::relink_scope(const std::shared_ptr<scope> &input, const scope *target, std::unordered_map<const scope *, std::shared_ptr<scope>> &copies)
+    {
+        if (!input)
+        {
+            return input;
+        }
+
+        auto find = copies.find(input.get());
+        if (find != copies.end())
+        {
+            return find->second;
+        }
+
+        auto parent = input->parent;
+        if (input.get() != target)
+        {
+            parent = relink_scope(input->parent, target, copies);
+            if (parent == input->parent)
+            {
+                return input;
+            }
+
+            if (input->owner == scope_owner)
+            {
+                input->set_parent(parent);
+                return input;
+            }
+        }
+
+        auto result = make_tracked<scope>(*input);
+        result->owner = scope_owner;
+        result->id = next_scope_id++;
+        result->set_parent(parent);
+        own_cells(*result);
+        copies[input.get()] = result;
+        return result;
+    }
+
+    value virtual_machine::make_closure(const function_value &input)
+    {
+        const auto &code = *input.data;
+        upvalue_list captures;
+        captures.reserve(code.captures.size());
+        for (auto i = 0; i < code.captures.size(); i++)
+        {
+            auto slot = i < code.capture_slots.size() ? code.capture_slots[i] : -1;
+            if (slot < 0)
+            {
+                captures.push_back(capture_variable(code.captures[i]));
+            }
+            else if (slot < current_scope->upvalues.size())
+            {
+                captures.push_back(current_scope->upvalues[slot]);
+            }
+            else
+            {
+                captures.emplace_back();
+            }
+        }
+
+        return value(make_tracked<function_value>(input.data, std::move(captures)));
+    }
+
+    value virtual_machine::capture_variable(const std::string &key)
+    {
+        // Only variables the enclosing function has already defined are captured, anything else is left to be looked up by name.
+        auto find = current_scope->values.find(key);
+        if (find == current_scope->values.end() || current_scope->is_constant(key))
+        {
+            return value();
+        }
+        if (scope::get_cell(find->second))
+        {
+            return find->second;
+        }
+
+        auto &found = writable_current_scope().values.find(key)->second;
+        found = value(make_tracked<cell_value>(std::move(found), scope_owner));
+        return found;
+    }
+
+    void virtual_machine::get_captured(int index)
+    {
+        const auto &upvalues = current_scope->upvalues;
+        if (index < upvalues.size())
+        {
+            const auto &captured = upvalues[index];
+            if (!captured.is_undefined())
+            {
+                push_stack(static_cast<const cell_value *>(readable_cell(captured).data.get())->data);
+                return;
+            }
+        }
+
+        const auto &key = current_code->captures[index];
+        value found_value;
+        if (current_scope->try_get_key(key, found_value) ||
+            (builtin_scope && builtin_scope->try_get_key(key, found_value)))
+        {
+            push_stack(std::move(found_value));
+        }
+        else
+        {
+            throw virtual_machine_error(create_stack_trace(), "Unable to find value to get: " + key);
+        }
+    }
+
+    void virtual_machine::set_captured(int index, value input)
+    {
+        const auto &upvalues = current_scope->upvalues;
+        if (index < upvalues.size() && !upvalues[index].is_undefined())
+        {
+            // Copied as making the cell writable can replace the current scope with a copy.
+            auto captured = upvalues[index];
+            writable_cell(captured)->data = std::move(input);
+            return;
+        }
+
+        const auto &key = current_code->captures[index];
+        prepare_scope_write(key);
+        if (!current_scope->try_set(key, std::move(input)))
+        {
+            throw virtual_machine_error(create_stack_trace(), "Unable to set variable that has not been defined: " + key);
+        }
+    }
+
+    cell_value *virtual_machine::writable_cell(const value &input)
+    {
+        auto cell = static_cast<cell_value *>(readable_cell(input).data.get());
+        if (!shares_scopes || cell->owner == scope_owner)
+        {
+            return cell;
+        }
+
+        // Copying the scope that holds the cell copies the cell as well, so the variable is the same when it is used by name.
+        auto holder = find_cell_scope(cell);
+        if (holder)
+        {
+            unshare_scope(holder);
+            cell = static_cast<cell_value *>(readable_cell(input).data.get());
+            if (cell->owner == scope_owner)
+            {
+                return cell;
+            }
+        }
+
+        auto copy = make_tracked<cell_value>(cell->data, scope_owner);
+        cell_copies[cell] = std::make_pair(readable_cell(input), value(copy));
+        return copy.get();
+    }
+
+    void virtual_machine::own_cells(scope &input)
+    {
+        for (auto &iter : input.values)
+        {
+            auto cell = scope::get_cell(iter.second);
+            if (!cell || cell->owner == scope_owner)
+            {
+                continue;
+            }
+
+            const auto &current = readable_cell(iter.second);
+            cell = static_cast<cell_value *>(current.data.get());
+            if (cell->owner != scope_owner)
+            {
+                auto copy = value(make_tracked<cell_value>(cell->data, scope_owner));
+                cell_copies[cell] = std::make_pair(current, copy);
+                iter.second = copy;
+            }
+            else
+            {
+                iter.second = current;
+            }
+        }
+    }
+
+    const scope *virtual_machine::find_cell_scope(const complex_value *cell) const
+    {
+        // Only scopes that can be reached by name matter, closures hold onto the cells themselves.
+        auto search = [cell](const scope *input) -> const scope *
+        {
+            for (; input; input = input->parent.get())
+            {
+                for (const auto &iter : input->values)
+                {
+                    if (iter.second.data.get() == cell)
+                    {
+                        return input;
+                    }
+                }
+            }
+            return nullptr;
+        };
+
+        auto result = search(current_scope.get());
+        if (!result)
+        {
+            result = search(global_scope.get());
+        }
+
+        auto frames = stack_trace.data_from(0);
+        for (auto i = 0; !result && i < stack_trace.stack_size(); i++)
+        {
+            result = search(frames[i].frame_scope.get());
+        }
+        return result;
+    }
+
     void virtual_machine::call_function(const complex_value &value, int num_args, bool push_to_stack_trace)
     {
         if (!value.is_function())
         {
             throw virtual_machine_error(create_stack_trace(), std::string("Unable to invoke non function value") + value.to_string());
         }
+
+        if (value.kind == complex_kind::builtin_function)
+        {
+            const auto &builtin = static_cast<const builtin_function_value &>(value);
+            if (builtin.uses_args_span)
+            {
+                call_native(builtin, num_args);
+                return;
+            }
+        }
+
         auto args = get_args(num_args);
         value.invoke(*this, args, push_to_stack_trace);
     }
 
-    void virtual_machine::execute_function(std::shared_ptr<function> code, std::shared_ptr<const array_value> args, bool push_to_stack_trace)
+    void virtual_machine::call_native(const builtin_function_value &input, int num_args)
+    {
+        auto start = stack.stack_size() - num_args;
+        if (start < 0)
+        {
+            throw std::runtime_error("Unable to pop stack, empty stack");
+        }
+
+        // Unpacked arguments are flattened and put back onto the stack.
+        for (auto i = start; i < start + num_args; i++)
+        {
+            auto is_arg = complex_cast<const array_value>(stack.data_from(i)->data.get());
+            if (is_arg && is_arg->is_arguments_value)
+            {
+                auto args = get_args(num_args);
+                if (stack.stack_size() + static_cast<int>(args->data.size()) > stack.max_stack_size())
+                {
+                    // Too many to fit on the stack, so they are passed from the array instead.
+                    input.invoke(*this, args, false);
+                    return;
+                }
+
+                for (const auto &iter : args->data)
+                {
+                    push_stack(iter);
+                }
+                num_args = static_cast<int>(args->data.size());
+                break;
+            }
+        }
+
+        input.invoke_native(*this, args_span(stack.data_from(start), num_args));
+
+        // Anything pushed by the function is moved down over the arguments.
+        if (stack.stack_size() < start + num_args)
+        {
+            throw std::runtime_error("Native function popped its own arguments off the stack");
+        }
+        stack.erase(start, num_args);
+    }
+
+    void virtual_machine::tail_call_function(const complex_value &value, int num_args)
+    {
+        auto script_function = complex_cast<const function_value>(&value);
+        if (!script_function)
+        {
+            // Builtins do not have a frame to reuse, so call them as normal and return their result.
+            call_function(value, num_args, true);
+            call_return();
+            return;
+        }
+
+        // The current function is finished so the called function takes its place in the stack trace.
+        // Scopes are dynamic so the current scope stays as the parent, the called function can still see the caller's variables.
+        // If they are all parameters of the called function they can't be seen anyway, so the caller's scope is skipped,
+        // otherwise a recursive tail call would add another scope for every variable lookup to search through each time.
+        auto args = get_args(num_args);
+        if (current_scope->parent && parameters_hide_scope(*script_function->data, *current_scope))
+        {
+            current_scope = current_scope->parent;
+        }
+        execute_function(script_function->data, args, false, script_function->captures.empty() ? nullptr : &script_function->captures);
+    }
+
+    bool virtual_machine::parameters_hide_scope(const function &code, const scope &input)
+    {
+        if (input.values.size() > code.parameters.size())
+        {
+            return false;
+        }
+
+        for (const auto &iter : input.values)
+        {
+            auto found = false;
+            for (const auto &parameter : code.parameters)
+            {
+                // Parameters after an unpacked one are never defined.
+                auto is_unpack = starts_with_unpack(parameter);
+                if (is_unpack ? parameter.compare(3, std::string::npos, iter.first) == 0 : parameter == iter.first)
+                {
+                    found = true;
+                    break;
+                }
+                if (is_unpack)
+                {
+                    break;
+                }
+            }
+
+            if (!found)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void virtual_machine::run_function(const complex_value &value, int num_args)
+    {
+        // A variable moved out for the builtin calling this is put back first, the function could read it.
+        restore_moved_variable();
+
+        auto depth = stack_trace.stack_size();
+        call_function(value, num_args, true);
+        while (stack_trace.stack_size() > depth)
+        {
+            step_current();
+        }
+    }
+
+    void virtual_machine::execute_function(std::shared_ptr<function> code, std::shared_ptr<const array_value> args, bool push_to_stack_trace, const upvalue_list *upvalues)
     {
         if (push_to_stack_trace)
         {
@@ -479,7 +1354,11 @@ namespace lysithea_vm
         }
 
         current_code = code;
-        current_scope = std::make_shared<scope>(current_scope);
+        current_scope = make_scope(current_scope);
+        if (upvalues)
+        {
+            current_scope->upvalues = *upvalues;
+        }
         program_counter = 0;
 
         auto num_called_args = std::min(args->data.size(), code->parameters.size());
@@ -520,9 +1399,24 @@ namespace lysithea_vm
             return false;
         }
 
-        current_code = top.code;
-        current_scope = top.frame_scope;
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+        // Tail calls leave the scopes of the functions they replaced between this one and the frame's scope.
+        for (auto exited = &current_scope; *exited && *exited != top.frame_scope; exited = &(*exited)->parent)
+        {
+            collector.scope_exited(*exited);
+        }
+#endif
+
+        current_code = std::move(top.code);
+        current_scope = std::move(top.frame_scope);
         program_counter = top.line_counter;
+
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+        if (collector.should_step())
+        {
+            collector.collect_step(collector.step_budget);
+        }
+#endif
         return true;
     }
 
@@ -553,6 +1447,13 @@ namespace lysithea_vm
         }
     }
 
+    virtual_machine_error virtual_machine::create_memory_error(const memory_limit_error &input)
+    {
+        std::stringstream ss;
+        ss << "Memory limit of " << input.limit << " bytes exceeded, " << memory->live_bytes << " bytes in use and " << input.requested << " more requested";
+        return virtual_machine_error(create_stack_trace(), ss.str());
+    }
+
     std::vector<std::string> virtual_machine::create_stack_trace()
     {
         std::vector<std::string> result;
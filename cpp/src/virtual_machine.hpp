@@ -4,6 +4,8 @@
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <unordered_map>
+#include <cstdint>
 
 #include "operator.hpp"
 #include "code_line.hpp"
@@ -11,10 +13,19 @@
 #include "script.hpp"
 #include "function.hpp"
 #include "fixed_stack.hpp"
+#include "memory_tracker.hpp"
+#include "lookup_cache.hpp"
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+#include "cycle_collector.hpp"
+#endif
 #include "./values/value.hpp"
 #include "./values/complex_value.hpp"
 #include "./values/array_value.hpp"
 #include "./values/string_value.hpp"
+#include "./values/cell_value.hpp"
+#include "./values/args_span.hpp"
+#include "./errors/virtual_machine_error.hpp"
+#include "./errors/memory_limit_error.hpp"
 
 namespace lysithea_vm
 {
@@ -33,6 +44,10 @@ namespace lysithea_vm
             // Methods
     };
 
+    class snapshot_context;
+    class aot_runtime;
+    class function_value;
+
     class virtual_machine
     {
         public:
@@ -43,23 +58,44 @@ namespace lysithea_vm
             std::shared_ptr<function> current_code;
             std::shared_ptr<scope> current_scope;
             std::shared_ptr<scope> global_scope;
+            // Counts the memory used by the values made while running, and can put a limit on it.
+            std::shared_ptr<memory_tracker> memory;
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+            // Frees scopes that only keep each other alive, a little is done each time a function returns.
+            cycle_collector collector;
+#endif
 
             // Constructor
             virtual_machine(int stackSize);
+#ifdef LYSITHEA_CYCLE_COLLECTOR
+            ~virtual_machine();
+#endif
 
             // Methods
             void reset();
             void change_to_script(std::shared_ptr<script> input);
             void execute(std::shared_ptr<script> input);
+            // Carries on from where the virtual machine is, eg: after restoring a snapshot.
+            void execute();
             void step();
             void jump(const std::string &label);
 
+            // Makes a new virtual machine that carries on from the same point, the scopes are shared until either one changes them.
+            // The forked virtual machine can be run on another thread.
+            std::shared_ptr<virtual_machine> fork();
+            // Host code that changes the global scope directly should go through this once the virtual machine has been forked.
+            scope &writable_global_scope();
+
             // Function methods
             std::shared_ptr<const array_value> get_args(int num_args);
             void call_function(const complex_value &value, int num_args, bool push_to_stack_trace);
+            void call_native(const builtin_function_value &input, int num_args);
+            void tail_call_function(const complex_value &value, int num_args);
+            // Calls the function and runs it until it has returned, leaving its result on the stack so builtins can call script functions.
+            void run_function(const complex_value &value, int num_args);
             bool try_return();
             void call_return();
-            void execute_function(std::shared_ptr<function> func, std::shared_ptr<const array_value> args, bool push_to_stack_trace);
+            void execute_function(std::shared_ptr<function> func, std::shared_ptr<const array_value> args, bool push_to_stack_trace, const upvalue_list *upvalues = nullptr);
 
             // Stack methods
             inline void push_stack_trace(const scope_frame &frame)
@@ -79,7 +115,7 @@ namespace lysithea_vm
                     throw std::runtime_error("Unable to pop stack, empty stack");
                 }
 
-                auto casted = std::dynamic_pointer_cast<T>(result);
+                auto casted = result.get_complex<T>();
                 if (!casted)
                 {
                     throw std::bad_cast();
@@ -144,17 +180,17 @@ namespace lysithea_vm
 
             inline void push_stack(const char *input)
             {
-                push_stack(value(std::make_shared<string_value>(input)));
+                push_stack(value(make_tracked<string_value>(input)));
             }
 
             inline void push_stack(const std::string &input)
             {
-                push_stack(std::make_shared<string_value>(input));
+                push_stack(make_tracked<string_value>(input));
             }
 
             inline void push_stack(value input)
             {
-                if (!stack.push(input))
+                if (!stack.push(std::move(input)))
                 {
                     throw std::runtime_error("Unable to push stack, stack full");
                 }
@@ -162,7 +198,7 @@ namespace lysithea_vm
 
             inline void push_stack(std::shared_ptr<complex_value> input)
             {
-                if (!stack.push(input))
+                if (!stack.push(value(std::move(input))))
                 {
                     throw std::runtime_error("Unable to push stack, stack full");
                 }
@@ -181,7 +217,16 @@ namespace lysithea_vm
             void print_stack_debug();
             void print_stack_trace_debug();
 
+            // An error with the stack trace of where the virtual machine is, for builtins to throw.
+            inline virtual_machine_error make_error(const std::string &message)
+            {
+                return virtual_machine_error(create_stack_trace(), message);
+            }
+
         private:
+            friend class snapshot_context;
+            friend class aot_runtime;
+
             // Fields
             fixed_stack<lysithea_vm::value> stack;
             fixed_stack<scope_frame> stack_trace;
@@ -189,8 +234,151 @@ namespace lysithea_vm
             static std::shared_ptr<const array_value> empty_args;
 
             int program_counter;
+            std::uint64_t scope_owner;
+            bool shares_scopes;
+            // The copies this virtual machine made of cells that it shared after forking, along with the cell that was copied
+            // so that it stays alive while it is a key. Closures still hold the shared cell so each use goes through here.
+            std::unordered_map<const complex_value *, std::pair<value, value>> cell_copies;
+            // Given to each scope this virtual machine makes, forks carry on from the same number as they only see the scopes made before.
+            std::uint64_t next_scope_id;
+            // Where the get, set, inc and dec lines of each function last found their variables.
+            std::unordered_map<const function *, lookup_cache> lookup_caches;
+            const function *lookup_code;
+            lookup_cache *current_lookups;
+            // The variable emptied by get_move and where its value was pushed, kept until the set after it so that
+            // the value can be put back if there is an error in between.
+            value *moved_variable;
+            const complex_value *moved_data;
+            int moved_stack_index;
 
             // Methods
+            void step_current();
+
+            template <bool verified>
+            void step_impl();
+
+            virtual_machine_error create_memory_error(const memory_limit_error &input);
+
+            std::shared_ptr<scope> make_scope(std::shared_ptr<scope> parent);
+
+            // Copies the scope holding the key if it is shared with another virtual machine.
+            inline void prepare_scope_write(const std::string &key)
+            {
+                if (shares_scopes)
+                {
+                    auto found = current_scope->find_key_scope(key);
+                    if (found && found->owner != scope_owner)
+                    {
+                        unshare_scope(found);
+                    }
+                }
+            }
+
+            inline scope &writable_current_scope()
+            {
+                if (shares_scopes && current_scope->owner != scope_owner)
+                {
+                    unshare_scope(current_scope.get());
+                }
+                return *current_scope;
+            }
+
+            void unshare_scope(const scope *target);
+            std::shared_ptr<scope> relink_scope(const std::shared_ptr<scope> &input, const scope *target, std::unordered_map<const scope *, std::shared_ptr<scope>> &copies);
+            void release_scopes();
+
+            // Lookup methods
+            inline lookup_cache *current_lookup_cache()
+            {
+                if (lookup_code != current_code.get())
+                {
+                    switch_lookup_cache();
+                }
+                return current_lookups;
+            }
+
+            // The variable the line uses if the scopes it was found through have not changed since the line last ran.
+            inline lookup_cache_entry *cached_variable(int line)
+            {
+                return current_lookup_cache()->find(line, *current_scope, builtin_scope.get());
+            }
+
+            // Finds the variable the line uses in the current scope, its parents and then the builtin scope.
+            inline lookup_cache_entry *find_variable(int line, const std::string &key)
+            {
+                auto result = cached_variable(line);
+                return result ? result : current_lookups->fill(line, *current_scope, builtin_scope.get(), key);
+            }
+
+            // The same for the line being run when the variable's name is in the line, the name is only made if the cache can not be used.
+            inline lookup_cache_entry *find_variable(const code_line &input)
+            {
+                return find_variable(program_counter - 1, input);
+            }
+            inline lookup_cache_entry *find_variable(int line, const code_line &input)
+            {
+                auto result = cached_variable(line);
+                return result ? result : current_lookups->fill(line, *current_scope, builtin_scope.get(), input.value.to_string());
+            }
+
+            // The variable if it can be changed in place, otherwise the change has to go through the scope so that constants
+            // and scopes shared with a forked virtual machine are handled.
+            inline value *writable_variable(const lookup_cache_entry *entry) const
+            {
+                if (entry && !entry->constant && (!shares_scopes || entry->holder->owner == scope_owner))
+                {
+                    return &entry->variable();
+                }
+                return nullptr;
+            }
+
+            void switch_lookup_cache();
+            void clear_lookup_caches();
+
+            // Pushes the variable's value for get_move, a complex value is taken out of the variable so that it is unique
+            // and can be changed in place. It is pushed before the variable is emptied so nothing is lost if the stack is full.
+            inline void push_moved(value &variable)
+            {
+                push_stack(variable);
+                if (variable.is_complex())
+                {
+                    moved_variable = &variable;
+                    moved_data = variable.data.get();
+                    moved_stack_index = stack.stack_size() - 1;
+                    variable = value::make_null();
+                }
+            }
+
+            void restore_moved_variable();
+
+            // Closure methods
+            value make_closure(const function_value &input);
+            value capture_variable(const std::string &key);
+            void get_captured(int index);
+            void set_captured(int index, value input);
+            cell_value *writable_cell(const value &input);
+            void own_cells(scope &input);
+            const scope *find_cell_scope(const complex_value *cell) const;
+
+            // True if each variable in the scope is a parameter of the function, so a scope made to call it hides all of them.
+            static bool parameters_hide_scope(const function &code, const scope &input);
+
+            // The cell with this virtual machine's copy of the captured variable.
+            inline const value &readable_cell(const value &input) const
+            {
+                const value *result = &input;
+                while (shares_scopes && static_cast<const cell_value *>(result->data.get())->owner != scope_owner)
+                {
+                    auto find = cell_copies.find(result->data.get());
+                    if (find == cell_copies.end())
+                    {
+                        break;
+                    }
+                    result = &find->second.second;
+                }
+                return *result;
+            }
+
             inline value get_operator_arg(const code_line &input)
             {
                 if (!input.value.is_undefined())
@@ -212,7 +400,7 @@ namespace lysithea_vm
 
                 if (result.is_complex())
                 {
-                    return dynamic_cast<const T *>(result.get_complex().get());
+                    return complex_cast<const T>(result.get_complex().get());
                 }
                 return nullptr;
             }
@@ -249,6 +437,50 @@ namespace lysithea_vm
                 throw std::runtime_error("Unable to get boolean argument");
             }
 
+            inline void record_number_feedback(const code_line &input, const value &left, const value &right, vm_operator number_op)
+            {
+                if (left.is_number() && right.is_number())
+                {
+                    input.record_number(number_op);
+                }
+                else
+                {
+                    input.record_other();
+                }
+            }
+
+            // The guard for the quickened operators, gives back the left operand if both operands are numbers.
+            // The right operand is taken off the stack and the left is left in place for the result to be written over.
+            inline value *peek_number_operands(const code_line &input, double &right)
+            {
+                if (input.has_value())
+                {
+                    auto top = stack.peek_top(1);
+                    if (top && top->is_number() && input.value.is_number())
+                    {
+                        right = input.value.get_number();
+                        return top;
+                    }
+                    return nullptr;
+                }
+
+                auto top = stack.peek_top(2);
+                if (top && top[0].is_number() && top[1].is_number())
+                {
+                    right = top[1].get_number();
+                    stack.drop_top();
+                    return top;
+                }
+                return nullptr;
+            }
+
+            // The line is run again as its unspecialised operator.
+            inline void deoptimise(const code_line &input)
+            {
+                input.deoptimise();
+                program_counter--;
+            }
+
             std::vector<std::string> create_stack_trace();
             static std::string debug_scope_line(const function &func, int line);
     };
@@ -3,50 +3,112 @@
 #include <random>
 #include <fstream>
 #include <chrono>
+#include <string>
+#include <vector>
 
 #include "src/virtual_machine.hpp"
 #include "src/errors/virtual_machine_error.hpp"
+#include "src/errors/assembler_error.hpp"
+#include "src/errors/parser_error.hpp"
 #include "src/assembler/assembler.hpp"
 #include "src/standard_library/standard_library.hpp"
 #include "src/standard_library/standard_assert_library.hpp"
 
 using namespace lysithea_vm;
 
-int main()
+// Runs a test script, returning false if it could not be run or an assert failed.
+bool run_script(const std::string &filename, int inline_budget, int assembly_threads)
 {
-    const char *filename = "../../examples/testStandardLibrary.lys";
     std::ifstream input_file;
     input_file.open(filename);
     if (!input_file)
     {
-        std::cout << "Could not find file to open!\n";
-        return -1;
+        std::cout << "Could not find file to open: " << filename << "\n";
+        return false;
     }
 
     lysithea_vm::assembler assembler;
+    assembler.inline_budget = inline_budget;
+    assembler.assembly_threads = assembly_threads;
     lysithea_vm::standard_library::add_to_scope(assembler.builtin_scope);
     assembler.builtin_scope.combine_scope(*lysithea_vm::standard_assert_library::library_scope);
 
-    auto script = assembler.parse_from_stream(filename, input_file);
-
+    auto failures_before = standard_assert_library::failures.load();
     lysithea_vm::virtual_machine vm(32);
 
     try
     {
+        auto script = assembler.parse_from_stream(filename, input_file);
+
         auto start = std::chrono::steady_clock::now();
         vm.execute(script);
         auto end = std::chrono::steady_clock::now();
 
         std::cout << "Time taken: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms\n";
     }
-    catch (lysithea_vm::virtual_machine_error exp)
+    catch (const lysithea_vm::parser_error &exp)
+    {
+        std::cerr << "Parser error: " << exp.message << "\n" << exp.trace << '\n';
+        return false;
+    }
+    catch (const lysithea_vm::assembler_error &exp)
+    {
+        std::cerr << "Assembler error: " << exp.message << "\n" << exp.trace << '\n';
+        return false;
+    }
+    catch (const lysithea_vm::virtual_machine_error &exp)
     {
         std::cerr << "Error: " << exp.message << "\nVM Stack:\n";
         for (const auto &line : exp.stack_trace)
         {
             std::cerr << "- " << line << '\n';
         }
+        return false;
+    }
+
+    return standard_assert_library::failures.load() == failures_before;
+}
+
+// Usage: standardLibraryTest [--inline-budget N] [--assembly-threads N] [script.lys...]
+// Exits with 1 if any of the scripts failed so that it can be used as a test.
+int main(int argc, char **argv)
+{
+    lysithea_vm::assembler defaults;
+    auto inline_budget = defaults.inline_budget;
+    auto assembly_threads = defaults.assembly_threads;
+    std::vector<std::string> filenames;
+
+    for (auto i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--inline-budget" && i + 1 < argc)
+        {
+            inline_budget = std::stoi(argv[++i]);
+        }
+        else if (arg == "--assembly-threads" && i + 1 < argc)
+        {
+            assembly_threads = std::stoi(argv[++i]);
+        }
+        else
+        {
+            filenames.push_back(arg);
+        }
+    }
+
+    if (filenames.empty())
+    {
+        filenames.push_back("../../examples/testStandardLibrary.lys");
+    }
+
+    auto passed = true;
+    for (const auto &filename : filenames)
+    {
+        if (!run_script(filename, inline_budget, assembly_threads))
+        {
+            std::cerr << "Failed: " << filename << "\n";
+            passed = false;
+        }
     }
 
-    return 0;
-}
\ No newline at end of file
+    return passed ? 0 : 1;
+}